@@ -0,0 +1,146 @@
+#ifndef AMVK_ANIM_CLIP_H
+#define AMVK_ANIM_CLIP_H
+
+#include <cstdint>
+#include <vector>
+
+#include <assimp/scene.h>
+
+#include "macro.h"
+#include "pose_kernels.h"
+
+// Keys of a node in one animation, copied out of the assimp scene.
+// Written to the mesh cache, playback samples the compiled AnimClip
+struct AnimChannel {
+	AnimChannel(): animated(false) {}
+
+	bool animated;
+	std::vector<aiVectorKey> positionKeys;
+	std::vector<aiQuatKey> rotationKeys;
+	std::vector<aiVectorKey> scalingKeys;
+};
+
+// One animation compiled into structure of arrays key streams.
+// Keys of a channel are a contiguous range of the streams, and times are kept
+// apart from values, so finding a key only touches the times of one track.
+// Compressed clips drop keys their neighbours reproduce and store the rest
+// in 16 bit components, sampleKeys decodes them on the fly.
+class AnimClip {
+public:
+	static const double DEFAULT_TICKS_PER_SECOND;
+	static const double DEFAULT_TICKS_DURATION;
+
+	// Keys reproduced within these tolerances by interpolating the keys kept
+	// around them are dropped
+	struct Compression {
+		Compression();
+		// model units
+		float positionTolerance;
+		// radians
+		float rotationTolerance;
+		float scaleTolerance;
+	};
+
+	struct Stats {
+		Stats();
+		// of the source channels, then stored by the clip
+		uint32_t rawKeys, keys;
+		// of the keys and tracks as floats, then as stored
+		size_t rawBytes, bytes;
+		// at the times of the source keys, radians for rotations
+		float maxPositionError, maxRotationError, maxScaleError;
+	};
+
+	// Key last used by every track of the clip, one per playing instance.
+	// Playing forward moves it by a key or two, seeks fall back to a binary search
+	struct Cursor {
+		std::vector<uint32_t> keys;
+	};
+
+	AnimClip();
+
+	// channel of every skeleton node, null for nodes the animation does not move
+	void compile(const std::vector<const AnimChannel*>& channels, double ticksPerSecond, double duration);
+	// Like compile, with keys reduced within the tolerances of compression and
+	// quantized: rotations to their smallest three components, positions and scales
+	// to 16 bits of the range of their track, times to 16 bits of the duration
+	void compileCompressed(
+			const std::vector<const AnimChannel*>& channels, 
+			double ticksPerSecond, 
+			double duration, 
+			const Compression& compression);
+
+	void resetCursor(Cursor& cursor) const;
+	// Writes the keys of node around time in ticks to lane of batch, composed
+	// into local transforms by PoseKernels::composeTRS.
+	// False when the clip does not animate the node, the lane is left untouched
+	bool sampleKeys(uint32_t node, float time, Cursor& cursor, PoseBatch& batch, uint32_t lane) const;
+
+	double ticksPerSecond() const { return mTicksPerSecond; }
+	double duration() const { return mDuration; }
+	uint32_t numNodes() const { return (uint32_t) mChannels.size(); }
+	bool isCompressed() const { return mCompressed; }
+	// of the last compile
+	const Stats& stats() const { return mStats; }
+
+private:
+	enum Component {
+		Component_position,
+		Component_rotation,
+		Component_scaling,
+		NUM_COMPONENTS
+	};
+
+	// keys stepped over linearly before a binary search
+	static constexpr uint32_t MAX_CURSOR_STEPS = 4;
+
+	struct Track {
+		Track(): base(0), count(0), offset(0.0f), extent(0.0f) {}
+		uint32_t base, count;
+		// range of packed positions and scales, offset + c / 65535 * extent
+		glm::vec3 offset, extent;
+	};
+
+	// positions and scales within the range of their track, rotations as their
+	// smallest three components, the index of the largest in the top bits of the
+	// first two
+	struct PackedKey {
+		uint16_t c[3];
+	};
+
+	struct Channel {
+		Channel(): animated(false) {}
+		bool animated;
+		Track tracks[NUM_COMPONENTS];
+	};
+
+	void reset(size_t numNodes, double ticksPerSecond, double duration);
+	// key at or before time, factor towards the next key in t
+	uint32_t findKey(Component component, const Track& track, float time, uint32_t& cursorKey, float& t) const;
+	// key of the streams, decoded when compressed, rotations as xyzw, w unused otherwise
+	glm::vec4 key(Component component, const Track& track, uint32_t key) const;
+	glm::vec4 sampleTrack(Component component, const Track& track, float time) const;
+	// keys of one track of a channel, appended to the packed streams
+	void compressTrack(
+			Component component, 
+			Track& track, 
+			const std::vector<float>& times, 
+			const std::vector<glm::vec4>& values, 
+			float tolerance);
+
+	double mTicksPerSecond, mDuration;
+	std::vector<Channel> mChannels;
+	std::vector<float> mTimes[NUM_COMPONENTS];
+	std::vector<glm::vec3> mPositions;
+	std::vector<glm::quat> mRotations;
+	std::vector<glm::vec3> mScales;
+
+	bool mCompressed;
+	// packed time units per tick
+	float mTimeScale;
+	std::vector<uint16_t> mPackedTimes[NUM_COMPONENTS];
+	std::vector<PackedKey> mPackedKeys[NUM_COMPONENTS];
+	Stats mStats;
+};
+
+#endif
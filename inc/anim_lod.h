@@ -0,0 +1,58 @@
+#ifndef AMVK_ANIM_LOD_H
+#define AMVK_ANIM_LOD_H
+
+#include <cstdint>
+#include <vector>
+#include <atomic>
+
+#include "macro.h"
+
+// How often skinned instances evaluate their skeleton, by distance to the camera.
+// Instances of farther tiers evaluate every few frames and blend the last two
+// palettes in between, instances outside the view are not evaluated at all
+// until they come back. Safe to query from several workers at once.
+class AnimLod {
+public:
+	struct Tier {
+		// up to this distance from the camera, world units
+		float maxDistance;
+		// frames between evaluations, 1 evaluates every frame
+		uint32_t updateInterval;
+	};
+
+	struct Stats {
+		uint32_t evaluated, interpolated, culled, bonesEvaluated;
+	};
+
+	// every frame up close, then halving the rate with each tier
+	static std::vector<Tier> defaultTiers();
+
+	AnimLod();
+	AnimLod(const AnimLod& animLod) = delete;
+	AnimLod& operator=(const AnimLod& animLod) = delete;
+
+	// By increasing distance, the last tier also covers everything beyond it.
+	// Not while instances are updated
+	void setTiers(const std::vector<Tier>& tiers);
+	const std::vector<Tier>& tiers() const { return mTiers; }
+	// instances outside the view frustum skip evaluation and drawing
+	void setCulling(bool culling) { mCulling = culling; }
+	bool culling() const { return mCulling; }
+
+	uint32_t updateInterval(float distance) const;
+
+	// Resets the stats of the previous frame
+	void beginFrame();
+	void addEvaluated(uint32_t numBones);
+	void addInterpolated();
+	void addCulled();
+	// of the frame so far
+	Stats stats() const;
+
+private:
+	std::vector<Tier> mTiers;
+	bool mCulling;
+	std::atomic<uint32_t> mNumEvaluated, mNumInterpolated, mNumCulled, mNumBonesEvaluated;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef AMVK_ASSET_LOADER_H
+#define AMVK_ASSET_LOADER_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "macro.h"
+#include "vulkan_state.h"
+#include "task_manager.h"
+#include "upload_manager.h"
+
+// Loads assets as background jobs.
+// The load function runs on a worker, as a TaskManager background job so
+// frames never wait on it, and so do the jobs it submits: file import, decoding, resource creation
+// and recording of its uploads. The render thread calls update() once per frame,
+// which submits finished uploads and makes the asset resident, so later frames
+// may draw it.
+class AssetLoader {
+public:
+	enum State {
+		State_loading,
+		State_resident,
+		State_failed
+	};
+
+	typedef uint32_t Handle;
+
+	AssetLoader(VulkanState& vulkanState, TaskManager& taskManager);
+	// waits for loads still running, they reference their assets
+	~AssetLoader();
+
+	AssetLoader(const AssetLoader& assetLoader) = delete;
+	AssetLoader& operator=(const AssetLoader& assetLoader) = delete;
+
+	Handle load(const char* name, std::function<void()> f);
+
+	// Render thread, before recording a frame
+	void update();
+	// Render thread, blocks until every load finished
+	void waitAll();
+
+	State state(Handle handle) const;
+	bool isResident(Handle handle) const;
+	uint32_t numLoading() const;
+
+private:
+	struct Asset {
+		Asset(): loaded(false), state(State_loading) {}
+		std::string name;
+		// set by the worker once every upload is recorded
+		std::atomic_bool loaded;
+		std::atomic<int> state;
+		std::chrono::high_resolution_clock::time_point start;
+	};
+
+	VulkanState& mState;
+	TaskManager& mTaskManager;
+	JobCounter mCounter;
+	mutable std::mutex mAssetsMutex;
+	std::vector<std::unique_ptr<Asset>> mAssets;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef AMVK_BENCHMARK_H
+#define AMVK_BENCHMARK_H
+
+#include "macro.h"
+#include "skinned.h"
+
+// Benchmarks, run from the command line instead of the render loop
+namespace Benchmark
+{
+
+constexpr uint32_t DEFAULT_NUM_FRAMES = 500;
+constexpr uint32_t NUM_WARMUP_FRAMES = 30;
+// frames writes its JSON here unless told otherwise, stdout is shared with the load log
+constexpr const char* DEFAULT_OUT_PATH = "bench_frames.json";
+
+// Throughput of small jobs for the work stealing TaskManager
+// against the previous single mutex queue, at 1 to 64 threads
+void taskThroughput();
+
+// Per bone cost of sampling an animation for clips of 16 to 16384 keys,
+// previous linear key scan against compiled clips played with a cursor and seeked,
+// then played compressed, with memory and max error of the compressed clip
+void animationSampling();
+
+// Per bone cost of building local transforms from the synthetic, guard and dwarf
+// clips, previous sampling against the scalar, SSE and AVX2 pose kernels,
+// with the error of each kernel against the previous matrices
+void poseKernels();
+
+// Per frame cost of posing 256 instances of a 64 bone skeleton sharing 1 to 256
+// distinct poses, each evaluating its own skeleton against the PoseCache
+void poseCache();
+
+// Renders the scene headless for numFrames with a fixed time step and writes
+// CPU and GPU frame time statistics as JSON to outPath, DEFAULT_OUT_PATH when
+// null and stdout for "-", where it is mixed with the log.
+// skinnedFlags select the skinning mode of the guard, so runs compare modes,
+// without animLod every skinned model is evaluated every frame,
+// packedVertices selects the vertex layout of every model, without meshLod
+// static models draw every mesh in full
+void frames(
+		uint32_t numFrames, 
+		const char* outPath, 
+		Skinned::ModelFlags skinnedFlags = 0, 
+		bool animLod = true, 
+		bool packedVertices = true,
+		bool meshLod = true);
+
+};
+
+#endif
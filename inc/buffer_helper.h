@@ -11,6 +11,7 @@
 #include "cmd_pass.h"
 #include "vulkan_utils.h"
 #include "vulkan_state.h"
+#include "memory_allocator.h"
 
 #include <cstring>
 
@@ -20,7 +21,7 @@ public:
 	BufferInfo(const VkDevice& device, VkDeviceSize size);
 	~BufferInfo();
 	VkBuffer buffer;
-	VkDeviceMemory memory;
+	MemoryAllocation allocation;
 	VkDeviceSize size;
 private:
 	const VkDevice& mVkDevice;
@@ -78,6 +79,7 @@ public:
 	static void createVertexBuffer(const VulkanState& state, BufferInfo& bufferInfo);
 	static void createIndexBuffer(const VulkanState& state, BufferInfo& bufferInfo);
 	static void createUniformBuffer(const VulkanState& state, BufferInfo& bufferInfo);
+	static void createStorageBuffer(const VulkanState& state, BufferInfo& bufferInfo);
 	static void createStagingBuffer(const VulkanState& state,BufferInfo& bufferInfo);
 
 	static void createStagingBuffer(
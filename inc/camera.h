@@ -22,6 +22,9 @@ public:
 
 	glm::mat4& proj();
 	glm::mat4& view();
+	const glm::vec3& eye() const;
+	// false when the sphere is entirely outside the view frustum
+	bool isSphereVisible(const glm::vec3& center, float radius) const;
 
     double mPrevMouseX, mPrevMouseY;
 private:
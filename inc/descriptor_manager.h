@@ -30,7 +30,7 @@ inline void createQuadDescriptorSetLayout(VulkanState& state)
 	VkDescriptorSetLayoutBinding descSetBinding = {};
 	descSetBinding.binding = 0;
 	descSetBinding.descriptorCount = 1;
-	descSetBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descSetBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	descSetBinding.pImmutableSamplers = nullptr;
 	descSetBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
@@ -98,7 +98,7 @@ inline void createUniformDescriptorSetLayout(VulkanState& state)
 	VkDescriptorSetLayoutBinding descSetBinding = {};
 	descSetBinding.binding = 0;
 	descSetBinding.descriptorCount = 1;
-	descSetBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descSetBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	descSetBinding.pImmutableSamplers = nullptr;
 	descSetBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
@@ -110,12 +110,30 @@ inline void createUniformDescriptorSetLayout(VulkanState& state)
 	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(state.device, &descSetLayoutInfo, nullptr, &state.descriptorSetLayouts.uniform));
 }
 
+// read only buffer fetched by the vertex shader, baked bone palettes
+inline void createStorageDescriptorSetLayout(VulkanState& state)
+{
+	VkDescriptorSetLayoutBinding descSetBinding = {};
+	descSetBinding.binding = 0;
+	descSetBinding.descriptorCount = 1;
+	descSetBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descSetBinding.pImmutableSamplers = nullptr;
+	descSetBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+	VkDescriptorSetLayoutCreateInfo descSetLayoutInfo = {};
+	descSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	descSetLayoutInfo.bindingCount = 1;
+	descSetLayoutInfo.pBindings = &descSetBinding;
+
+	VK_CHECK_RESULT(vkCreateDescriptorSetLayout(state.device, &descSetLayoutInfo, nullptr, &state.descriptorSetLayouts.storage));
+}
+
 inline void createModelDescriptorSetLayout(VulkanState& state)
 {
 	VkDescriptorSetLayoutBinding descSetBinding = {};
 	descSetBinding.binding = 0;
 	descSetBinding.descriptorCount = 1;
-	descSetBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descSetBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	descSetBinding.pImmutableSamplers = nullptr;
 	descSetBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
@@ -168,7 +186,7 @@ inline void createModelDescriptorSetLayout(VulkanState& state)
 inline void createDescriptorPool(VulkanState& state) 
 {
 	VkDescriptorPoolSize uboSize = {};
-	uboSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	uboSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	uboSize.descriptorCount = 1;
 	
 	VkDescriptorPoolSize samplerSize = {};
@@ -196,6 +214,7 @@ inline void createDescriptorSetLayouts(VulkanState& state)
 	createSamplerDescriptorSetLayout(state);
 	createSamplerListDescriptorSetLayout(state);
 	createUniformDescriptorSetLayout(state);
+	createStorageDescriptorSetLayout(state);
 	LOG("DESC LAYOUTS CREATED");
 }
 
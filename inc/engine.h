@@ -29,7 +29,8 @@ public:
     bool isReady;
     bool hasFocus;
 #else
-	void init();
+	// headless skips the window and renders offscreen
+	void init(bool headless = false);
 #endif
 	void handleMovement(double dt);
 	Window& getWindow();
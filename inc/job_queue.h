@@ -0,0 +1,157 @@
+#ifndef AMVK_JOB_QUEUE_H
+#define AMVK_JOB_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+class JobCounter;
+
+// Job with inline functor storage. Callable is placement-constructed into
+// the job itself, so submitting a lambda never touches the heap.
+class Job {
+public:
+	static constexpr size_t STORAGE_SIZE = 64;
+
+	Job(): mCall(nullptr), mPending(false), mCounter(nullptr), mNumDependencies(0), mBackground(false) {}
+	Job(const Job& job) = delete;
+	Job& operator=(const Job& job) = delete;
+
+	template <class F>
+	void set(F&& f)
+	{
+		typedef typename std::decay<F>::type Functor;
+		static_assert(sizeof(Functor) <= STORAGE_SIZE, "Job functor is too big, capture less or capture by pointer");
+		static_assert(alignof(Functor) <= alignof(std::max_align_t), "Job functor alignment is not supported");
+		new (mStorage) Functor(std::forward<F>(f));
+		mCall = &call<Functor>;
+	}
+
+	void execute()
+	{
+		mCall(mStorage, true);
+		mCall = nullptr;
+	}
+
+	// Destroys the functor without running it
+	void discard()
+	{
+		if (mCall)
+			mCall(mStorage, false);
+		mCall = nullptr;
+	}
+
+	bool isPending() const { return mPending.load(std::memory_order_acquire); }
+	void setPending(bool pending) { mPending.store(pending, std::memory_order_release); }
+
+	// counter decremented once the job has run
+	JobCounter* counter() const { return mCounter; }
+	void setCounter(JobCounter* counter) { mCounter = counter; }
+
+	// queued on the background queue of the TaskManager
+	bool isBackground() const { return mBackground; }
+	void setBackground(bool background) { mBackground = background; }
+
+	void setNumDependencies(int numDependencies) { mNumDependencies.store(numDependencies); }
+	// returns true when the last dependency is resolved
+	bool resolveDependency() { return mNumDependencies.fetch_sub(1) == 1; }
+
+private:
+	template <class Functor>
+	static void call(void* storage, bool run)
+	{
+		Functor* f = reinterpret_cast<Functor*>(storage);
+		if (run)
+			(*f)();
+		f->~Functor();
+	}
+
+	alignas(std::max_align_t) unsigned char mStorage[STORAGE_SIZE];
+	void (*mCall)(void*, bool);
+	std::atomic_bool mPending;
+	JobCounter* mCounter;
+	std::atomic<int> mNumDependencies;
+	bool mBackground;
+};
+
+// Fixed size Chase-Lev work stealing deque.
+// push/pop are called by the owner thread only, steal from any thread.
+class JobQueue {
+public:
+	static constexpr int64_t CAPACITY = 4096;
+	static constexpr int64_t MASK = CAPACITY - 1;
+
+	JobQueue(): mTop(0), mBottom(0)
+	{
+		for (int64_t i = 0; i < CAPACITY; ++i)
+			mJobs[i].store(nullptr, std::memory_order_relaxed);
+	}
+
+	bool push(Job* job)
+	{
+		int64_t b = mBottom.load(std::memory_order_relaxed);
+		int64_t t = mTop.load(std::memory_order_acquire);
+		if (b - t >= CAPACITY)
+			return false;
+		mJobs[b & MASK].store(job, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		mBottom.store(b + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	Job* pop()
+	{
+		int64_t b = mBottom.load(std::memory_order_relaxed) - 1;
+		mBottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = mTop.load(std::memory_order_relaxed);
+
+		if (t > b) {
+			// empty
+			mBottom.store(b + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		Job* job = mJobs[b & MASK].load(std::memory_order_relaxed);
+		if (t == b) {
+			// last job, race against stealers
+			if (!mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				job = nullptr;
+			mBottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	Job* steal()
+	{
+		int64_t t = mTop.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t b = mBottom.load(std::memory_order_acquire);
+
+		if (t >= b)
+			return nullptr;
+
+		Job* job = mJobs[t & MASK].load(std::memory_order_relaxed);
+		if (!mTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return nullptr;
+		return job;
+	}
+
+	bool empty() const
+	{
+		return mBottom.load(std::memory_order_relaxed) <= mTop.load(std::memory_order_relaxed);
+	}
+
+private:
+	// keep owner and stealer ends on separate cache lines
+	std::atomic<int64_t> mTop;
+	char mTopPadding[64 - sizeof(std::atomic<int64_t>)];
+	std::atomic<int64_t> mBottom;
+	char mBottomPadding[64 - sizeof(std::atomic<int64_t>)];
+	std::atomic<Job*> mJobs[CAPACITY];
+};
+
+#endif
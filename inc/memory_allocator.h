@@ -0,0 +1,98 @@
+#ifndef AMVK_MEMORY_ALLOCATOR_H
+#define AMVK_MEMORY_ALLOCATOR_H
+
+#ifdef __ANDROID__
+#include "vulkan_wrapper.h"
+#else
+#include <vulkan/vulkan.h>
+#endif
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <stdexcept>
+
+#include "macro.h"
+#include "vulkan_state.h"
+#include "vulkan_utils.h"
+
+class MemoryAllocator;
+struct MemoryBlock;
+
+// Range of a device memory block, bind the resource at memory + offset
+struct MemoryAllocation {
+	MemoryAllocation():
+		allocator(nullptr),
+		block(nullptr),
+		memory(VK_NULL_HANDLE),
+		offset(0),
+		size(0),
+		mapped(nullptr) {}
+
+	MemoryAllocator* allocator;
+	MemoryBlock* block;
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	// host visible blocks stay mapped, nullptr otherwise
+	char* mapped;
+};
+
+struct MemoryBlock {
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	uint32_t memoryType;
+	// buffers and optimal images never share a block, 
+	// so bufferImageGranularity does not apply
+	bool linear;
+	// holds a single allocation bigger than half a block
+	bool dedicated;
+	char* mapped;
+	VkDeviceSize used;
+	uint32_t numAllocations;
+	// offset -> size of free ranges, adjacent ranges are always merged
+	std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+};
+
+// Reserves large VkDeviceMemory blocks per memory type and hands out aligned
+// ranges from a best fit free list. Keeps the number of vkAllocateMemory
+// calls far below maxMemoryAllocationCount.
+class MemoryAllocator {
+public:
+	static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+
+	MemoryAllocator(VulkanState& vulkanState);
+	~MemoryAllocator();
+
+	MemoryAllocator(const MemoryAllocator& allocator) = delete;
+	MemoryAllocator& operator=(const MemoryAllocator& allocator) = delete;
+
+	void init(VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+
+	// linear for buffers and linear images, false for optimal images
+	MemoryAllocation allocate(const VkMemoryRequirements& memReqs, VkMemoryPropertyFlags flags, bool linear);
+	void free(MemoryAllocation& allocation);
+
+	// Logs blocks, usage and fragmentation of every memory heap
+	void dumpStats();
+
+	uint32_t numDeviceAllocations() const;
+
+private:
+	uint32_t getMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags flags) const;
+	MemoryBlock* createBlock(uint32_t memoryType, VkDeviceSize size, bool linear, bool dedicated);
+	void destroyBlock(MemoryBlock* block);
+	bool allocateFrom(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+
+	VulkanState& mState;
+	std::mutex mMutex;
+	VkPhysicalDeviceMemoryProperties mMemoryProperties;
+	VkDeviceSize mBlockSize;
+	std::vector<std::unique_ptr<MemoryBlock>> mBlocks[VK_MAX_MEMORY_TYPES];
+	uint32_t mNumDeviceAllocations;
+};
+
+#endif
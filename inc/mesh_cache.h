@@ -0,0 +1,193 @@
+#ifndef AMVK_MESH_CACHE_H
+#define AMVK_MESH_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "macro.h"
+#include "file_manager.h"
+
+// Baked models in cache/, written after the first assimp import.
+// A file holds the final vertex and index arrays, mesh ranges, materials and,
+// for skinned models, skeleton and animations. Later runs map it and upload
+// straight from the mapping. The file is rebuilt when the source file,
+// import flags, vertex layout or format version change.
+namespace MeshCache
+{
+
+constexpr uint32_t MAGIC = 0x48534d41; // "AMSH"
+// bump on any change of the layout below or of what models write into sections
+constexpr uint32_t VERSION = 5;
+constexpr uint64_t SECTION_ALIGNMENT = 16;
+
+enum Kind : uint32_t {
+	Kind_model = 1,
+	Kind_skinned = 2
+};
+
+enum Section : uint32_t {
+	Section_vertices,
+	Section_indices,
+	Section_meshes,
+	Section_materials,
+	Section_skeleton,
+	Section_animations,
+	NUM_SECTIONS
+};
+
+// Identifies the import a cache file was baked from
+struct Key {
+	Key(): kind(0), vertexSize(0), importFlags(0), modelFlags(0), sourceSize(0), sourceTime(0), settingsHash(0) {}
+	uint32_t kind;
+	uint32_t vertexSize;
+	uint32_t importFlags;
+	uint32_t modelFlags;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	// of import settings baked into the sections besides the flags, e.g. LOD chains
+	uint64_t settingsHash;
+};
+
+struct SectionRange {
+	uint64_t offset;
+	uint64_t size;
+};
+
+struct Header {
+	uint32_t magic;
+	uint32_t version;
+	Key key;
+	SectionRange sections[NUM_SECTIONS];
+};
+
+// cache/<model folder>_<model file>.mesh
+std::string cachePath(const std::string& sourcePath);
+
+// False when the source can't be stat'ed, e.g. Android assets,
+// such models are always imported
+bool makeKey(
+		const std::string& sourcePath,
+		Kind kind,
+		uint32_t vertexSize,
+		uint32_t importFlags,
+		uint32_t modelFlags,
+		Key& key,
+		uint64_t settingsHash = 0);
+
+};
+
+// Read only mapping of a whole file, read into memory where mmap is not available
+class MappedFile {
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile& mappedFile) = delete;
+	MappedFile& operator=(const MappedFile& mappedFile) = delete;
+
+	bool open(const std::string& path);
+	void close();
+
+	const char* data() const { return mData; }
+	size_t size() const { return mSize; }
+
+private:
+	const char* mData;
+	size_t mSize;
+#ifdef WINDOWS
+	std::vector<char> mBuffer;
+#endif
+};
+
+// Bounds checked reads of a section, throws on a truncated file
+class MeshCacheStream {
+public:
+	MeshCacheStream(const char* data, size_t size): mData(data), mSize(size), mPos(0) {}
+
+	template <class T>
+	T read()
+	{
+		T value;
+		memcpy((void*) &value, take(sizeof(T)), sizeof(T));
+		return value;
+	}
+
+	// copied out, stream data has no alignment guarantees
+	template <class T>
+	void readArray(std::vector<T>& out, size_t count)
+	{
+		out.resize(count);
+		if (count > 0)
+			memcpy((void*) out.data(), take(sizeof(T) * count), sizeof(T) * count);
+	}
+
+	std::string readString()
+	{
+		uint32_t length = read<uint32_t>();
+		return std::string(take(length), length);
+	}
+
+private:
+	const char* take(size_t size)
+	{
+		if (size > mSize - mPos)
+			throw std::runtime_error("Mesh cache section is truncated");
+		const char* p = mData + mPos;
+		mPos += size;
+		return p;
+	}
+
+	const char* mData;
+	size_t mSize;
+	size_t mPos;
+};
+
+class MeshCacheReader {
+public:
+	// False when the file is missing, corrupt or baked from a different import
+	bool open(const std::string& path, const MeshCache::Key& key);
+
+	// Section aligned to MeshCache::SECTION_ALIGNMENT within the mapping
+	const char* section(MeshCache::Section section, size_t& size) const;
+	MeshCacheStream stream(MeshCache::Section section) const;
+
+private:
+	MappedFile mFile;
+	MeshCache::Header mHeader;
+};
+
+class MeshCacheWriter {
+public:
+	template <class T>
+	void write(MeshCache::Section section, const T& value)
+	{
+		writeBytes(section, &value, sizeof(T));
+	}
+
+	template <class T>
+	void writeArray(MeshCache::Section section, const T* values, size_t count)
+	{
+		writeBytes(section, values, sizeof(T) * count);
+	}
+
+	void writeString(MeshCache::Section section, const std::string& s)
+	{
+		write(section, (uint32_t) s.size());
+		writeBytes(section, s.data(), s.size());
+	}
+
+	void writeBytes(MeshCache::Section section, const void* data, size_t size);
+
+	// Written next to path and renamed, a crash never leaves a partial cache.
+	// Failures are logged, the model is just imported again next run
+	void save(const std::string& path, const MeshCache::Key& key);
+
+private:
+	std::vector<char> mSections[MeshCache::NUM_SECTIONS];
+};
+
+#endif
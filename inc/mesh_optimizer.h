@@ -0,0 +1,320 @@
+#ifndef AMVK_MESH_OPTIMIZER_H
+#define AMVK_MESH_OPTIMIZER_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "macro.h"
+#include "task_manager.h"
+
+// Reorders the triangles and vertices of imported meshes for the GPU, once
+// at import time, the mesh cache keeps the result. Passes work on the indices
+// of one mesh, local to its vertices, in this order: welding of duplicate
+// vertices, triangles for the post-transform cache, triangle clusters for
+// overdraw, vertices for fetch
+namespace MeshOptimizer
+{
+
+// LRU post-transform cache optimizeVertexCache orders for
+constexpr uint32_t CACHE_SIZE = 32;
+// FIFO cache the ACMR is measured with, the size of common hardware caches
+constexpr uint32_t STATS_CACHE_SIZE = 16;
+// vertex fetch model of the overfetch, lines of a small FIFO cache
+constexpr uint32_t FETCH_LINE_SIZE = 64;
+constexpr uint32_t FETCH_CACHE_LINES = 128;
+// optimizeOverdraw keeps the ACMR within this factor of the cache order
+constexpr float DEFAULT_OVERDRAW_THRESHOLD = 1.05f;
+// attributes of welded vertices closer than this are the same
+constexpr float DEFAULT_WELD_EPSILON = 1e-5f;
+// simplify gives up after this many rounds of collapses
+constexpr uint32_t MAX_SIMPLIFY_PASSES = 64;
+
+struct Stats {
+	Stats(): acmr(0.0f), overfetch(0.0f) {}
+	// transformed vertices per triangle, 3 when no vertex is shared,
+	// about 0.5 on large regular grids
+	float acmr;
+	// vertex bytes fetched over the bytes of the referenced vertices, 1 at best
+	float overfetch;
+};
+
+Stats analyze(const uint32_t* indices, size_t numIndices, uint32_t numVertices, size_t vertexSize);
+
+uint64_t hashBytes(const void* data, size_t size);
+
+// Snaps v to a multiple of epsilon for weld keys, exact with epsilon 0.
+// Negative zero becomes zero, keys are compared byte for byte
+inline float quantize(float v, float epsilon)
+{
+	float q = epsilon > 0.0f ? std::round(v / epsilon) * epsilon : v;
+	return q == 0.0f ? 0.0f : q;
+}
+
+inline glm::vec2 quantize(const glm::vec2& v, float epsilon)
+{
+	return glm::vec2(quantize(v.x, epsilon), quantize(v.y, epsilon));
+}
+
+inline glm::vec3 quantize(const glm::vec3& v, float epsilon)
+{
+	return glm::vec3(quantize(v.x, epsilon), quantize(v.y, epsilon), quantize(v.z, epsilon));
+}
+
+inline glm::vec4 quantize(const glm::vec4& v, float epsilon)
+{
+	return glm::vec4(quantize(v.x, epsilon), quantize(v.y, epsilon), quantize(v.z, epsilon), quantize(v.w, epsilon));
+}
+
+// Weld key of the attributes every vertex layout has, position, tangent frame
+// and texture coordinate, quantized. Other members are kept as they are
+template <typename Vertex>
+Vertex surfaceKey(const Vertex& vertex)
+{
+	float epsilon = DEFAULT_WELD_EPSILON;
+	Vertex key = vertex;
+	key.pos = quantize(vertex.pos, epsilon);
+	key.normal = quantize(vertex.normal, epsilon);
+	key.tangent = quantize(vertex.tangent, epsilon);
+	key.bitangent = quantize(vertex.bitangent, epsilon);
+	key.texCoord = quantize(vertex.texCoord, epsilon);
+	return key;
+}
+
+// Merges the vertices of the mesh at baseVertex and baseIndex whose weld keys
+// match byte for byte, key(vertex) returns the vertex with every member set and
+// its attributes quantized. Kept vertices move to the front of the mesh in their
+// order, numVertices becomes their count and the absolute indices are rewritten.
+// Meshes with indices outside their vertices are left untouched and return false
+template <typename Vertex, typename Key>
+bool weldVertices(
+		std::vector<Vertex>& vertices,
+		std::vector<uint32_t>& indices,
+		uint32_t baseVertex,
+		uint32_t& numVertices,
+		uint32_t baseIndex,
+		uint32_t numIndices,
+		Key key)
+{
+	if (numVertices == 0)
+		return false;
+	for (uint32_t i = 0; i < numIndices; ++i) {
+		uint32_t index = indices[baseIndex + i];
+		if (index < baseVertex || index - baseVertex >= numVertices)
+			return false;
+	}
+
+	std::vector<Vertex> keys(numVertices);
+	for (uint32_t i = 0; i < numVertices; ++i)
+		keys[i] = key(vertices[baseVertex + i]);
+
+	// open addressing, slots hold the first vertex of a key plus one
+	size_t tableSize = 1;
+	while (tableSize < 2 * (size_t) numVertices)
+		tableSize <<= 1;
+	std::vector<uint32_t> table(tableSize, 0);
+	std::vector<uint32_t> remap(numVertices);
+	uint32_t numUnique = 0;
+	for (uint32_t i = 0; i < numVertices; ++i) {
+		size_t slot = hashBytes(&keys[i], sizeof(Vertex)) & (tableSize - 1);
+		while (table[slot] != 0 && std::memcmp(&keys[table[slot] - 1], &keys[i], sizeof(Vertex)) != 0)
+			slot = (slot + 1) & (tableSize - 1);
+		if (table[slot] != 0) {
+			remap[i] = remap[table[slot] - 1];
+			continue;
+		}
+		table[slot] = i + 1;
+		// kept vertices only move down
+		remap[i] = numUnique;
+		vertices[baseVertex + numUnique++] = vertices[baseVertex + i];
+	}
+
+	for (uint32_t i = 0; i < numIndices; ++i) {
+		uint32_t& index = indices[baseIndex + i];
+		index = baseVertex + remap[index - baseVertex];
+	}
+	numVertices = numUnique;
+	return true;
+}
+
+// Closes the gaps welding left behind the vertices of each mesh and rebases
+// the indices of the moved meshes. Meshes must be in order of their vertices,
+// their indices within them
+template <typename Vertex, typename Mesh>
+void compactMeshes(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Mesh>& meshes)
+{
+	uint32_t nextVertex = 0;
+	for (Mesh& mesh : meshes) {
+		if (mesh.baseVertex != nextVertex) {
+			for (uint32_t i = 0; i < mesh.numVertices; ++i)
+				vertices[nextVertex + i] = vertices[mesh.baseVertex + i];
+			for (uint32_t i = 0; i < mesh.numIndices; ++i)
+				indices[mesh.baseIndex + i] = indices[mesh.baseIndex + i] - mesh.baseVertex + nextVertex;
+			mesh.baseVertex = nextVertex;
+		}
+		nextVertex += mesh.numVertices;
+	}
+	vertices.resize(nextVertex);
+}
+
+// Forsyth's linear speed vertex cache optimization
+void optimizeVertexCache(uint32_t* indices, size_t numIndices, uint32_t numVertices);
+// Splits the cache ordered triangles into clusters where the order restarts
+// or the ACMR allows and draws clusters facing away from the mesh center
+// first, they are the likely occluders. Works with either winding
+void optimizeOverdraw(
+		uint32_t* indices,
+		size_t numIndices,
+		const glm::vec3* positions,
+		uint32_t numVertices,
+		float threshold = DEFAULT_OVERDRAW_THRESHOLD);
+// Numbers vertices in the order of their first use, unused ones last, and
+// rewrites the indices. remap[old vertex] is the new vertex
+void optimizeVertexFetch(uint32_t* indices, size_t numIndices, uint32_t numVertices, std::vector<uint32_t>& remap);
+
+// Quadric error edge collapse onto the existing vertices, the result indexes
+// the same vertices as the input. Collapses until at most targetIndexCount
+// indices are left or the next one moves the surface by more than maxError.
+// Vertices on open borders and on seams, where vertices share a position,
+// never move so levels keep their outline and texture seams. Returns the
+// largest error of the collapses made, in the units of the positions
+float simplify(
+		const uint32_t* indices,
+		size_t numIndices,
+		const glm::vec3* positions,
+		uint32_t numVertices,
+		size_t targetIndexCount,
+		float maxError,
+		std::vector<uint32_t>& result);
+
+// All passes on the mesh at baseVertex and baseIndex of a model, whose indices
+// are absolute. Meshes with indices outside their vertices are left untouched
+// and return false. Vertex needs a glm::vec3 pos. Stats are of vertexStride,
+// the bytes per vertex the GPU fetches, which packing may make smaller
+template <typename Vertex>
+bool optimizeMesh(
+		std::vector<Vertex>& vertices,
+		std::vector<uint32_t>& indices,
+		uint32_t baseVertex,
+		uint32_t numVertices,
+		uint32_t baseIndex,
+		uint32_t numIndices,
+		size_t vertexStride,
+		Stats& before,
+		Stats& after)
+{
+	if (numIndices < 3 || numVertices == 0)
+		return false;
+
+	std::vector<uint32_t> meshIndices(numIndices);
+	for (uint32_t i = 0; i < numIndices; ++i) {
+		uint32_t index = indices[baseIndex + i];
+		if (index < baseVertex || index - baseVertex >= numVertices)
+			return false;
+		meshIndices[i] = index - baseVertex;
+	}
+	before = analyze(meshIndices.data(), numIndices, numVertices, vertexStride);
+
+	std::vector<glm::vec3> positions(numVertices);
+	for (uint32_t i = 0; i < numVertices; ++i)
+		positions[i] = vertices[baseVertex + i].pos;
+
+	optimizeVertexCache(meshIndices.data(), numIndices, numVertices);
+	optimizeOverdraw(meshIndices.data(), numIndices, positions.data(), numVertices);
+	std::vector<uint32_t> remap;
+	optimizeVertexFetch(meshIndices.data(), numIndices, numVertices, remap);
+
+	std::vector<Vertex> meshVertices(vertices.begin() + baseVertex, vertices.begin() + baseVertex + numVertices);
+	for (uint32_t i = 0; i < numVertices; ++i)
+		vertices[baseVertex + remap[i]] = meshVertices[i];
+	for (uint32_t i = 0; i < numIndices; ++i)
+		indices[baseIndex + i] = meshIndices[i] + baseVertex;
+
+	after = analyze(meshIndices.data(), numIndices, numVertices, vertexStride);
+	return true;
+}
+
+
+// Welds and reorders every mesh of a model, see weldVertices and optimizeMesh,
+// then closes the gaps welding left. Meshes own disjoint ranges and run in
+// parallel on taskManager when there is one, as background jobs when called
+// from an import. Mesh ranges shrink to the welded vertices. Logs the stats of
+// every mesh at vertexStride and the time spent welding and reordering under name
+template <typename Vertex, typename Mesh, typename Key>
+void optimizeMeshes(
+		std::vector<Vertex>& vertices,
+		std::vector<uint32_t>& indices,
+		std::vector<Mesh>& meshes,
+		Key key,
+		size_t vertexStride,
+		TaskManager* taskManager,
+		const char* name)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	auto start = Clock::now();
+	uint32_t numImported = (uint32_t) vertices.size();
+	std::vector<Stats> before(meshes.size()), after(meshes.size());
+	// not vector<bool>, meshes are written from several workers
+	std::vector<uint8_t> welded(meshes.size(), 0), optimized(meshes.size(), 0);
+	std::vector<double> weldMs(meshes.size(), 0.0), optimizeMs(meshes.size(), 0.0);
+
+	auto optimize = [&] (size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			Mesh& mesh = meshes[i];
+			auto weldStart = Clock::now();
+			welded[i] = weldVertices(
+					vertices, 
+					indices, 
+					mesh.baseVertex, 
+					mesh.numVertices, 
+					mesh.baseIndex, 
+					mesh.numIndices, 
+					key);
+			auto optimizeStart = Clock::now();
+			optimized[i] = optimizeMesh(
+					vertices, 
+					indices, 
+					mesh.baseVertex, 
+					mesh.numVertices, 
+					mesh.baseIndex, 
+					mesh.numIndices, 
+					vertexStride, 
+					before[i], 
+					after[i]);
+			weldMs[i] = std::chrono::duration<double, std::milli>(optimizeStart - weldStart).count();
+			optimizeMs[i] = std::chrono::duration<double, std::milli>(Clock::now() - optimizeStart).count();
+		}
+	};
+	if (taskManager)
+		taskManager->parallelFor(meshes.size(), 1, optimize);
+	else
+		optimize(0, meshes.size());
+
+	// meshes indexing outside their vertices are not welded and can't move
+	if (std::find(welded.begin(), welded.end(), 0) == welded.end())
+		compactMeshes(vertices, indices, meshes);
+
+	double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	double totalWeldMs = 0.0, totalOptimizeMs = 0.0;
+	for (size_t i = 0; i < meshes.size(); ++i) {
+		totalWeldMs += weldMs[i];
+		totalOptimizeMs += optimizeMs[i];
+		if (optimized[i])
+			LOG("MESH %zu of %s: %u triangles, ACMR %.3f -> %.3f, overfetch %.3f -> %.3f at %zu bytes per vertex", 
+					i, name, meshes[i].numIndices / 3, before[i].acmr, after[i].acmr, 
+					before[i].overfetch, after[i].overfetch, vertexStride);
+	}
+	// per mesh times are summed over the workers
+	LOG("WELDED %s: %u -> %zu vertices (%.1f%%) in %.2f ms, reordered in %.2f ms, %.2f ms wall", 
+			name, numImported, vertices.size(), 
+			numImported ? 100.0 * vertices.size() / numImported : 100.0, 
+			totalWeldMs, totalOptimizeMs, ms);
+}
+
+};
+
+#endif
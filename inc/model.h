@@ -25,6 +25,7 @@
 #include "util.h"
 #include "pipeline_cache.h"
 #include "buffer_helper.h"
+#include "uniform_ring.h"
 #include "vulkan_image_creator.h"
 #include "vulkan_image_info.h"
 #include "vulkan_render_pass_creator.h"
@@ -33,9 +34,35 @@
 #include "pipeline_creator.h"
 #include "timer.h"
 #include "camera.h"
+#include "mesh_cache.h"
 
 class Model {
 public:
+	typedef int ModelFlags;
+	// Vertices are uploaded as PackedVertex
+	static constexpr int ModelFlag_packedVertices = 1;
+	// levels of detail per mesh, the full mesh included
+	static constexpr uint32_t MAX_LODS = 4;
+	// geometric error a level may show, over half the viewport height,
+	// about a pixel at 1080p
+	static constexpr float LOD_SCREEN_ERROR = 0.002f;
+	// a coarser level is picked once its error is this much below the limit,
+	// so meshes at the switching distance do not pop back and forth
+	static constexpr float LOD_HYSTERESIS = 0.25f;
+	// levels removing fewer triangles than this end the chain
+	static constexpr float LOD_MIN_REDUCTION = 0.1f;
+
+	// LOD chain built at import, part of the mesh cache key
+	struct LodSettings {
+		LodSettings(): numLods(MAX_LODS), reduction(0.5f), maxError(0.05f) {}
+		// 1 draws every mesh in full
+		uint32_t numLods;
+		// triangles each level keeps of the one before
+		float reduction;
+		// largest error of a level, relative to the radius of its mesh
+		float maxError;
+	};
+
 	struct Vertex {
 		glm::vec3 pos;
 		glm::vec3 normal;
@@ -44,6 +71,15 @@ public:
 		glm::vec2 texCoord;
 	};
 
+	// Vertex quantized for the GPU, 24 bytes instead of 56, see VertexPacking
+	struct PackedVertex {
+		glm::vec3 pos;
+		// quaternion of normal, tangent and bitangent, snorm16
+		int16_t tangentFrame[4];
+		// half floats
+		uint16_t texCoord[2];
+	};
+
 	struct UBO {
 	    glm::mat4 model;
 		glm::mat4 view;
@@ -68,11 +104,23 @@ public:
 		uint32_t minImages, maxImages;
 	}; 
 
+	// indices of a level, they share the vertices of the mesh
+	struct Lod {
+		uint32_t baseIndex, numIndices;
+		// relative to the radius of the mesh
+		float error;
+	};
+
 	struct Mesh {
-		Mesh(): baseVertex(0), numVertices(0), baseIndex(0), numIndices(0), materialIndex(0) {}
+		Mesh(): baseVertex(0), numVertices(0), baseIndex(0), numIndices(0), materialIndex(0), bounds(0.0f), numLods(0), lods() {}
 		uint32_t baseVertex, numVertices;
 		uint32_t baseIndex, numIndices;
 		uint32_t materialIndex;
+		// sphere around the vertices, xyz center and w radius
+		glm::vec4 bounds;
+		// level 0 is baseIndex and numIndices, coarser levels follow
+		uint32_t numLods;
+		Lod lods[MAX_LODS];
 	};
 
 	static const aiTextureType* TEXTURE_TYPES;
@@ -93,24 +141,39 @@ public:
 	static void convertVector(const aiVector3D& src, glm::vec3& dest);
 	static void convertVector(const aiVector3D& src, glm::vec2& dest);
 
-	Model(VulkanState& vulkanState);
+	Model(VulkanState& vulkanState, UniformRing& uniformRing);
 	virtual ~Model();
 
 	void init(const char* modelPath, 
-		unsigned int pFlags = DEFAULT_FLAGS);
+		unsigned int pFlags = DEFAULT_FLAGS, 
+		ModelFlags modelFlags = 0);
 	
 	void init(std::string modelPath, 
-		unsigned int pFlags = DEFAULT_FLAGS); 
+		unsigned int pFlags = DEFAULT_FLAGS, 
+		ModelFlags modelFlags = 0); 
 
 	void processModel(const aiScene& scene);
 	void createCommonBuffer(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+	void createCommonBuffer(const Vertex* vertices, uint32_t numVertices, const uint32_t* indices, uint32_t numIndices);
 	void createVertexBuffer(std::vector<Vertex>& vertices);
 	void createIndexBuffer(std::vector<uint32_t>& indices);
 	void createUniformBuffer();
 	void createDescriptorPool();
 	void createDescriptorSet();
 	void draw(VkCommandBuffer& commandBuffer, VkPipeline& pipeline, VkPipelineLayout& pipelineLayout);
-	void update(VkCommandBuffer& commandBuffer, const Timer& timer, Camera& camera);
+	void update(const Timer& timer, Camera& camera);
+	// off draws level 0 of every mesh
+	void setLodSelection(bool enabled) { mLodSelection = enabled; }
+	// by the draw of the last update
+	uint32_t trianglesDrawn() const { return mTrianglesDrawn; }
+	bool isPacked() const { return mPackedVertices; }
+	// bytes per vertex on the GPU
+	uint32_t vertexStride() const { return isPacked() ? sizeof(PackedVertex) : sizeof(Vertex); }
+	// 16 bit indices are relative to the first vertex of their mesh
+	VkIndexType indexType() const { return mIndexType; }
+	uint32_t indexSize() const { return mIndexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t); }
+	// of the vertex layout of the model
+	PipelineInfo& pipeline(Pipelines& pipelines) const;
 
 	void throwError(const char* error);
 	void throwError(std::string& error);
@@ -121,19 +184,51 @@ public:
 				 indexBufferOffset; 
 
 	UBO ubo;
+	// read by init
+	LodSettings lodSettings;
 
 protected:
+	// texture of a material as named by the model file, relative to mFolder
+	struct TextureRef {
+		uint32_t materialIndex;
+		aiTextureType type;
+		std::string path;
+	};
+
+	static void addMaterialImage(Material& material, aiTextureType type, ImageInfo* imageInfo);
+	// Simplifies every mesh into lodSettings.numLods levels, each from the one
+	// before, and appends their indices
+	void generateLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+	// level of each mesh by the size of its bounds on screen
+	void selectLods(Camera& camera);
+	bool loadCache(const std::string& cachePath);
+	void saveCache(
+			const std::string& cachePath, 
+			const std::vector<Vertex>& vertices, 
+			const std::vector<uint32_t>& indices,
+			const std::vector<TextureRef>& textures);
+
 	std::vector<Mesh> mMeshes;
+	// level each mesh draws
+	std::vector<uint32_t> mMeshLods;
+	bool mLodSelection;
+	uint32_t mTrianglesDrawn;
 	uint32_t mNumSamplerDescriptors;
 	VkDescriptorPool mDescriptorPool;
 	VkDescriptorSet mUniformDescriptorSet;
 
 	VulkanState& mState;
+	UniformRing& mUniformRing;
 	BufferInfo mCommonBufferInfo;
-	BufferInfo mCommonStagingBufferInfo;
+	bool mPackedVertices;
+	VkIndexType mIndexType;
 
 	std::string mPath, mFolder;
+	ModelFlags mModelFlags;
 	std::unordered_map<uint32_t, Material> mMaterialIndexToMaterial;
+	// set by init, processModel bakes the import into the cache when valid
+	MeshCache::Key mCacheKey;
+	bool mCacheable;
 };
 
 #endif
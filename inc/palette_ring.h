@@ -0,0 +1,55 @@
+#ifndef AMVK_PALETTE_RING_H
+#define AMVK_PALETTE_RING_H
+
+#ifdef __ANDROID__
+#include "vulkan_wrapper.h"
+#else
+#include <vulkan/vulkan.h>
+#endif
+
+#include <atomic>
+#include <algorithm>
+
+#include "macro.h"
+#include "vulkan_state.h"
+#include "vulkan_utils.h"
+#include "buffer_helper.h"
+
+// Bone palettes of every skinned instance, in one host visible storage buffer
+// split into a region per frame in flight like the UniformRing.
+// Instances write their bones to the region of the frame being built and pass
+// the index of the first vec4 in their uniforms, so skeletons of any size share
+// the one descriptor set of the ring, bound as set 2 of the skinned pipelines.
+class PaletteRing {
+public:
+	static constexpr VkDeviceSize DEFAULT_FRAME_SIZE = 4 * 1024 * 1024;
+
+	PaletteRing(VulkanState& vulkanState);
+	~PaletteRing();
+
+	PaletteRing(const PaletteRing& ring) = delete;
+	PaletteRing& operator=(const PaletteRing& ring) = delete;
+
+	// after the descriptor set layouts are created
+	void init(uint32_t numFrames, VkDeviceSize frameSize = DEFAULT_FRAME_SIZE);
+	// Starts writing into the region of frame, GPU must be done with it
+	void beginFrame(uint32_t frameIndex);
+	// Thread safe, returns the index of the first of count vec4 written to data
+	uint32_t allocate(uint32_t count, glm::vec4** data);
+
+	VkDescriptorSet descriptorSet() const;
+	// bytes allocated in the current frame
+	VkDeviceSize used() const;
+
+private:
+	VulkanState& mState;
+	BufferInfo mBufferInfo;
+	VkDescriptorPool mDescriptorPool;
+	VkDescriptorSet mDescriptorSet;
+	glm::vec4* mData;
+	uint32_t mFrameCount;
+	uint32_t mFrameOffset;
+	std::atomic<uint32_t> mHead;
+};
+
+#endif
@@ -140,7 +140,7 @@ inline VkPushConstantRange pushConstantRange(const VulkanState& state, VkShaderS
 		throw std::runtime_error("Push Constants size must be a multiple of 4");
 
 	VkPushConstantRange pushConstantRange = {};
-	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.stageFlags = stageFlags;
 	pushConstantRange.offset = offset;
 	pushConstantRange.size = size; 
 
@@ -88,7 +88,9 @@ inline void createQuadPipeline(VulkanState& state, PipelineInfo& info)
     cacheInfo.saveCache(state.device);
 }
 
-inline void createModelPipeline(VulkanState& state, PipelineInfo& info)
+// Packed vertices are expanded to floats by the vertex fetch, both layouts
+// share the shaders. Only the attributes the shaders read are described
+inline void createModelPipeline(VulkanState& state, PipelineInfo& info, bool packed, const char* cacheName)
 {
     VkPipelineShaderStageCreateInfo stages[] = {
             state.shaders.model.vertex,
@@ -97,19 +99,23 @@ inline void createModelPipeline(VulkanState& state, PipelineInfo& info)
 
     VkVertexInputBindingDescription bindingDesc = {};
     bindingDesc.binding = 0;
-    bindingDesc.stride = sizeof(Model::Vertex);
+    bindingDesc.stride = packed ? sizeof(Model::PackedVertex) : sizeof(Model::Vertex);
     bindingDesc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
     //location, binding, format, offset
     VkVertexInputAttributeDescription attrDesc[] = {
             { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Model::Vertex, pos) },
-            { 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Model::Vertex, normal) },
-            { 2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Model::Vertex, tangent) },
-            { 3, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Model::Vertex, bitangent) },
             { 4, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Model::Vertex, texCoord) }
     };
 
-    auto vertexInputInfo = PipelineCreator::vertexInputState(&bindingDesc, 1, attrDesc, ARRAY_SIZE(attrDesc));
+    VkVertexInputAttributeDescription packedAttrDesc[] = {
+            { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Model::PackedVertex, pos) },
+            { 4, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(Model::PackedVertex, texCoord) }
+    };
+
+    auto vertexInputInfo = packed ?
+            PipelineCreator::vertexInputState(&bindingDesc, 1, packedAttrDesc, ARRAY_SIZE(packedAttrDesc)) :
+            PipelineCreator::vertexInputState(&bindingDesc, 1, attrDesc, ARRAY_SIZE(attrDesc));
 
     VkPipelineInputAssemblyStateCreateInfo assemblyInfo = PipelineCreator::inputAssemblyNoRestart(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
     VkPipelineViewportStateCreateInfo viewportState = PipelineCreator::viewportStateDynamic();
@@ -138,7 +144,7 @@ inline void createModelPipeline(VulkanState& state, PipelineInfo& info)
     VkPipelineLayoutCreateInfo pipelineLayoutInfo = PipelineCreator::layout(layouts, ARRAY_SIZE(layouts), NULL, 0);
     VK_CHECK_RESULT(vkCreatePipelineLayout(state.device, &pipelineLayoutInfo, nullptr, &info.layout));
 
-    PipelineCacheInfo cacheInfo("model", info.cache);
+    PipelineCacheInfo cacheInfo(cacheName, info.cache);
     cacheInfo.getCache(state.device);
 
     VkGraphicsPipelineCreateInfo pipelineInfo = {};
@@ -153,7 +159,7 @@ inline void createModelPipeline(VulkanState& state, PipelineInfo& info)
     pipelineInfo.pDepthStencilState = &depthStencil;
     pipelineInfo.pColorBlendState = &blendState;
     pipelineInfo.pDynamicState = &dynamicInfo;
-    pipelineInfo.layout = state.pipelines.model.layout;
+    pipelineInfo.layout = info.layout;
     pipelineInfo.renderPass = state.renderPass;
     pipelineInfo.subpass = 0;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
@@ -162,36 +168,49 @@ inline void createModelPipeline(VulkanState& state, PipelineInfo& info)
 
     cacheInfo.saveCache(state.device);
 
-    LOG("MODEL PIPELINE CREATED");
+    LOG("MODEL PIPELINE CREATED: %s", cacheName);
 
 }
 
 
-inline void createSkinnedPipeline(VulkanState& state, PipelineInfo& info)
+// Skinned variants differ in how bones reach the vertex shader, all of them
+// read bones from the storage buffer of set 2. Each comes with float and
+// packed vertices, the sampler of a mesh is a fragment push constant
+inline void createSkinnedPipeline(
+        VulkanState& state, 
+        PipelineInfo& info, 
+        const ShaderInfo& shaders, 
+        bool packed,
+        const char* cacheName)
 {
     VkPipelineShaderStageCreateInfo stages[] = {
-            state.shaders.skinned.vertex,
-            state.shaders.skinned.fragment
+            shaders.vertex,
+            shaders.fragment
     };
 
     VkVertexInputBindingDescription bindingDesc = {};
     bindingDesc.binding = 0;
-    bindingDesc.stride = sizeof(Skinned::Vertex);
+    bindingDesc.stride = packed ? sizeof(Skinned::PackedVertex) : sizeof(Skinned::Vertex);
     bindingDesc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
     //location, binding, format, offset
     VkVertexInputAttributeDescription attrDesc[] = {
             { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Skinned::Vertex, pos) },
-            { 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Skinned::Vertex, normal) },
-            { 2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Skinned::Vertex, tangent) },
-            { 3, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Skinned::Vertex, bitangent) },
             { 4, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Skinned::Vertex, texCoord) },
             { 5, 0, VK_FORMAT_R32G32B32A32_UINT, offsetof(Skinned::Vertex, boneIndices) },
-            { 6, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Skinned::Vertex, weights) },
-            { 7, 0, VK_FORMAT_R32G32B32A32_UINT, offsetof(Skinned::Vertex, samplerIndices) },
+            { 6, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Skinned::Vertex, weights) }
     };
 
-    auto vertexInputInfo = PipelineCreator::vertexInputState(&bindingDesc, 1, attrDesc, ARRAY_SIZE(attrDesc));
+    VkVertexInputAttributeDescription packedAttrDesc[] = {
+            { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Skinned::PackedVertex, pos) },
+            { 4, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(Skinned::PackedVertex, texCoord) },
+            { 5, 0, VK_FORMAT_R8G8B8A8_UINT, offsetof(Skinned::PackedVertex, boneIndices) },
+            { 6, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(Skinned::PackedVertex, weights) }
+    };
+
+    auto vertexInputInfo = packed ?
+            PipelineCreator::vertexInputState(&bindingDesc, 1, packedAttrDesc, ARRAY_SIZE(packedAttrDesc)) :
+            PipelineCreator::vertexInputState(&bindingDesc, 1, attrDesc, ARRAY_SIZE(attrDesc));
 
     VkPipelineInputAssemblyStateCreateInfo assemblyInfo = PipelineCreator::inputAssemblyNoRestart(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
     VkPipelineViewportStateCreateInfo viewportState = PipelineCreator::viewportStateDynamic();
@@ -214,13 +233,20 @@ inline void createSkinnedPipeline(VulkanState& state, PipelineInfo& info)
 
     VkDescriptorSetLayout layouts[] = {
             state.descriptorSetLayouts.uniform,
-            state.descriptorSetLayouts.samplerList
+            state.descriptorSetLayouts.samplerList,
+            state.descriptorSetLayouts.storage
     };
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo = PipelineCreator::layout(layouts, ARRAY_SIZE(layouts), NULL, 0);
+    VkPushConstantRange pushConstantRange = PipelineCreator::pushConstantRange(
+            state,
+            VK_SHADER_STAGE_FRAGMENT_BIT,
+            0,
+            sizeof(Skinned::PushConstants));
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = PipelineCreator::layout(layouts, ARRAY_SIZE(layouts), &pushConstantRange, 1);
     VK_CHECK_RESULT(vkCreatePipelineLayout(state.device, &pipelineLayoutInfo, nullptr, &info.layout));
 
-    PipelineCacheInfo cacheInfo("skinned", info.cache);
+    PipelineCacheInfo cacheInfo(cacheName, info.cache);
     cacheInfo.getCache(state.device);
 
     VkGraphicsPipelineCreateInfo pipelineInfo = {};
@@ -235,7 +261,7 @@ inline void createSkinnedPipeline(VulkanState& state, PipelineInfo& info)
     pipelineInfo.pDepthStencilState = &depthStencil;
     pipelineInfo.pColorBlendState = &blendState;
     pipelineInfo.pDynamicState = &dynamicInfo;
-    pipelineInfo.layout = state.pipelines.skinned.layout;
+    pipelineInfo.layout = info.layout;
     pipelineInfo.renderPass = state.renderPass;
     pipelineInfo.subpass = 0;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
@@ -244,7 +270,7 @@ inline void createSkinnedPipeline(VulkanState& state, PipelineInfo& info)
 
     cacheInfo.saveCache(state.device);
 
-    LOG("SKINNED MODEL PIPELINE CREATED");
+    LOG("SKINNED MODEL PIPELINE CREATED: %s", cacheName);
 
 }
 
@@ -252,8 +278,16 @@ inline void createSkinnedPipeline(VulkanState& state, PipelineInfo& info)
 inline void createPipelines(VulkanState& state)
 {
     createQuadPipeline(state, state.pipelines.quad);
-    createModelPipeline(state, state.pipelines.model);
-    createSkinnedPipeline(state, state.pipelines.skinned);
+    createModelPipeline(state, state.pipelines.model, false, "model");
+    createModelPipeline(state, state.pipelines.modelPacked, true, "model_packed");
+    // bones of the frame from the palette ring
+    createSkinnedPipeline(state, state.pipelines.skinned, state.shaders.skinned, false, "skinned");
+    createSkinnedPipeline(state, state.pipelines.skinnedPacked, state.shaders.skinned, true, "skinned_packed");
+    // bones baked at load time, fetched from the palette buffer of the model
+    createSkinnedPipeline(state, state.pipelines.skinnedBaked, state.shaders.skinnedBaked, false, "skinned_baked");
+    createSkinnedPipeline(state, state.pipelines.skinnedBakedPacked, state.shaders.skinnedBaked, true, "skinned_baked_packed");
+    createSkinnedPipeline(state, state.pipelines.skinnedDualQuat, state.shaders.skinnedDualQuat, false, "skinned_dq");
+    createSkinnedPipeline(state, state.pipelines.skinnedDualQuatPacked, state.shaders.skinnedDualQuat, true, "skinned_dq_packed");
 }
 
 };
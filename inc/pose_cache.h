@@ -0,0 +1,87 @@
+#ifndef AMVK_POSE_CACHE_H
+#define AMVK_POSE_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <atomic>
+
+#include "macro.h"
+#include "anim_clip.h"
+
+// Bone palettes shared by every instance playing the same clip of the same
+// skeleton at the same time. Times are quantized to posesPerSecond. The first
+// instance asking for a pose in a frame claims it, evaluates it into its own
+// palette ring slot and publishes the offset, the others point their uniforms
+// at that offset, so the cost of a crowd follows the number of distinct poses,
+// not of instances, and nothing is copied.
+// Lookups are lock free, a per frame open addressing table of atomics. An
+// instance finding its pose still being evaluated evaluates its own copy
+// rather than wait.
+class PoseCache {
+public:
+	static constexpr double DEFAULT_POSES_PER_SECOND = 60.0;
+	static constexpr uint32_t DEFAULT_CAPACITY = 256;
+	static constexpr uint32_t INVALID_OFFSET = UINT32_MAX;
+
+	struct Stats {
+		uint32_t lookups, evaluations;
+	};
+
+	// table slot a missed lookup claimed, publish() fills it in
+	struct Claim {
+		Claim(): slot(INVALID_OFFSET) {}
+		bool isValid() const { return slot != INVALID_OFFSET; }
+		uint32_t slot;
+	};
+
+	PoseCache(double posesPerSecond = DEFAULT_POSES_PER_SECOND);
+	PoseCache(const PoseCache& poseCache) = delete;
+	PoseCache& operator=(const PoseCache& poseCache) = delete;
+
+	// Drops the poses of the previous frame and grows the table when it filled
+	// up, not while any lookup runs
+	void beginFrame();
+
+	// Ticks every instance within the quantization step of time samples
+	float poseTime(const AnimClip& clip, float time) const;
+
+	// Offset published for the pose of clip at time, INVALID_OFFSET on a miss.
+	// skeletonId and clipId identify the content and layout of the palette,
+	// equal for every instance of a model. The caller evaluates a miss at
+	// poseTime, and publishes where it wrote it when the lookup claimed the pose
+	uint32_t find(uint64_t skeletonId, uint32_t clipId, const AnimClip& clip, float time, Claim& claim);
+	void publish(const Claim& claim, uint32_t offset);
+
+	// of the frame so far, every miss is an evaluation
+	Stats stats() const;
+
+private:
+	struct Key {
+		bool operator==(const Key& other) const;
+		uint64_t skeletonId;
+		uint32_t clipId;
+		int64_t frame;
+	};
+
+	struct Slot {
+		// 0 while free, claims set it
+		std::atomic<uint64_t> hash;
+		// INVALID_OFFSET until published, the key is written before
+		std::atomic<uint32_t> offset;
+		Key key;
+	};
+
+	static uint64_t hashKey(const Key& key);
+	int64_t poseFrame(const AnimClip& clip, float time) const;
+	void resize(uint32_t capacity);
+
+	double mPosesPerSecond;
+	std::unique_ptr<Slot[]> mSlots;
+	uint32_t mCapacity;
+	// claims stop at 3/4 of the capacity, probes stay short
+	std::atomic<uint32_t> mNumClaimed;
+	std::atomic_bool mOverflowed;
+	std::atomic<uint32_t> mNumLookups, mNumEvaluations;
+};
+
+#endif
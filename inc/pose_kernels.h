@@ -0,0 +1,66 @@
+#ifndef AMVK_POSE_KERNELS_H
+#define AMVK_POSE_KERNELS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "macro.h"
+
+// Interpolation inputs of a batch of local transforms in structure of arrays
+// layout, one lane per node: the keys around the sample time of translation,
+// rotation and scale and the factor between them.
+// Lanes are padded to a multiple of MAX_LANES, padding holds identity inputs.
+struct PoseBatch {
+	static constexpr uint32_t MAX_LANES = 8;
+
+	enum Stream {
+		Stream_p0x, Stream_p0y, Stream_p0z,
+		Stream_p1x, Stream_p1y, Stream_p1z,
+		Stream_pt,
+		Stream_q0x, Stream_q0y, Stream_q0z, Stream_q0w,
+		Stream_q1x, Stream_q1y, Stream_q1z, Stream_q1w,
+		Stream_qt,
+		Stream_s0x, Stream_s0y, Stream_s0z,
+		Stream_s1x, Stream_s1y, Stream_s1z,
+		Stream_st,
+		NUM_STREAMS
+	};
+
+	PoseBatch(): count(0), paddedCount(0) {}
+
+	void resize(uint32_t count);
+	void setIdentity(uint32_t lane);
+
+	float* stream(Stream stream) { return streams[stream].data(); }
+	const float* stream(Stream stream) const { return streams[stream].data(); }
+
+	uint32_t count, paddedCount;
+	std::vector<float> streams[NUM_STREAMS];
+};
+
+// Batch kernels building TRS matrices from a PoseBatch: translations and scales
+// are lerped, rotations nlerped along the shortest arc with the factor corrected towards
+// slerp, then normalized.
+// SSE handles 4 lanes and AVX2 8 lanes per step, the widest one the CPU supports
+// is picked at runtime, other targets use the scalar kernel.
+namespace PoseKernels
+{
+
+enum Isa {
+	Isa_scalar,
+	Isa_sse,
+	Isa_avx2
+};
+
+// widest kernel supported by the CPU
+Isa detectIsa();
+bool isSupported(Isa isa);
+const char* isaName(Isa isa);
+
+// Writes batch.paddedCount column major matrices to out
+void composeTRS(const PoseBatch& batch, glm::mat4* out);
+void composeTRS(const PoseBatch& batch, glm::mat4* out, Isa isa);
+
+};
+
+#endif
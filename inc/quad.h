@@ -15,6 +15,7 @@
 #include <vector>
 
 #include "buffer_helper.h"
+#include "uniform_ring.h"
 #include "vulkan_image_creator.h"
 #include "vulkan_image_info.h"
 #include "vulkan_render_pass_creator.h"
@@ -51,11 +52,11 @@ public:
 
 	static void createPipeline(VulkanState& state);
 
-	Quad(VulkanState& vulkanState);
+	Quad(VulkanState& vulkanState, UniformRing& uniformRing);
 	~Quad();
 	void draw(VkCommandBuffer& commandBuffer); 
 	void init();
-	void update(VkCommandBuffer& commandBuffer, const Timer& timer, Camera& camera);
+	void update(const Timer& timer, Camera& camera);
 
 	uint32_t numIndices;
 	
@@ -64,8 +65,8 @@ public:
 				 mUniformBufferOffset;
 
 	VulkanState& mVulkanState;
+	UniformRing& mUniformRing;
 	BufferInfo mCommonBufferInfo;
-	BufferInfo mCommonStagingBufferInfo;
 	BufferInfo mVertexBufferDesc, mIndexBufferDesc, mUniformBufferDesc, mUniformStagingBufferDesc;
 	ImageInfo *mTextureDesc;
 	VkDescriptorSet mVkDescriptorSet;
@@ -22,6 +22,14 @@ inline void createShaders(VulkanState& state)
 
 	shaders.skinned.vertex = PipelineCreator::shaderStage(state.device, "skinned.vert", VK_SHADER_STAGE_VERTEX_BIT);
 	shaders.skinned.fragment = PipelineCreator::shaderStage(state.device, "skinned.frag", VK_SHADER_STAGE_FRAGMENT_BIT);
+
+	// variants share the fragment stage, bones are fetched from baked palettes
+	shaders.skinnedBaked.vertex = PipelineCreator::shaderStage(state.device, "skinned_baked.vert", VK_SHADER_STAGE_VERTEX_BIT);
+	shaders.skinnedBaked.fragment = shaders.skinned.fragment;
+
+	// bones as dual quaternions
+	shaders.skinnedDualQuat.vertex = PipelineCreator::shaderStage(state.device, "skinned_dq.vert", VK_SHADER_STAGE_VERTEX_BIT);
+	shaders.skinnedDualQuat.fragment = shaders.skinned.fragment;
 }
 
 
@@ -0,0 +1,57 @@
+#ifndef AMVK_SKELETON_H
+#define AMVK_SKELETON_H
+
+#include <cstdint>
+#include <vector>
+
+#include "macro.h"
+#include "anim_clip.h"
+
+#define BONE_INDEX_UNSET UINT32_MAX
+
+// Scratch memory of skeleton evaluation, one per thread, reused by every
+// skeleton the thread evaluates. Instances share a few warm buffers instead
+// of each keeping its own, and workers evaluate without locks
+struct PoseScratch {
+	// of the calling thread
+	static PoseScratch& local();
+
+	PoseBatch batch;
+	std::vector<uint8_t> animated;
+	std::vector<glm::mat4> localTransforms;
+	std::vector<glm::mat4> modelTransforms;
+	// for callers of computePalette, palettes converted or blended on their way
+	// to mapped memory
+	std::vector<glm::mat4> palette;
+};
+
+// Node hierarchy flattened depth first, a parent always precedes its children,
+// so model space transforms are computed in one pass from the front.
+// Matrices are column major, as the shaders read them.
+class Skeleton {
+public:
+	Skeleton();
+
+	// returns the index of the node, parent is -1 for the root
+	uint32_t addNode(int32_t parent, uint32_t boneIndex, const glm::mat4& transformation);
+	uint32_t numNodes() const { return (uint32_t) parents.size(); }
+	void clear();
+
+	// palette[bone] = model space transform of the bone node * bone offset,
+	// nodes the clip does not animate keep their bind transform.
+	// Keys of all nodes are gathered first and composed in one batch.
+	// Thread safe for different skeletons, works in PoseScratch::local()
+	void computePalette(const AnimClip& clip, float time, AnimClip::Cursor& cursor, glm::mat4* palette, uint32_t paletteSize);
+
+	std::vector<int32_t> parents;
+	// BONE_INDEX_UNSET for nodes that only carry the transforms of their descendant bones
+	std::vector<uint32_t> boneIndices;
+	// local bind transforms
+	std::vector<glm::mat4> transformations;
+	// mesh space to bone space, by bone index
+	std::vector<glm::mat4> boneOffsets;
+	// inverse root transform, applied at the root so every node inherits it
+	glm::mat4 modelSpaceTransform;
+};
+
+#endif
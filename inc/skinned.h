@@ -33,6 +33,8 @@
 #include "util.h"
 #include "pipeline_cache.h"
 #include "buffer_helper.h"
+#include "uniform_ring.h"
+#include "palette_ring.h"
 #include "vulkan_image_creator.h"
 #include "vulkan_image_info.h"
 #include "vulkan_render_pass_creator.h"
@@ -41,22 +43,42 @@
 #include "pipeline_creator.h"
 #include "timer.h"
 #include "camera.h"
-#include "anim_node.h"
-
-#define MAX_SAMPLERS_PER_VERTEX 4
+#include "anim_clip.h"
+#include "skeleton.h"
+#include "pose_cache.h"
+#include "anim_lod.h"
+#include "mesh_cache.h"
 
 class Skinned {
 public:
 	typedef int ModelFlags;
 	static constexpr int ModelFlag_stripFullPath = 1;
+	// Bone palettes of every clip are sampled at load time and fetched by the
+	// vertex shader, update only writes the clip time. For looping background characters
+	static constexpr int ModelFlag_bakeAnimations = 2;
+	// Bones are written as dual quaternions, 8 floats instead of 16, and blended without
+	// the volume loss of linear blending. Bones are rigid, any scale is dropped.
+	// Baked animations take precedence
+	static constexpr int ModelFlag_dualQuaternion = 4;
+	// Clips drop keys reproduced by their neighbours and quantize the rest,
+	// see AnimClip::compileCompressed
+	static constexpr int ModelFlag_compressAnimations = 8;
+	// Vertices are uploaded as PackedVertex, models with more bones than
+	// MAX_PACKED_BONES keep the float layout
+	static constexpr int ModelFlag_packedVertices = 16;
 	
 	static const aiTextureType* TEXTURE_TYPES;
 	static const uint32_t NUM_TEXTURE_TYPES;
 
 
 
-	static constexpr uint32_t const MAX_BONES = 64;
 	static constexpr uint32_t const MAX_BONES_PER_VERTEX = 4;
+	// bone indices of packed vertices are 8 bits
+	static constexpr uint32_t const MAX_PACKED_BONES = 256;
+	// baked frames, the vertex shader blends the two around the clip time
+	static constexpr uint32_t const BAKE_FRAMES_PER_SECOND = 30;
+	// animated poses reach outside the bounds of the bind pose
+	static constexpr float const BOUNDS_MARGIN = 1.5f;
 	static constexpr uint32_t const DEFAULT_FLAGS = 
 								aiProcess_Triangulate | 
 								aiProcess_GenSmoothNormals | 
@@ -72,6 +94,9 @@ public:
 
 	static void convertVector(const aiVector3D& src, glm::vec3& dest);
 	static void convertVector(const aiVector3D& src, glm::vec2& dest);
+	static glm::mat4 convertMatrix(const aiMatrix4x4& src);
+	// unit dual quaternion of the rigid part of a bone matrix, xyzw
+	static void convertDualQuat(const glm::mat4& src, glm::vec4& real, glm::vec4& dual);
 
 	struct Vertex {
 		glm::vec3 pos;
@@ -81,14 +106,53 @@ public:
 		glm::vec2 texCoord;
 		glm::uvec4 boneIndices;
 		glm::vec4 weights;
-		glm::uvec4 samplerIndices;
 	};
 
+	// Vertex quantized for the GPU, 36 bytes instead of 88, see VertexPacking
+	struct PackedVertex {
+		glm::vec3 pos;
+		// quaternion of normal, tangent and bitangent, snorm16
+		int16_t tangentFrame[4];
+		// half floats
+		uint16_t texCoord[2];
+		uint8_t boneIndices[MAX_BONES_PER_VERTEX];
+		// unorm16
+		uint16_t weights[MAX_BONES_PER_VERTEX];
+	};
+
+	// per mesh, the fragment shader samples the diffuse texture of the mesh material
+	struct PushConstants {
+		uint32_t samplerIndex;
+	};
+
+	// bones are in the palette ring, a matrix or a dual quaternion, rotation
+	// then translation part, per bone
 	struct UBO {
 	    glm::mat4 model;
 		glm::mat4 view;
 		glm::mat4 proj;
-		std::array<glm::mat4, MAX_BONES> bones;
+		// x: first vec4 of the bones in the palette ring
+		glm::uvec4 palette;
+	};
+
+	// uniforms of models with baked animations, bones stay in the palette buffer
+	struct BakedUBO {
+		glm::mat4 model;
+		glm::mat4 view;
+		glm::mat4 proj;
+		// x: frame position in the clip
+		glm::vec4 time;
+		// x: first frame of the clip, y: frames in the clip, z: bones per frame
+		glm::uvec4 clip;
+	};
+
+	// top three rows of a bone matrix, the last one is always 0, 0, 0, 1
+	struct BakedBone {
+		glm::vec4 rows[3];
+	};
+
+	struct BakedClip {
+		uint32_t baseFrame, numFrames;
 	};
 
 	struct MaterialTexture {
@@ -98,6 +162,8 @@ public:
 		uint32_t index;
 		aiTextureType type;
 		ImageInfo* image;
+		// relative to the model folder
+		std::string path;
 	};
 
 	struct Material {
@@ -112,14 +178,19 @@ public:
 		uint32_t materialIndex;
 	};
 
-	Skinned(VulkanState& vulkanState);
+	struct Animation {
+		double ticksPerSecond;
+		double duration;
+	};
+
+	Skinned(VulkanState& vulkanState, UniformRing& uniformRing, PaletteRing& paletteRing);
 	virtual ~Skinned();
 
 	void init(const char* modelPath, unsigned int pFlags = DEFAULT_FLAGS, ModelFlags modelFlags = 0);
 	
 	void init(std::string modelPath, unsigned int pFlags = DEFAULT_FLAGS, ModelFlags modelFlags = 0); 
 
-	void createAnimNode(aiNode* node, AnimNode* parent);
+	void createSkeletonNode(aiNode* node, int32_t parent, std::vector<std::vector<AnimChannel>>& channels);
 	void processMeshVertices(std::vector<Vertex>& vertices, aiMesh& mesh, Mesh& meshInfo);
 	void processMeshBones(
 			aiNode* node, 
@@ -133,20 +204,44 @@ public:
 	void processModel(const aiScene& scene);
 	
 	void createCommonBuffer(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+	void createCommonBuffer(const Vertex* vertices, uint32_t numVertices, const uint32_t* indices, uint32_t numIndices);
 	void createVertexBuffer(std::vector<Vertex>& vertices);
 	void createIndexBuffer(std::vector<uint32_t>& indices);
 	void createUniformBuffer();
 	void createDescriptorPool();
 	void createDescriptorSet();
 
-	void processAnimNode(float progress, aiMatrix4x4& parentTransform, AnimNode* animNode, uint32_t animationIndex);
-	void update(VkCommandBuffer& commandBuffer, const Timer& timer, Camera& camera, uint32_t animationIndex = 0);
+	// animate, then writeUniforms
+	void update(const Timer& timer, Camera& camera, uint32_t animationIndex = 0);
+	// Culls the instance and writes the palette of the frame to the palette ring.
+	// Instances animate in parallel, evaluation works in the scratch of the thread
+	void animate(const Timer& timer, Camera& camera, uint32_t animationIndex = 0);
+	// after animate, skipped for culled instances
+	void writeUniforms(Camera& camera);
+	// relative CPU cost of animate, 0 for baked animations
+	uint32_t animationCost() const { return isBaked() ? 0 : mSkeleton.numNodes(); }
 	void draw(VkCommandBuffer& commandBuffer, VkPipeline& pipeline, VkPipelineLayout& pipelineLayout);
+	bool isBaked() const { return !mBakedClips.empty(); }
+	bool isDualQuat() const { return !isBaked() && (mModelFlags & ModelFlag_dualQuaternion); }
+	bool isPacked() const { return mPackedVertices; }
+	// bytes per vertex on the GPU
+	uint32_t vertexStride() const { return isPacked() ? sizeof(PackedVertex) : sizeof(Vertex); }
+	// 16 bit indices are relative to the first vertex of their mesh
+	VkIndexType indexType() const { return mIndexType; }
+	uint32_t indexSize() const { return mIndexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t); }
+	// of the skinning mode and vertex layout of the model
+	PipelineInfo& pipeline(Pipelines& pipelines) const;
+	// bytes of the baked palette buffer, 0 when not baked
+	VkDeviceSize bakedPaletteSize() const { return mBakedPaletteInfo.size; }
 
 	void throwError(const char* error);
 	void throwError(std::string& error);
 	
 	float animSpeedScale;
+	// shares poses with other instances of the model when set
+	PoseCache* poseCache;
+	// evaluates less often far from the camera and not at all out of view when set
+	AnimLod* animLod;
 	uint32_t numVertices, numIndices, numBones, numSamplers;
 	VkDeviceSize uniformBufferOffset,  
 				 vertexBufferOffset, 
@@ -154,6 +249,32 @@ public:
 	UBO ubo;
 
 protected:
+	static void addMaterialTexture(Material& material, const MaterialTexture& texture);
+	// vertex with its attributes quantized for welding
+	static Vertex weldKey(const Vertex& vertex);
+	void compileClips(const std::vector<std::vector<AnimChannel>>& channels);
+	// Palette of the pose to the ring, shared with the instances evaluating
+	// the same pose when there is a pose cache. Returns its offset in the ring
+	uint32_t writePalette(const AnimClip& clip, uint32_t animationIndex, float time);
+	// Ring slot of the palette in ubo.palette, returns where to write its matrices,
+	// the slot itself or the scratch of the thread for dual quaternions
+	glm::mat4* allocatePalette(glm::vec4*& paletteData);
+	// converts the matrices to dual quaternions into the slot when needed
+	void finishPalette(const glm::mat4* palette, glm::vec4* paletteData);
+	// packed vertices are asked for and the bones fit their 8 bit indices
+	bool packsVertices() const { return (mModelFlags & ModelFlag_packedVertices) && numBones <= MAX_PACKED_BONES; }
+	// counted by the animation LOD
+	void evaluatePalette(const AnimClip& clip, float time, glm::mat4* palette);
+	// false when culled, updateInterval of the distance tier otherwise
+	bool updateVisibility(Camera& camera, uint32_t& updateInterval);
+	void bakeClips();
+	bool loadCache(const std::string& cachePath);
+	void saveCache(
+			const std::string& cachePath, 
+			const std::vector<Vertex>& vertices, 
+			const std::vector<uint32_t>& indices,
+			const std::vector<std::vector<AnimChannel>>& channels);
+
 	std::vector<Mesh> mMeshes;
 	uint32_t mNumSamplerDescriptors;
 	VkDescriptorPool mDescriptorPool;
@@ -161,21 +282,51 @@ protected:
 	VkDescriptorSet mSamplersDescriptorSet;
 
 	VulkanState& mState;
+	UniformRing& mUniformRing;
+	PaletteRing& mPaletteRing;
 	BufferInfo mCommonBufferInfo;
-	BufferInfo mCommonStagingBufferInfo;
+	bool mPackedVertices;
+	VkIndexType mIndexType;
 
 	std::string mPath, mFolder;
 	ModelFlags mModelFlags;
 
 	std::unordered_map<uint32_t, Material> mMaterialIndexToMaterial;
+	// diffuse sampler of every mesh, pushed before its draw
+	std::vector<uint32_t> mMeshSamplerIndices;
+	// set by init, processModel bakes the import into the cache when valid
+	MeshCache::Key mCacheKey;
+	bool mCacheable;
 
+	// only valid while importing, nodes and animations are copied out of it
     const aiScene* mScene;
-    Assimp::Importer importer;    
-    AnimNode* mAnimNodeRoot;
-    aiMatrix4x4 mModelSpaceTransform;
-
+    std::vector<Animation> mAnimations;
+    Skeleton mSkeleton;
+    // by animation, channels indexed by skeleton node
+    std::vector<AnimClip> mClips;
+    AnimClip::Cursor mCursor;
+    uint32_t mCursorAnimation;
+    // same for every instance imported from the same file with the same flags,
+    // identifies the palettes of its poses in the pose cache
+    uint64_t mSkeletonId;
+
+	std::vector<BakedClip> mBakedClips;
+	BufferInfo mBakedPaletteInfo;
+	VkDescriptorSet mBakedDescriptorSet;
+	BakedUBO mBakedUbo;
+
+	// model space bounding sphere of the bind pose, center and radius
+	glm::vec4 mBounds;
+	// culled instances are neither evaluated nor drawn
+	bool mVisible;
+	// palettes of the last two evaluations, blended until the next one,
+	// invalid after the instance was culled or changed clips
+	std::vector<glm::mat4> mPrevPalette, mNextPalette;
+	uint32_t mLodInterval, mLodFrame;
+	bool mLodValid;
+
+	// import only, nodes animating bones
 	std::unordered_map<aiNode*, uint32_t> mNodeToBoneIndexMap;
-	std::vector<aiMatrix4x4> mBoneTransforms;
 };
 
 #endif
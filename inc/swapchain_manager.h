@@ -12,6 +12,7 @@
 
 #include <vector>
 #include <array>
+#include <memory>
 
 #include "vulkan_state.h"
 #include "vulkan_utils.h"
@@ -27,11 +28,11 @@ public:
 	void createSurface();
 	void createSwapChain();
 	void createImageViews();
+	// Headless replacement for the swapchain, color images of the window size
+	void createOffscreenImages(uint32_t numImages);
 	void createDepthResources();
 	void createFramebuffers(VkRenderPass renderPass);
 	void createCommandPool();
-	void createCommandBuffers();
-	void createSemaphores();
 	void createRenderPass();
 
 	VkSurfaceFormatKHR getSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& surfaceFormats) const; 
@@ -41,15 +42,13 @@ public:
 	SwapChainDesc swapChainDesc;
 
 	std::vector<VkFramebuffer> framebuffers;
-	std::vector<VkCommandBuffer> cmdBuffers;
-
-	VkSemaphore mImageAvailableSemaphore, mRenderFinishedSemaphore;
 private:
 	VulkanState& mVulkanState;
 	Window& mWindow;
 
 	std::vector<VkImage> mSwapChainImages;
 	std::vector<VkImageView> mSwapChainImageViews;
+	std::vector<std::unique_ptr<ImageInfo>> mOffscreenImages;
 
 	ImageInfo mDepthImageDesc;
 
@@ -4,13 +4,20 @@
 #define AMVK_TASK_MANAGER_H
 
 #include <thread>
-#include <queue>
 #include <vector>
+#include <memory>
 #include <mutex>
 #include <functional>
 #include <atomic>
 #include <condition_variable>
 #include <chrono>
+#include <type_traits>
+#include <initializer_list>
+#include <algorithm>
+#include <deque>
+
+#include "job_queue.h"
+
 class Task {
 public:
 	virtual ~Task() {}
@@ -30,19 +37,173 @@ public:
 	}
 };
 
+// Completion counter of a job group.
+// Incremented on submit, decremented when a job of the group finishes.
+// Jobs submitted after a counter are held back until it drops to zero.
+class JobCounter {
+	friend class TaskManager;
+public:
+	JobCounter(): mValue(0), mNumCompleting(0) {}
+	JobCounter(const JobCounter& counter) = delete;
+	JobCounter& operator=(const JobCounter& counter) = delete;
+
+	int value() const { return mValue.load(); }
+	// also false while the last job is still releasing waiters,
+	// so the counter may be destroyed once done() returns true
+	bool done() const { return mValue.load() == 0 && mNumCompleting.load() == 0; }
+
+private:
+	std::atomic<int> mValue;
+	std::atomic<int> mNumCompleting;
+	std::mutex mWaitersMutex;
+	std::vector<Job*> mWaiters;
+};
+
+// Work stealing scheduler.
+// Every worker thread owns a job deque and a ring of preallocated jobs,
+// idle workers steal from the others. Threads outside of the pool submit
+// through a shared mutex guarded queue.
+// Background jobs, asset loads and imports, go to a separate FIFO queue that
+// idle workers take from, at most all but one at a time. wait() only runs them
+// on a thread already inside a background job, so frame jobs and the render
+// thread never pick up long running work while they wait. Jobs submitted from
+// a background job are background jobs too.
 class TaskManager {
 public:
 	TaskManager();
+	explicit TaskManager(size_t numThreads);
 	virtual ~TaskManager();
+
+	TaskManager(const TaskManager& taskManager) = delete;
+	void operator=(const TaskManager& taskManager) = delete;
+
+	template <class F, class = typename std::enable_if<
+		!std::is_convertible<F, Task*>::value &&
+		!std::is_base_of<Task, typename std::decay<F>::type>::value>::type>
+	void submit(F&& f)
+	{
+		submit(nullptr, 0, nullptr, std::forward<F>(f));
+	}
+
+	// job belongs to the counter group
+	template <class F>
+	void submit(JobCounter& counter, F&& f)
+	{
+		submit(nullptr, 0, &counter, std::forward<F>(f));
+	}
+
+	template <class F>
+	void submitBackground(JobCounter& counter, F&& f)
+	{
+		submitJob(nullptr, 0, &counter, true, std::forward<F>(f));
+	}
+
+	// job starts after every job of predecessor finished
+	template <class F>
+	void submitAfter(JobCounter& predecessor, JobCounter& counter, F&& f)
+	{
+		JobCounter* predecessors[] = { &predecessor };
+		submit(predecessors, 1, &counter, std::forward<F>(f));
+	}
+
+	template <class F>
+	void submitAfter(std::initializer_list<JobCounter*> predecessors, JobCounter& counter, F&& f)
+	{
+		submit(predecessors.begin(), predecessors.size(), &counter, std::forward<F>(f));
+	}
+
+	template <class F>
+	void submit(JobCounter* const* predecessors, size_t numPredecessors, JobCounter* counter, F&& f)
+	{
+		submitJob(predecessors, numPredecessors, counter, isInBackgroundJob(), std::forward<F>(f));
+	}
+
+	// Splits [0, count) into batches of batchSize, f(begin, end) per batch,
+	// and returns when all of them are done
+	template <class F>
+	void parallelFor(size_t count, size_t batchSize, F f)
+	{
+		JobCounter counter;
+		if (batchSize == 0)
+			batchSize = 1;
+		for (size_t begin = 0; begin < count; begin += batchSize) {
+			size_t end = std::min(begin + batchSize, count);
+			submit(counter, [&f, begin, end] () { f(begin, end); });
+		}
+		wait(counter);
+	}
+
+	// Runs pending jobs on the calling thread until the counter reaches zero,
+	// background jobs only when called from one
+	void wait(JobCounter& counter);
+
+	// takes ownership of task
 	void submit(Task* task);
+	// task must outlive its execution
 	void submit(Task& task);
+
+	size_t numThreads() const;
+	// worker of the calling thread, numThreads() for threads outside of the pool
+	size_t workerIndex() const;
+	// true while the calling thread runs a background job
+	bool isInBackgroundJob() const;
+
 private:
+	static constexpr uint32_t POOL_SIZE = JobQueue::CAPACITY;
+	static constexpr uint32_t SPIN_COUNT = 64;
+
+	struct Worker {
+		Worker(): nextJob(0) {}
+		JobQueue queue;
+		Job jobs[POOL_SIZE];
+		uint32_t nextJob;
+	};
+
+	template <class F>
+	void submitJob(JobCounter* const* predecessors, size_t numPredecessors, JobCounter* counter, bool background, F&& f)
+	{
+		Job* job = allocate();
+		job->set(std::forward<F>(f));
+		job->setCounter(counter);
+		job->setBackground(background);
+		if (counter)
+			counter->mValue.fetch_add(1);
+		if (addDependencies(job, predecessors, numPredecessors))
+			schedule(job);
+	}
+
+	Worker& currentWorker();
+	size_t currentWorkerIndex() const;
+	bool isExternal(Worker& worker) const;
+	Job* allocate();
+	bool addDependencies(Job* job, JobCounter* const* predecessors, size_t numPredecessors);
+	void schedule(Job* job);
+	void wakeWorker();
+	void execute(Job* job);
+	void complete(JobCounter& counter);
+	Job* findJob(size_t workerIndex);
+	bool runPendingJob();
+	// top level background job of an idle worker, within mMaxBackground
+	bool runBackgroundJob();
+	Job* popBackgroundJob();
+	bool hasRunnableJob() const;
+	void workerLoop(size_t workerIndex);
+
 	size_t mNumThreads;
 	std::atomic_bool mContinue;
+	std::atomic<int> mNumQueued;
+	std::atomic<int> mNumSleeping;
 	std::condition_variable mCondition;
+	std::mutex mSleepMutex;
+	// last worker is shared by threads outside of the pool
+	std::vector<std::unique_ptr<Worker>> mWorkers;
+	std::mutex mExternalMutex;
+	std::mutex mBackgroundMutex;
+	std::deque<Job*> mBackgroundJobs;
+	std::atomic<int> mNumBackgroundQueued;
+	std::atomic<int> mNumBackgroundRunning;
+	int mMaxBackground;
 	std::vector<std::thread> mPool;
-	std::queue<Task*> mTasks;
-	std::mutex mTasksMutex;
 };
 
 #endif
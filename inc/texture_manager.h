@@ -9,21 +9,22 @@
 #include <stb/stb_image.h>
 #include <unordered_map>
 #include <mutex> 
+#include <future>
 
 class TextureManager {
 public:
 	static TextureManager& getInstance();
 	static ImageInfo* load(	
 			VulkanState& state, 
-			const VkCommandPool& cmdPool, 
-			const VkQueue& cmdQueue,
 			const TextureDesc& textureDesc);
 	TextureManager(const TextureManager& textureManager) = delete;
 	void operator=(const TextureManager& textureManager) = delete;
 	virtual ~TextureManager();
 private:
 	TextureManager();
-	std::unordered_map<TextureDesc, ImageInfo*> mPool; 
+	// shared by models loading on different workers, 
+	// the first load of a texture decodes it, the others wait for the result
+	std::unordered_map<TextureDesc, std::shared_future<ImageInfo*>> mPool; 
 	std::mutex lock;
 };
 
@@ -8,6 +8,8 @@ class Timer {
 public:
 	Timer();
 	double tick();
+	// Advances by a fixed step instead of the clock, for reproducible runs
+	double step(double dt);
 	double total() const;
 	double dt() const;
 	uint32_t FPS() const;
@@ -0,0 +1,63 @@
+#ifndef AMVK_UNIFORM_RING_H
+#define AMVK_UNIFORM_RING_H
+
+#ifdef __ANDROID__
+#include "vulkan_wrapper.h"
+#else
+#include <vulkan/vulkan.h>
+#endif
+
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+
+#include "macro.h"
+#include "vulkan_state.h"
+#include "vulkan_utils.h"
+#include "buffer_helper.h"
+
+// Host visible uniform buffer, persistently mapped and split into one region
+// per frame in flight. Objects copy their UBO into the region of the frame
+// being built and bind it with a dynamic offset, so a frame never touches
+// uniforms the GPU may still read.
+class UniformRing {
+public:
+	static constexpr VkDeviceSize DEFAULT_FRAME_SIZE = 4 * 1024 * 1024;
+
+	UniformRing(VulkanState& vulkanState);
+	~UniformRing();
+
+	UniformRing(const UniformRing& ring) = delete;
+	UniformRing& operator=(const UniformRing& ring) = delete;
+
+	void init(uint32_t numFrames, VkDeviceSize frameSize = DEFAULT_FRAME_SIZE);
+	// Starts writing into the region of frame, GPU must be done with it
+	void beginFrame(uint32_t frameIndex);
+	// Thread safe, returns dynamic offset of size bytes written to data
+	uint32_t allocate(VkDeviceSize size, void** data);
+
+	template <class T>
+	uint32_t write(const T& value)
+	{
+		void* data;
+		uint32_t offset = allocate(sizeof(T), &data);
+		memcpy(data, &value, sizeof(T));
+		return offset;
+	}
+
+	VkBuffer buffer() const;
+	VkDeviceSize frameSize() const;
+	// bytes allocated in the current frame
+	VkDeviceSize used() const;
+
+private:
+	VulkanState& mState;
+	BufferInfo mBufferInfo;
+	char* mData;
+	VkDeviceSize mAlignment;
+	VkDeviceSize mFrameSize;
+	VkDeviceSize mFrameOffset;
+	std::atomic<VkDeviceSize> mHead;
+};
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef AMVK_UPLOAD_MANAGER_H
+#define AMVK_UPLOAD_MANAGER_H
+
+#ifdef __ANDROID__
+#include "vulkan_wrapper.h"
+#else
+#include <vulkan/vulkan.h>
+#endif
+
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "macro.h"
+#include "vulkan_state.h"
+#include "vulkan_utils.h"
+#include "buffer_helper.h"
+
+// Serial of the batch an upload was recorded into
+struct UploadHandle {
+	UploadHandle(): batch(0) {}
+	explicit UploadHandle(uint64_t batch): batch(batch) {}
+	uint64_t batch;
+};
+
+// Batches staging copies and layout transitions into few submissions.
+// Data is copied into a persistently mapped staging ring right away, so the
+// source can be freed on return. Each submitted batch is tracked by a fence,
+// its staging range is recycled once the fence is signaled.
+// Uploads end with a barrier, later submissions on the graphics queue
+// see the data without waiting on the handle.
+// Thread safe, uploads may be recorded from workers. Submissions to the
+// graphics queue take VulkanState::queueMutex.
+class UploadManager {
+public:
+	static constexpr VkDeviceSize DEFAULT_STAGING_SIZE = 32 * 1024 * 1024;
+	static constexpr uint32_t MAX_BATCHES = 4;
+
+	UploadManager(VulkanState& vulkanState);
+	~UploadManager();
+
+	UploadManager(const UploadManager& uploadManager) = delete;
+	UploadManager& operator=(const UploadManager& uploadManager) = delete;
+
+	void init(VkDeviceSize stagingSize = DEFAULT_STAGING_SIZE);
+
+	UploadHandle uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+	// Whole color image, left in SHADER_READ_ONLY_OPTIMAL layout
+	UploadHandle uploadImage(VkImage dst, uint32_t width, uint32_t height, const void* pixels, VkDeviceSize size);
+	UploadHandle transitionLayout(
+			VkImage image,
+			VkImageLayout oldLayout,
+			VkImageLayout newLayout,
+			VkImageAspectFlags aspectMask,
+			VkAccessFlags srcAccessMask,
+			VkAccessFlags dstAccessMask);
+
+	// Submits recorded uploads without waiting for them
+	void flush();
+	bool isDone(UploadHandle handle);
+	void wait(UploadHandle handle);
+	void waitIdle();
+
+	uint64_t numSubmits() const;
+	uint64_t numBytes() const;
+
+private:
+	struct Batch {
+		Batch(): cmdBuffer(VK_NULL_HANDLE), fence(VK_NULL_HANDLE), serial(0), stagingEnd(0) {}
+		VkCommandBuffer cmdBuffer;
+		VkFence fence;
+		uint64_t serial;
+		// staging ring head once the batch was recorded
+		VkDeviceSize stagingEnd;
+		// uploads too big for the ring
+		std::vector<std::unique_ptr<BufferInfo>> dedicatedStaging;
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+	};
+
+	Batch& recordingBatch();
+	VkDeviceSize allocateStaging(VkDeviceSize size, VkBuffer& buffer, char** data);
+	void submit();
+	// retires the oldest submitted batch, false if there is none or it is not done
+	bool retire(bool block);
+
+	VulkanState& mState;
+	std::mutex mMutex;
+	VkCommandPool mCommandPool;
+	Batch mBatches[MAX_BATCHES];
+
+	BufferInfo mStaging;
+	char* mStagingData;
+	// monotonic positions in the staging ring, tail is released by retired batches
+	VkDeviceSize mStagingHead;
+	VkDeviceSize mStagingTail;
+
+	// batch being recorded, 0 when none
+	uint64_t mRecordingSerial;
+	uint64_t mNextSerial;
+	uint64_t mRetiredSerial;
+
+	uint64_t mNumSubmits;
+	uint64_t mNumBytes;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef AMVK_VERTEX_PACKING_H
+#define AMVK_VERTEX_PACKING_H
+
+#include <cstdint>
+
+#include "macro.h"
+
+// Quantizes vertex attributes into the formats the vertex fetch unit expands
+// back to floats, the shaders read packed and float layouts alike.
+namespace VertexPacking
+{
+
+// Tangent frame as a unit quaternion, snorm16 xyzw. The sign of w keeps the
+// handedness of the bitangent, w is never encoded as 0 so that sign survives.
+// Normal, tangent and bitangent of the frame do not need to be orthonormal
+void packTangentFrame(
+		const glm::vec3& normal,
+		const glm::vec3& tangent,
+		const glm::vec3& bitangent,
+		int16_t frame[4]);
+// normal, tangent and bitangent of a packed frame, for checking the packing
+void unpackTangentFrame(const int16_t frame[4], glm::vec3& normal, glm::vec3& tangent, glm::vec3& bitangent);
+
+// half floats
+void packHalf2(const glm::vec2& v, uint16_t packed[2]);
+
+// unorm16 weights summing to exactly 65535, the rounding error goes to the largest.
+// Vertices without bones keep all weights 0
+void packWeights(const glm::vec4& weights, uint16_t packed[4]);
+
+// Indices of one mesh relative to its first vertex, drawn with baseVertex as
+// vertex offset. False when the mesh has more vertices than 16 bits address
+// or an index outside its vertices
+bool packIndices16(
+		const uint32_t* indices, 
+		uint32_t numIndices, 
+		uint32_t baseVertex, 
+		uint32_t numVertices, 
+		uint16_t* packed);
+
+};
+
+#endif
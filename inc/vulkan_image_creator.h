@@ -16,6 +16,7 @@
 #include "buffer_helper.h"
 #include "vulkan_image_info.h"
 #include "texture_data.h"
+#include "upload_manager.h"
 #include "macro.h"
 
 namespace ImageHelper {
@@ -48,13 +49,12 @@ inline void createImage(
 	VkMemoryRequirements memReqs;
 	vkGetImageMemoryRequirements(state.device, imageDesc.image, &memReqs);
 
-	VkMemoryAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memReqs.size;
-	allocInfo.memoryTypeIndex = BufferHelper::getMemoryType(state.physicalDevice, memReqs.memoryTypeBits, properties);
-
-	VK_CHECK_RESULT(vkAllocateMemory(state.device, &allocInfo, nullptr, &imageDesc.memory));
-	vkBindImageMemory(state.device, imageDesc.image, imageDesc.memory, 0);
+	imageDesc.allocation = state.memoryAllocator->allocate(memReqs, properties, tiling == VK_IMAGE_TILING_LINEAR);
+	VK_CHECK_RESULT(vkBindImageMemory(
+			state.device, 
+			imageDesc.image, 
+			imageDesc.allocation.memory, 
+			imageDesc.allocation.offset));
 }
 
 inline void createImageView(
@@ -317,25 +317,8 @@ inline VkFormat findDepthFormat(VkPhysicalDevice& physicalDevice)
 inline void createStagedImage(
 		ImageInfo& imageInfo, 
 		const TextureData& textureData,
-		VulkanState& state,  
-		const VkCommandPool& cmdPool, 
-		const VkQueue& cmdQueue) 
- 
+		VulkanState& state) 
 {
-	// Create staging image
-	ImageInfo stagingDesc(state.device, textureData.width, textureData.height);
-
-	createImage(
-			state, 
-			stagingDesc, 
-			VK_FORMAT_R8G8B8A8_UNORM,
-			VK_IMAGE_TILING_LINEAR, 
-			VK_IMAGE_LAYOUT_PREINITIALIZED,
-			VK_IMAGE_USAGE_TRANSFER_SRC_BIT, 
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT); 
-	
-	BufferHelper::mapMemory(state.device, stagingDesc.memory, 0, textureData.size, textureData.pixels);
-	
 	createImage(
 			state, 
 			imageInfo, 
@@ -345,44 +328,13 @@ inline void createStagedImage(
 			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-	// Setup memory barriers to transition images
-	{
-	CmdPass cmd(state.device, cmdPool, cmdQueue);
-
-		transitionLayout(
-				cmd.buffer,
-				stagingDesc.image,
-				VK_FORMAT_R8G8B8A8_UNORM,
-				VK_IMAGE_LAYOUT_PREINITIALIZED, 
-				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				VK_IMAGE_ASPECT_COLOR_BIT,
-				0,
-				VK_ACCESS_TRANSFER_READ_BIT);
-
-		transitionLayout(
-				cmd.buffer,
-				imageInfo.image,
-				VK_FORMAT_R8G8B8A8_UNORM,
-				VK_IMAGE_LAYOUT_UNDEFINED, 
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_IMAGE_ASPECT_COLOR_BIT,
-				0,
-				VK_ACCESS_TRANSFER_WRITE_BIT);
-
-		// copy staging buffer to image
-
-		copyImage(cmd.buffer, stagingDesc.image, imageInfo.image, imageInfo.width, imageInfo.height);
-
-		transitionLayout(
-				cmd.buffer,
-				imageInfo.image,
-				VK_FORMAT_R8G8B8A8_UNORM, 
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-				VK_IMAGE_ASPECT_COLOR_BIT,
-				VK_ACCESS_TRANSFER_WRITE_BIT,
-				VK_ACCESS_SHADER_READ_BIT);
-	}
+	// Copied from the staging ring with the next upload batch
+	state.uploadManager->uploadImage(
+			imageInfo.image, 
+			imageInfo.width, 
+			imageInfo.height, 
+			textureData.pixels, 
+			textureData.size);
 
 	// Create ImageView
 
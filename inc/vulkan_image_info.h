@@ -9,6 +9,7 @@
 #endif
 
 #include "macro.h"
+#include "memory_allocator.h"
 
 class ImageInfo {
 public:
@@ -22,7 +23,7 @@ public:
 	uint32_t width, height;
 	VkImage image;
 	VkImageView imageView;
-	VkDeviceMemory memory;
+	MemoryAllocation allocation;
 	VkSampler sampler;
 	VkDevice* mVkDevice;
 private:
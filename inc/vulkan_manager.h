@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <unordered_set>
 #include <cstddef>
+#include <functional>
 
 
 #include "macro.h"
@@ -25,6 +26,13 @@
 #include "swapchain_manager.h"
 #include "shader_manager.h"
 #include "descriptor_manager.h"
+#include "task_manager.h"
+#include "worker_command_pools.h"
+#include "memory_allocator.h"
+#include "uniform_ring.h"
+#include "palette_ring.h"
+#include "upload_manager.h"
+#include "asset_loader.h"
 #include "quad.h"
 #include "model.h"
 #include "skinned.h"
@@ -35,30 +43,121 @@ class VulkanManager {
 	struct SwapChainDesc;
 public:
 
-	VulkanManager(Window& window);
+	static constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+	VulkanManager(Window& window, TaskManager& taskManager, uint32_t numFramesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
 	virtual ~VulkanManager();
-	void init();
+	// headless renders into offscreen images, without a window, surface or swapchain
+	void init(bool headless = false);
 
-	void buildCommandBuffers(const Timer &timer, Camera &camera);
+	// Waits for the current frame slot and records its updates and draws
 	void updateUniformBuffers(const Timer& timer, Camera& camera);
+	// Submits the current frame slot and moves on to the next one
 	void draw();
 	
 	void waitIdle();
 	void recreateSwapChain();
+	// Blocks until every background load is resident or failed
+	void waitForAssets();
+	// Added to the flags of every skinned model of the scene, before init.
+	// Benchmarks compare skinning modes with it. Vertices are packed by default
+	void setSkinnedModelFlags(Skinned::ModelFlags flags);
+	// same for the static models of the scene
+	void setModelFlags(Model::ModelFlags flags);
+	// off draws the static models of the scene in full, see Model::selectLods
+	void setMeshLod(bool enabled);
+	// by the static models of the last updated frame
+	uint32_t modelTrianglesDrawn() const;
+
+	// Milliseconds, of the last frame whose slot was waited on.
+	// GPU time is negative when the graphics queue has no timestamps
+	double lastGpuFrameTime() const;
+	double lastFenceWaitTime() const;
+	const VulkanState& getState() const;
+	// tiers of the skinned models of the scene, stats of the last recorded frame
+	AnimLod& getAnimLod();
 
 	//const VkDevice& getVkDevice() const;
 
 private:
+	struct SceneObject {
+		SceneObject(): async(false), asset(0), skinned(nullptr) {}
+		std::function<void(const Timer&, Camera&)> update;
+		std::function<void(VkCommandBuffer&)> draw;
+		// loaded in the background, drawn once the asset is resident
+		bool async;
+		AssetLoader::Handle asset;
+		// animated by the animation stage, ahead of update
+		Skinned* skinned;
+	};
+
+	// Everything the GPU may still use while the CPU builds the next frames
+	struct Frame {
+		Frame():
+			cmdBuffer(VK_NULL_HANDLE),
+			fence(VK_NULL_HANDLE),
+			imageAvailableSemaphore(VK_NULL_HANDLE),
+			renderFinishedSemaphore(VK_NULL_HANDLE),
+			timed(false) {}
+		VkCommandBuffer cmdBuffer;
+		VkFence fence;
+		VkSemaphore imageAvailableSemaphore;
+		VkSemaphore renderFinishedSemaphore;
+		std::vector<VkCommandBuffer> drawBuffers;
+		// timestamps were submitted and not read back yet
+		bool timed;
+	};
+
 	void updateUniformBuffer(const Timer& timer);
+	void createFrames();
+	void destroyFrames();
+	void createSceneObjects();
+	// Evaluates the skeletons of the visible skinned models on the workers,
+	// jobs are balanced by animation cost
+	void animateSceneObjects(const Timer& timer, Camera& camera);
+	// Updates scene objects in batches across workers and records their draws,
+	// one secondary buffer per batch, in object order
+	void recordSceneObjects(Frame& frame, const Timer& timer, Camera& camera);
+	void recordFrame(Frame& frame, uint32_t imageIndex);
+	void submitFrame(Frame& frame);
+	void readTimestamps(Frame& frame);
 
 	Window& mWindow;
+	TaskManager& mTaskManager;
 	VulkanState mState;
 	DeviceManager mDeviceManager;
+	// declared before every owner of buffers and images, so it is destroyed last
+	MemoryAllocator mMemoryAllocator;
 	SwapchainManager mSwapChainManager;
+	WorkerCommandPools mCommandPools;
+	UniformRing mUniformRing;
+	PaletteRing mPaletteRing;
+	UploadManager mUploadManager;
+	PoseCache mPoseCache;
+	AnimLod mAnimLod;
+	std::vector<SceneObject> mSceneObjects;
+	// indices of scene objects recorded this frame
+	std::vector<size_t> mVisibleObjects;
+	// skinned models of the visible objects, animated this frame
+	std::vector<Skinned*> mAnimatedModels;
+	uint32_t mNumFramesInFlight;
+	uint32_t mFrameIndex;
+	std::vector<Frame> mFrames;
+	// fence of the frame that last rendered into each swapchain image
+	std::vector<VkFence> mImageFences;
+	// two timestamps per frame slot, around its render pass
+	VkQueryPool mQueryPool;
+	double mLastGpuFrameTime;
+	double mLastFenceWaitTime;
 	Quad quad;
 	Model suit;
 	Skinned guard;
 	Skinned dwarf;
+	// after the models, so running loads are waited for before they are destroyed
+	AssetLoader mAssetLoader;
+	AssetLoader::Handle mSuitAsset, mDwarfAsset, mGuardAsset;
+	Skinned::ModelFlags mSkinnedModelFlags;
+	Model::ModelFlags mModelFlags;
 	uint32_t imageIndex;
 };
 
@@ -9,16 +9,30 @@
 #endif
 
 
+#include <string>
+#include <mutex>
+
 #include "swap_chain_desc.h"
 
+class MemoryAllocator;
+class UploadManager;
+class TaskManager;
+
 struct DeviceInfo {
 	DeviceInfo():
 		samplerAnisotropy(VK_FALSE),
 		maxPushConstantsSize(0),
-		minUniformBufferOffsetAlignment(0) {}
+		minUniformBufferOffsetAlignment(0),
+		timestampPeriod(0.0f),
+		timestampValidBits(0) {}
 	VkBool32 samplerAnisotropy;
 	uint32_t maxPushConstantsSize;
 	VkDeviceSize minUniformBufferOffsetAlignment;
+	// nanoseconds per timestamp tick
+	float timestampPeriod;
+	// of the graphics queue, 0 when it does not support timestamps
+	uint32_t timestampValidBits;
+	std::string deviceName;
 };
 
 struct PipelineInfo {
@@ -43,7 +57,13 @@ struct ShaderInfo {
 struct Pipelines {
 	PipelineInfo quad,
 				 model,
-				 skinned;
+				 modelPacked,
+				 skinned,
+				 skinnedBaked,
+				 skinnedDualQuat,
+				 skinnedPacked,
+				 skinnedBakedPacked,
+				 skinnedDualQuatPacked;
 };
 
 struct DescriptorSets {
@@ -55,13 +75,16 @@ struct DescriptorSetLayouts {
 						  model,
 						  uniform,
 						  sampler,
-						  samplerList;
+						  samplerList,
+						  storage;
 };
 
 struct Shaders {
 	ShaderInfo quad,
 			   model,
-			   skinned;
+			   skinned,
+			   skinnedBaked,
+			   skinnedDualQuat;
 };
 
 struct VulkanState {
@@ -73,7 +96,11 @@ struct VulkanState {
 		graphicsQueue(VK_NULL_HANDLE), 
 		presentQueue(VK_NULL_HANDLE),
 		commandPool(VK_NULL_HANDLE),
-		descriptorPool(VK_NULL_HANDLE)
+		descriptorPool(VK_NULL_HANDLE),
+		headless(false),
+		memoryAllocator(nullptr),
+		uploadManager(nullptr),
+		taskManager(nullptr)
 	{};
 	
 	// Disallow copy constructor for VulkanState.
@@ -92,6 +119,8 @@ struct VulkanState {
 	VkExtent2D swapChainExtent;
 	VkQueue graphicsQueue;
 	VkQueue presentQueue; 
+	// submissions come from the render thread and from uploads recorded on workers
+	std::mutex queueMutex;
 	uint32_t graphicsQueueIndex;
 	uint32_t presentQueueIndex;
 
@@ -102,10 +131,19 @@ struct VulkanState {
 
 	VkFormat depthFormat;
 
+	// no surface or swapchain, frames are rendered into offscreen images
+	bool headless;
+
 	DeviceInfo deviceInfo;
 	Pipelines pipelines;
 	Shaders shaders;
 	DescriptorSetLayouts descriptorSetLayouts;
+
+	// device services, owned by VulkanManager
+	MemoryAllocator* memoryAllocator;
+	UploadManager* uploadManager;
+	// owned by Engine, model imports spread their work over it
+	TaskManager* taskManager;
 };
 
 #endif
@@ -0,0 +1,58 @@
+#ifndef AMVK_WORKER_COMMAND_POOLS_H
+#define AMVK_WORKER_COMMAND_POOLS_H
+
+#ifdef __ANDROID__
+#include "vulkan_wrapper.h"
+#else
+#include <vulkan/vulkan.h>
+#endif
+
+#include <vector>
+
+#include "macro.h"
+#include "vulkan_state.h"
+#include "vulkan_utils.h"
+#include "task_manager.h"
+
+// Command pools for recording on TaskManager workers.
+// Every worker owns one pool per slot, so secondary command buffers are
+// recorded without locking. A slot is reset as a whole once the GPU is done
+// with every buffer allocated from it.
+// Threads outside of the pool share the last worker, only the render thread
+// may record from there.
+class WorkerCommandPools {
+public:
+	WorkerCommandPools(VulkanState& vulkanState, TaskManager& taskManager);
+	~WorkerCommandPools();
+
+	WorkerCommandPools(const WorkerCommandPools& pools) = delete;
+	WorkerCommandPools& operator=(const WorkerCommandPools& pools) = delete;
+
+	void init(uint32_t numSlots);
+	void reset(uint32_t slot);
+	// secondary command buffer from the calling worker's pool, valid until reset of the slot
+	VkCommandBuffer next(uint32_t slot);
+
+	uint32_t numSlots() const;
+
+private:
+	struct Pool {
+		Pool(): pool(VK_NULL_HANDLE), nextBuffer(0) {}
+		VkCommandPool pool;
+		std::vector<VkCommandBuffer> buffers;
+		size_t nextBuffer;
+		// keeps pools of different workers on separate cache lines
+		char padding[64];
+	};
+
+	Pool& pool(uint32_t slot, size_t workerIndex);
+	void destroy();
+
+	VulkanState& mState;
+	TaskManager& mTaskManager;
+	uint32_t mNumSlots;
+	size_t mNumWorkers;
+	std::vector<Pool> mPools;
+};
+
+#endif
@@ -9,10 +9,8 @@ layout(set = 0, binding = 0) uniform UniformBufferObject {
 
 
 
+// float or packed vertices, the vertex fetch expands either layout
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
-layout(location = 2) in vec3 inTangent;
-layout(location = 3) in vec3 inBitangent;
 layout(location = 4) in vec2 inTexCoord;
 
 
@@ -6,10 +6,14 @@ layout(set = 1, binding = 0) uniform sampler2D texSampler[SAMPLER_LIST_SIZE];
 //layout(binding = 3) uniform sampler2D texHeightSampler;
 //layout(binding = 4) uniform sampler2D texAmbientSampler;
 
+// diffuse texture of the mesh material
+layout(push_constant) uniform PushConstants {
+	uint samplerIndex;
+} pushConstants;
+
 layout(location = 0) in vec2 fragTexCoord;
-layout(location = 1) flat in uvec4 samplerIndices;
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = texture(texSampler[samplerIndices.x], fragTexCoord);
+    outColor = texture(texSampler[pushConstants.samplerIndex], fragTexCoord);
 }
@@ -1,34 +1,38 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-#define MAX_BONES 64
-
 layout(set = 0, binding = 0) uniform UniformBufferObject {
     mat4 model;
     mat4 view;
     mat4 proj;
-	mat4 bones[MAX_BONES];
+	// x: first vec4 of the bones in the palette
+	uvec4 palette;
 } ubo;
 
+// bone matrices of every instance in the frame, four columns each
+layout(set = 2, binding = 0) readonly buffer Palette {
+	vec4 columns[];
+} palette;
 
+// float or packed vertices, the vertex fetch expands either layout
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
-layout(location = 2) in vec3 inTangent;
-layout(location = 3) in vec3 inBitangent;
 layout(location = 4) in vec2 inTexCoord;
 layout(location = 5) in uvec4 inBoneIndices;
 layout(location = 6) in vec4 inWeights;
-layout(location = 7) in uvec4 inSamplerIndices;
 
 layout(location = 0) out vec2 fragTexCoord;
-layout(location = 1) out uvec4 samplerIndices;
+
+mat4 bone(uint index)
+{
+	uint base = ubo.palette.x + 4 * index;
+	return mat4(palette.columns[base], palette.columns[base + 1], palette.columns[base + 2], palette.columns[base + 3]);
+}
 
 void main() { 
-	mat4 boneTransform = ubo.bones[inBoneIndices.x] * inWeights.x;
-    boneTransform += ubo.bones[inBoneIndices.y] * inWeights.y;
-    boneTransform += ubo.bones[inBoneIndices.z] * inWeights.z;  
-    boneTransform += ubo.bones[inBoneIndices.w] * inWeights.w;
+	mat4 boneTransform = bone(inBoneIndices.x) * inWeights.x;
+    boneTransform += bone(inBoneIndices.y) * inWeights.y;
+    boneTransform += bone(inBoneIndices.z) * inWeights.z;  
+    boneTransform += bone(inBoneIndices.w) * inWeights.w;
     gl_Position = ubo.proj * ubo.view * ubo.model * boneTransform * vec4(inPosition, 1.0);
     fragTexCoord = inTexCoord;
-	samplerIndices = inSamplerIndices;
 }
@@ -0,0 +1,51 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+	// x: frame position in the clip
+	vec4 time;
+	// x: first frame of the clip, y: frames in the clip, z: bones per frame
+	uvec4 clip;
+} ubo;
+
+// bone matrices of every baked frame, the top three rows of each
+layout(set = 2, binding = 0) readonly buffer Palette {
+	vec4 rows[];
+} palette;
+
+// float or packed vertices, the vertex fetch expands either layout
+layout(location = 0) in vec3 inPosition;
+layout(location = 4) in vec2 inTexCoord;
+layout(location = 5) in uvec4 inBoneIndices;
+layout(location = 6) in vec4 inWeights;
+
+layout(location = 0) out vec2 fragTexCoord;
+
+// rows of the bone blended between the two baked frames around the clip time
+void boneRows(uint bone, uint base0, uint base1, float t, inout vec4 rows[3], float weight)
+{
+	for (int i = 0; i < 3; ++i)
+		rows[i] += mix(palette.rows[(base0 + bone) * 3 + i], palette.rows[(base1 + bone) * 3 + i], t) * weight;
+}
+
+void main() { 
+	uint frame0 = min(uint(ubo.time.x), ubo.clip.y - 1);
+	uint frame1 = min(frame0 + 1, ubo.clip.y - 1);
+	float t = fract(ubo.time.x);
+	uint base0 = (ubo.clip.x + frame0) * ubo.clip.z;
+	uint base1 = (ubo.clip.x + frame1) * ubo.clip.z;
+
+	vec4 rows[3] = vec4[3](vec4(0.0), vec4(0.0), vec4(0.0));
+	boneRows(inBoneIndices.x, base0, base1, t, rows, inWeights.x);
+	boneRows(inBoneIndices.y, base0, base1, t, rows, inWeights.y);
+	boneRows(inBoneIndices.z, base0, base1, t, rows, inWeights.z);
+	boneRows(inBoneIndices.w, base0, base1, t, rows, inWeights.w);
+
+	vec4 position = vec4(inPosition, 1.0);
+	vec4 skinned = vec4(dot(rows[0], position), dot(rows[1], position), dot(rows[2], position), 1.0);
+    gl_Position = ubo.proj * ubo.view * ubo.model * skinned;
+    fragTexCoord = inTexCoord;
+}
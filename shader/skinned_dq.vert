@@ -0,0 +1,58 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+	// x: first vec4 of the bones in the palette
+	uvec4 palette;
+} ubo;
+
+// unit dual quaternion per bone, rotation then translation part, xyzw
+layout(set = 2, binding = 0) readonly buffer Palette {
+	vec4 bones[];
+} palette;
+
+// float or packed vertices, the vertex fetch expands either layout
+layout(location = 0) in vec3 inPosition;
+layout(location = 4) in vec2 inTexCoord;
+layout(location = 5) in uvec4 inBoneIndices;
+layout(location = 6) in vec4 inWeights;
+
+layout(location = 0) out vec2 fragTexCoord;
+
+void main() { 
+	uint base = ubo.palette.x;
+	vec4 real0 = palette.bones[base + 2 * inBoneIndices.x];
+	vec4 real = real0 * inWeights.x;
+	vec4 dual = palette.bones[base + 2 * inBoneIndices.x + 1] * inWeights.x;
+
+	// q and -q are the same rotation, blend along the shortest arc from the first bone
+	vec4 realY = palette.bones[base + 2 * inBoneIndices.y];
+	float weightY = dot(real0, realY) < 0.0 ? -inWeights.y : inWeights.y;
+	real += realY * weightY;
+	dual += palette.bones[base + 2 * inBoneIndices.y + 1] * weightY;
+
+	vec4 realZ = palette.bones[base + 2 * inBoneIndices.z];
+	float weightZ = dot(real0, realZ) < 0.0 ? -inWeights.z : inWeights.z;
+	real += realZ * weightZ;
+	dual += palette.bones[base + 2 * inBoneIndices.z + 1] * weightZ;
+
+	vec4 realW = palette.bones[base + 2 * inBoneIndices.w];
+	float weightW = dot(real0, realW) < 0.0 ? -inWeights.w : inWeights.w;
+	real += realW * weightW;
+	dual += palette.bones[base + 2 * inBoneIndices.w + 1] * weightW;
+
+	float invLength = 1.0 / length(real);
+	real *= invLength;
+	dual *= invLength;
+
+	// rotate, then translate by 2 * dual * conjugate(real)
+	vec3 p = inPosition;
+	p += 2.0 * cross(real.xyz, cross(real.xyz, p) + real.w * p);
+	p += 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(p, 1.0);
+    fragTexCoord = inTexCoord;
+}
@@ -0,0 +1,417 @@
+#include "anim_clip.h"
+
+#include <algorithm>
+#include <cmath>
+
+const double AnimClip::DEFAULT_TICKS_PER_SECOND = 25.0;
+const double AnimClip::DEFAULT_TICKS_DURATION = 100.0;
+
+namespace
+{
+
+const float PACKED_MAX = 65535.0f;
+// packed rotation components, the top bit holds the index of the largest one
+const float PACKED_ROTATION_MAX = 32767.0f;
+const float SQRT2 = 1.41421356f;
+
+// first key at or before time, times and time in the same units
+template <typename T>
+uint32_t searchKey(const T* times, uint32_t count, float time, uint32_t maxSteps, uint32_t& cursorKey, float& t)
+{
+	uint32_t key = cursorKey;
+	bool found = key < count && time >= times[key];
+
+	// playing forward, the next key is usually the current one or the one after
+	for (uint32_t steps = 0; found && key + 1 < count && time >= times[key + 1]; ++steps) {
+		if (steps == maxSteps)
+			found = false;
+		else
+			++key;
+	}
+
+	if (!found) {
+		// looped or seeked
+		key = (uint32_t) (std::upper_bound(times, times + count, time) - times);
+		key = key > 0 ? key - 1 : 0;
+	}
+	cursorKey = key;
+
+	t = 0.0f;
+	if (key + 1 < count) {
+		float dt = (float) times[key + 1] - (float) times[key];
+		t = dt > 0.0f ? glm::clamp((time - (float) times[key]) / dt, 0.0f, 1.0f) : 0.0f;
+	}
+	return key;
+}
+
+glm::vec4 slerpShortest(const glm::vec4& q0, const glm::vec4& q1, float t)
+{
+	float cosAngle = glm::dot(q0, q1);
+	glm::vec4 end = cosAngle < 0.0f ? -q1 : q1;
+	cosAngle = std::abs(cosAngle);
+	if (cosAngle > 0.9995f)
+		return glm::normalize(glm::mix(q0, end, t));
+	float angle = std::acos(cosAngle);
+	return (std::sin((1.0f - t) * angle) * q0 + std::sin(t * angle) * end) / std::sin(angle);
+}
+
+glm::vec4 interpolateKeys(bool rotation, const glm::vec4& v0, const glm::vec4& v1, float t)
+{
+	return rotation ? slerpShortest(v0, v1, t) : glm::mix(v0, v1, t);
+}
+
+// angle between rotations, distance otherwise
+float keyError(bool rotation, const glm::vec4& v0, const glm::vec4& v1)
+{
+	if (rotation) {
+		// atan2 of the relative rotation conj(v0) * v1, xyzw. acos of the dot is
+		// all float rounding near 1, about 7e-4 rad, as large as the tolerances
+		glm::vec3 a(v0), b(v1);
+		glm::vec3 axis = v0.w * b - v1.w * a - glm::cross(a, b);
+		return 2.0f * std::atan2(glm::length(axis), std::abs(glm::dot(v0, v1)));
+	}
+	return glm::length(glm::vec3(v0) - glm::vec3(v1));
+}
+
+uint16_t packUnit(float value, float max)
+{
+	return (uint16_t) std::lround(glm::clamp(value, 0.0f, 1.0f) * max);
+}
+
+}
+
+AnimClip::Compression::Compression():
+	positionTolerance(1e-3f),
+	rotationTolerance(1e-3f),
+	scaleTolerance(1e-3f)
+{
+
+}
+
+AnimClip::Stats::Stats():
+	rawKeys(0),
+	keys(0),
+	rawBytes(0),
+	bytes(0),
+	maxPositionError(0.0f),
+	maxRotationError(0.0f),
+	maxScaleError(0.0f)
+{
+
+}
+
+AnimClip::AnimClip():
+	mTicksPerSecond(DEFAULT_TICKS_PER_SECOND),
+	mDuration(DEFAULT_TICKS_DURATION),
+	mCompressed(false),
+	mTimeScale(0.0f)
+{
+
+}
+
+void AnimClip::reset(size_t numNodes, double ticksPerSecond, double duration)
+{
+	mTicksPerSecond = ticksPerSecond;
+	mDuration = duration;
+	mChannels.assign(numNodes, Channel());
+	for (uint32_t i = 0; i < NUM_COMPONENTS; ++i) {
+		mTimes[i].clear();
+		mPackedTimes[i].clear();
+		mPackedKeys[i].clear();
+	}
+	mPositions.clear();
+	mRotations.clear();
+	mScales.clear();
+	mCompressed = false;
+	mTimeScale = duration > 0.0 ? (float) (PACKED_MAX / duration) : 0.0f;
+	mStats = Stats();
+	mStats.rawBytes = numNodes * sizeof(Channel);
+	mStats.bytes = mStats.rawBytes;
+}
+
+void AnimClip::compile(const std::vector<const AnimChannel*>& channels, double ticksPerSecond, double duration)
+{
+	reset(channels.size(), ticksPerSecond, duration);
+
+	for (size_t node = 0; node < channels.size(); ++node) {
+		if (!channels[node] || !channels[node]->animated)
+			continue;
+		const AnimChannel& animChannel = *channels[node];
+		Channel& channel = mChannels[node];
+		channel.animated = true;
+
+		Track& position = channel.tracks[Component_position];
+		position.base = (uint32_t) mPositions.size();
+		position.count = (uint32_t) animChannel.positionKeys.size();
+		for (const aiVectorKey& key : animChannel.positionKeys) {
+			mTimes[Component_position].push_back((float) key.mTime);
+			mPositions.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+		}
+
+		Track& rotation = channel.tracks[Component_rotation];
+		rotation.base = (uint32_t) mRotations.size();
+		rotation.count = (uint32_t) animChannel.rotationKeys.size();
+		for (const aiQuatKey& key : animChannel.rotationKeys) {
+			mTimes[Component_rotation].push_back((float) key.mTime);
+			mRotations.push_back(glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z));
+		}
+
+		Track& scaling = channel.tracks[Component_scaling];
+		scaling.base = (uint32_t) mScales.size();
+		scaling.count = (uint32_t) animChannel.scalingKeys.size();
+		for (const aiVectorKey& key : animChannel.scalingKeys) {
+			mTimes[Component_scaling].push_back((float) key.mTime);
+			mScales.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+		}
+	}
+
+	uint32_t numKeys = (uint32_t) (mPositions.size() + mRotations.size() + mScales.size());
+	mStats.rawKeys = numKeys;
+	mStats.keys = numKeys;
+	mStats.rawBytes += numKeys * sizeof(float)
+		+ (mPositions.size() + mScales.size()) * sizeof(glm::vec3)
+		+ mRotations.size() * sizeof(glm::quat);
+	mStats.bytes = mStats.rawBytes;
+}
+
+void AnimClip::compileCompressed(
+		const std::vector<const AnimChannel*>& channels,
+		double ticksPerSecond,
+		double duration,
+		const Compression& compression)
+{
+	reset(channels.size(), ticksPerSecond, duration);
+	mCompressed = true;
+
+	std::vector<float> times;
+	std::vector<glm::vec4> values;
+	for (size_t node = 0; node < channels.size(); ++node) {
+		if (!channels[node] || !channels[node]->animated)
+			continue;
+		const AnimChannel& animChannel = *channels[node];
+		Channel& channel = mChannels[node];
+		channel.animated = true;
+
+		times.clear();
+		values.clear();
+		for (const aiVectorKey& key : animChannel.positionKeys) {
+			times.push_back((float) key.mTime);
+			values.push_back(glm::vec4(key.mValue.x, key.mValue.y, key.mValue.z, 0.0f));
+		}
+		compressTrack(Component_position, channel.tracks[Component_position], times, values, compression.positionTolerance);
+
+		times.clear();
+		values.clear();
+		for (const aiQuatKey& key : animChannel.rotationKeys) {
+			times.push_back((float) key.mTime);
+			values.push_back(glm::normalize(glm::vec4(key.mValue.x, key.mValue.y, key.mValue.z, key.mValue.w)));
+		}
+		compressTrack(Component_rotation, channel.tracks[Component_rotation], times, values, compression.rotationTolerance);
+
+		times.clear();
+		values.clear();
+		for (const aiVectorKey& key : animChannel.scalingKeys) {
+			times.push_back((float) key.mTime);
+			values.push_back(glm::vec4(key.mValue.x, key.mValue.y, key.mValue.z, 0.0f));
+		}
+		compressTrack(Component_scaling, channel.tracks[Component_scaling], times, values, compression.scaleTolerance);
+	}
+}
+
+void AnimClip::compressTrack(
+		Component component,
+		Track& track,
+		const std::vector<float>& times,
+		const std::vector<glm::vec4>& values,
+		float tolerance)
+{
+	bool rotation = component == Component_rotation;
+	uint32_t numKeys = (uint32_t) times.size();
+	mStats.rawKeys += numKeys;
+	mStats.rawBytes += numKeys * (sizeof(float) + (rotation ? sizeof(glm::quat) : sizeof(glm::vec3)));
+
+	track.base = (uint32_t) mPackedKeys[component].size();
+	track.count = 0;
+	if (numKeys == 0)
+		return;
+
+	// greedy, a key is dropped while interpolating from the last kept key to the
+	// one after it reproduces every key in between
+	std::vector<uint32_t> kept(1, 0);
+	uint32_t anchor = 0;
+	for (uint32_t i = 1; i + 1 < numKeys; ++i) {
+		float dt = times[i + 1] - times[anchor];
+		bool drop = true;
+		for (uint32_t j = anchor + 1; j <= i && drop; ++j) {
+			float t = dt > 0.0f ? (times[j] - times[anchor]) / dt : 0.0f;
+			drop = keyError(rotation, interpolateKeys(rotation, values[anchor], values[i + 1], t), values[j]) <= tolerance;
+		}
+		if (!drop) {
+			kept.push_back(i);
+			anchor = i;
+		}
+	}
+	bool constant = kept.size() == 1 && keyError(rotation, values[0], values[numKeys - 1]) <= tolerance;
+	if (numKeys > 1 && !constant)
+		kept.push_back(numKeys - 1);
+
+	glm::vec3 minValue(values[kept[0]]), maxValue(values[kept[0]]);
+	for (uint32_t k : kept) {
+		minValue = glm::min(minValue, glm::vec3(values[k]));
+		maxValue = glm::max(maxValue, glm::vec3(values[k]));
+	}
+	track.offset = minValue;
+	track.extent = maxValue - minValue;
+
+	for (uint32_t k : kept) {
+		float time = glm::clamp(times[k], 0.0f, (float) mDuration);
+		mPackedTimes[component].push_back((uint16_t) std::lround(time * mTimeScale));
+
+		PackedKey packed;
+		if (rotation) {
+			// the largest component is rebuilt from the unit length, q and -q are the
+			// same rotation so it is always positive
+			glm::vec4 q = values[k];
+			int largest = 0;
+			for (int i = 1; i < 4; ++i)
+				if (std::abs(q[i]) > std::abs(q[largest]))
+					largest = i;
+			if (q[largest] < 0.0f)
+				q = -q;
+			// the others are within +-1 / sqrt(2)
+			for (int i = 0, c = 0; i < 4; ++i)
+				if (i != largest)
+					packed.c[c++] = packUnit((q[i] * SQRT2 + 1.0f) * 0.5f, PACKED_ROTATION_MAX);
+			packed.c[0] |= (uint16_t) ((largest >> 1) << 15);
+			packed.c[1] |= (uint16_t) ((largest & 1) << 15);
+		} else {
+			for (int i = 0; i < 3; ++i)
+				packed.c[i] = track.extent[i] > 0.0f ? packUnit((values[k][i] - track.offset[i]) / track.extent[i], PACKED_MAX) : 0;
+		}
+		mPackedKeys[component].push_back(packed);
+	}
+	track.count = (uint32_t) kept.size();
+
+	mStats.keys += track.count;
+	mStats.bytes += track.count * (sizeof(uint16_t) + sizeof(PackedKey));
+
+	float& maxError = component == Component_position ? mStats.maxPositionError :
+					  component == Component_rotation ? mStats.maxRotationError : mStats.maxScaleError;
+	for (uint32_t i = 0; i < numKeys; ++i)
+		maxError = std::max(maxError, keyError(rotation, sampleTrack(component, track, times[i]), values[i]));
+}
+
+void AnimClip::resetCursor(Cursor& cursor) const
+{
+	cursor.keys.assign(mChannels.size() * NUM_COMPONENTS, 0);
+}
+
+uint32_t AnimClip::findKey(Component component, const Track& track, float time, uint32_t& cursorKey, float& t) const
+{
+	if (mCompressed)
+		return searchKey(mPackedTimes[component].data() + track.base, track.count, time * mTimeScale, MAX_CURSOR_STEPS, cursorKey, t);
+	return searchKey(mTimes[component].data() + track.base, track.count, time, MAX_CURSOR_STEPS, cursorKey, t);
+}
+
+glm::vec4 AnimClip::key(Component component, const Track& track, uint32_t key) const
+{
+	if (!mCompressed) {
+		switch (component) {
+			case Component_position:
+				return glm::vec4(mPositions[key], 0.0f);
+			case Component_rotation: {
+				const glm::quat& q = mRotations[key];
+				return glm::vec4(q.x, q.y, q.z, q.w);
+			}
+			default:
+				return glm::vec4(mScales[key], 0.0f);
+		}
+	}
+
+	const PackedKey& packed = mPackedKeys[component][key];
+	if (component != Component_rotation)
+		return glm::vec4(track.offset + glm::vec3(packed.c[0], packed.c[1], packed.c[2]) * (track.extent / PACKED_MAX), 0.0f);
+
+	uint32_t largest = ((packed.c[0] >> 15) << 1) | (packed.c[1] >> 15);
+	glm::vec4 q;
+	float sum = 0.0f;
+	for (uint32_t i = 0, c = 0; i < 4; ++i) {
+		if (i == largest)
+			continue;
+		q[i] = ((packed.c[c++] & 0x7fff) / PACKED_ROTATION_MAX * 2.0f - 1.0f) / SQRT2;
+		sum += q[i] * q[i];
+	}
+	q[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+	return q;
+}
+
+glm::vec4 AnimClip::sampleTrack(Component component, const Track& track, float time) const
+{
+	uint32_t cursorKey = 0;
+	float t;
+	uint32_t k = track.base + findKey(component, track, time, cursorKey, t);
+	glm::vec4 v0 = key(component, track, k);
+	return t > 0.0f ? interpolateKeys(component == Component_rotation, v0, key(component, track, k + 1), t) : v0;
+}
+
+bool AnimClip::sampleKeys(uint32_t node, float time, Cursor& cursor, PoseBatch& batch, uint32_t lane) const
+{
+	const Channel& channel = mChannels[node];
+	if (!channel.animated)
+		return false;
+
+	uint32_t* cursorKeys = &cursor.keys[node * NUM_COMPONENTS];
+	float t;
+
+	const Track& positionTrack = channel.tracks[Component_position];
+	glm::vec4 p0(0.0f), p1(0.0f);
+	t = 0.0f;
+	if (positionTrack.count > 0) {
+		uint32_t k = positionTrack.base + findKey(Component_position, positionTrack, time, cursorKeys[Component_position], t);
+		p0 = key(Component_position, positionTrack, k);
+		p1 = t > 0.0f ? key(Component_position, positionTrack, k + 1) : p0;
+	}
+	batch.streams[PoseBatch::Stream_p0x][lane] = p0.x;
+	batch.streams[PoseBatch::Stream_p0y][lane] = p0.y;
+	batch.streams[PoseBatch::Stream_p0z][lane] = p0.z;
+	batch.streams[PoseBatch::Stream_p1x][lane] = p1.x;
+	batch.streams[PoseBatch::Stream_p1y][lane] = p1.y;
+	batch.streams[PoseBatch::Stream_p1z][lane] = p1.z;
+	batch.streams[PoseBatch::Stream_pt][lane] = t;
+
+	const Track& rotationTrack = channel.tracks[Component_rotation];
+	// xyzw
+	glm::vec4 q0(0.0f, 0.0f, 0.0f, 1.0f), q1(0.0f, 0.0f, 0.0f, 1.0f);
+	t = 0.0f;
+	if (rotationTrack.count > 0) {
+		uint32_t k = rotationTrack.base + findKey(Component_rotation, rotationTrack, time, cursorKeys[Component_rotation], t);
+		q0 = key(Component_rotation, rotationTrack, k);
+		q1 = t > 0.0f ? key(Component_rotation, rotationTrack, k + 1) : q0;
+	}
+	batch.streams[PoseBatch::Stream_q0x][lane] = q0.x;
+	batch.streams[PoseBatch::Stream_q0y][lane] = q0.y;
+	batch.streams[PoseBatch::Stream_q0z][lane] = q0.z;
+	batch.streams[PoseBatch::Stream_q0w][lane] = q0.w;
+	batch.streams[PoseBatch::Stream_q1x][lane] = q1.x;
+	batch.streams[PoseBatch::Stream_q1y][lane] = q1.y;
+	batch.streams[PoseBatch::Stream_q1z][lane] = q1.z;
+	batch.streams[PoseBatch::Stream_q1w][lane] = q1.w;
+	batch.streams[PoseBatch::Stream_qt][lane] = t;
+
+	const Track& scalingTrack = channel.tracks[Component_scaling];
+	glm::vec4 s0(1.0f), s1(1.0f);
+	t = 0.0f;
+	if (scalingTrack.count > 0) {
+		uint32_t k = scalingTrack.base + findKey(Component_scaling, scalingTrack, time, cursorKeys[Component_scaling], t);
+		s0 = key(Component_scaling, scalingTrack, k);
+		s1 = t > 0.0f ? key(Component_scaling, scalingTrack, k + 1) : s0;
+	}
+	batch.streams[PoseBatch::Stream_s0x][lane] = s0.x;
+	batch.streams[PoseBatch::Stream_s0y][lane] = s0.y;
+	batch.streams[PoseBatch::Stream_s0z][lane] = s0.z;
+	batch.streams[PoseBatch::Stream_s1x][lane] = s1.x;
+	batch.streams[PoseBatch::Stream_s1y][lane] = s1.y;
+	batch.streams[PoseBatch::Stream_s1z][lane] = s1.z;
+	batch.streams[PoseBatch::Stream_st][lane] = t;
+	return true;
+}
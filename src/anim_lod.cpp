@@ -0,0 +1,80 @@
+#include "anim_lod.h"
+
+#include <limits>
+#include <stdexcept>
+
+std::vector<AnimLod::Tier> AnimLod::defaultTiers()
+{
+	return {
+		{ 25.0f, 1 },
+		{ 60.0f, 2 },
+		{ 150.0f, 4 },
+		{ std::numeric_limits<float>::max(), 8 }
+	};
+}
+
+AnimLod::AnimLod():
+	mTiers(defaultTiers()),
+	mCulling(true),
+	mNumEvaluated(0),
+	mNumInterpolated(0),
+	mNumCulled(0),
+	mNumBonesEvaluated(0)
+{
+
+}
+
+void AnimLod::setTiers(const std::vector<Tier>& tiers)
+{
+	if (tiers.empty())
+		throw std::runtime_error("Animation LOD needs at least one tier");
+	for (size_t i = 0; i < tiers.size(); ++i) {
+		if (tiers[i].updateInterval == 0)
+			throw std::runtime_error("Animation LOD update interval must be at least 1");
+		if (i > 0 && tiers[i].maxDistance < tiers[i - 1].maxDistance)
+			throw std::runtime_error("Animation LOD tiers must be sorted by distance");
+	}
+	mTiers = tiers;
+}
+
+uint32_t AnimLod::updateInterval(float distance) const
+{
+	for (const Tier& tier : mTiers)
+		if (distance <= tier.maxDistance)
+			return tier.updateInterval;
+	return mTiers.back().updateInterval;
+}
+
+void AnimLod::beginFrame()
+{
+	mNumEvaluated = 0;
+	mNumInterpolated = 0;
+	mNumCulled = 0;
+	mNumBonesEvaluated = 0;
+}
+
+void AnimLod::addEvaluated(uint32_t numBones)
+{
+	++mNumEvaluated;
+	mNumBonesEvaluated += numBones;
+}
+
+void AnimLod::addInterpolated()
+{
+	++mNumInterpolated;
+}
+
+void AnimLod::addCulled()
+{
+	++mNumCulled;
+}
+
+AnimLod::Stats AnimLod::stats() const
+{
+	Stats stats;
+	stats.evaluated = mNumEvaluated.load();
+	stats.interpolated = mNumInterpolated.load();
+	stats.culled = mNumCulled.load();
+	stats.bonesEvaluated = mNumBonesEvaluated.load();
+	return stats;
+}
@@ -0,0 +1,89 @@
+#include "asset_loader.h"
+
+AssetLoader::AssetLoader(VulkanState& vulkanState, TaskManager& taskManager):
+	mState(vulkanState),
+	mTaskManager(taskManager)
+{
+
+}
+
+AssetLoader::~AssetLoader()
+{
+	mTaskManager.wait(mCounter);
+}
+
+AssetLoader::Handle AssetLoader::load(const char* name, std::function<void()> f)
+{
+	Asset* asset = new Asset();
+	asset->name = name;
+	asset->start = std::chrono::high_resolution_clock::now();
+
+	Handle handle;
+	{
+		std::lock_guard<std::mutex> lock(mAssetsMutex);
+		handle = (Handle) mAssets.size();
+		mAssets.emplace_back(asset);
+	}
+
+	// frame waits never pick up a load, see TaskManager
+	mTaskManager.submitBackground(mCounter, [asset, f] () {
+		try {
+			f();
+			asset->loaded.store(true);
+		} catch (const std::exception& e) {
+			LOG("ASSET FAILED %s: %s", asset->name.c_str(), e.what());
+			asset->state.store(State_failed);
+		}
+	});
+	return handle;
+}
+
+void AssetLoader::update()
+{
+	std::vector<Asset*> loaded;
+	{
+		std::lock_guard<std::mutex> lock(mAssetsMutex);
+		for (auto& asset : mAssets)
+			if (asset->state.load() == State_loading && asset->loaded.load())
+				loaded.push_back(asset.get());
+	}
+	if (loaded.empty())
+		return;
+
+	// uploads of every loaded asset are recorded, one flush submits them
+	// ahead of this frame on the same queue
+	mState.uploadManager->flush();
+	for (Asset* asset : loaded) {
+		asset->state.store(State_resident);
+		LOG("ASSET RESIDENT %s: %.1f ms", 
+				asset->name.c_str(), 
+				std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - asset->start).count());
+	}
+}
+
+void AssetLoader::waitAll()
+{
+	mTaskManager.wait(mCounter);
+	update();
+}
+
+AssetLoader::State AssetLoader::state(Handle handle) const
+{
+	std::lock_guard<std::mutex> lock(mAssetsMutex);
+	return (State) mAssets[handle]->state.load();
+}
+
+bool AssetLoader::isResident(Handle handle) const
+{
+	return state(handle) == State_resident;
+}
+
+uint32_t AssetLoader::numLoading() const
+{
+	std::lock_guard<std::mutex> lock(mAssetsMutex);
+	uint32_t numLoading = 0;
+	for (auto& asset : mAssets)
+		if (asset->state.load() == State_loading)
+			++numLoading;
+	return numLoading;
+}
@@ -0,0 +1,709 @@
+#include "benchmark.h"
+#include "task_manager.h"
+#include "anim_clip.h"
+#include "pose_kernels.h"
+#include "pose_cache.h"
+#include "file_manager.h"
+#include "engine.h"
+
+#include <queue>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+
+// Previous TaskManager implementation: one std::queue behind a mutex,
+// every task allocated with new. Kept only as the benchmark baseline.
+class LegacyTaskManager {
+public:
+	LegacyTaskManager(size_t numThreads):
+		mContinue(true)
+	{
+		for (size_t i = 0; i < numThreads; ++i) {
+			mPool.push_back(std::thread([this] () {
+				while (mContinue) {
+					Task* task = nullptr;
+					{
+						std::unique_lock<std::mutex> lock(mTasksMutex);
+						mCondition.wait(lock, [this] () -> bool {
+							return !mContinue || !mTasks.empty();
+						});
+						if (mContinue && !mTasks.empty()) {
+							task = mTasks.front();
+							mTasks.pop();
+						}
+					}
+					if (task) {
+						task->execute();
+						delete task;
+					}
+				}
+			}));
+		}
+	}
+
+	~LegacyTaskManager()
+	{
+		mContinue = false;
+		mCondition.notify_all();
+		for (auto& t : mPool)
+			t.join();
+		while (!mTasks.empty()) {
+			delete mTasks.front();
+			mTasks.pop();
+		}
+	}
+
+	void submit(Task* task)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mTasksMutex);
+			mTasks.push(task);
+		}
+		mCondition.notify_one();
+	}
+
+private:
+	std::atomic_bool mContinue;
+	std::condition_variable mCondition;
+	std::vector<std::thread> mPool;
+	std::queue<Task*> mTasks;
+	std::mutex mTasksMutex;
+};
+
+constexpr uint32_t NUM_JOBS = 1 << 18;
+constexpr uint32_t JOB_WORK = 64;
+
+inline void smallJob(std::atomic<uint32_t>& done)
+{
+	volatile uint32_t x = 1;
+	for (uint32_t i = 0; i < JOB_WORK; ++i)
+		x = x * 1664525u + 1013904223u;
+	done.fetch_add(1, std::memory_order_relaxed);
+}
+
+class LegacyLeafTask : public Task {
+public:
+	LegacyLeafTask(std::atomic<uint32_t>& done): mDone(done) {}
+	void execute() { smallJob(mDone); }
+private:
+	std::atomic<uint32_t>& mDone;
+};
+
+class LegacyProducerTask : public Task {
+public:
+	LegacyProducerTask(LegacyTaskManager& manager, std::atomic<uint32_t>& done, uint32_t numJobs):
+		mManager(manager), mDone(done), mNumJobs(numJobs) {}
+	void execute()
+	{
+		for (uint32_t i = 0; i < mNumJobs; ++i)
+			mManager.submit(new LegacyLeafTask(mDone));
+	}
+private:
+	LegacyTaskManager& mManager;
+	std::atomic<uint32_t>& mDone;
+	uint32_t mNumJobs;
+};
+
+void waitFor(std::atomic<uint32_t>& done, uint32_t count)
+{
+	while (done.load() < count)
+		std::this_thread::yield();
+}
+
+// Every thread produces its share of jobs, so submission itself is contended
+double runLegacy(size_t numThreads)
+{
+	std::atomic<uint32_t> done(0);
+	uint32_t perProducer = NUM_JOBS / numThreads;
+	uint32_t total = perProducer * numThreads;
+
+	LegacyTaskManager manager(numThreads);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < numThreads; ++i)
+		manager.submit(new LegacyProducerTask(manager, done, perProducer));
+	waitFor(done, total);
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	return total / seconds;
+}
+
+double runWorkStealing(size_t numThreads)
+{
+	std::atomic<uint32_t> done(0);
+	uint32_t perProducer = NUM_JOBS / numThreads;
+	uint32_t total = perProducer * numThreads;
+
+	TaskManager manager(numThreads);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < numThreads; ++i) {
+		manager.submit([&manager, &done, perProducer] () {
+			for (uint32_t j = 0; j < perProducer; ++j)
+				manager.submit([&done] () { smallJob(done); });
+		});
+	}
+	waitFor(done, total);
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	return total / seconds;
+}
+
+}
+
+void Benchmark::taskThroughput()
+{
+	LOG("TASK THROUGHPUT jobs: %u work: %u hw threads: %u", NUM_JOBS, JOB_WORK, std::thread::hardware_concurrency());
+	LOG("%8s %16s %16s %8s", "threads", "legacy jobs/s", "stealing jobs/s", "speedup");
+	for (size_t numThreads = 1; numThreads <= 64; numThreads *= 2) {
+		double legacy = runLegacy(numThreads);
+		double stealing = runWorkStealing(numThreads);
+		LOG("%8zu %16.0f %16.0f %7.2fx", numThreads, legacy, stealing, stealing / legacy);
+	}
+}
+
+namespace
+{
+
+struct FrameStats {
+	FrameStats(): count(0), mean(0.0), min(0.0), max(0.0), p50(0.0), p95(0.0), p99(0.0) {}
+	size_t count;
+	double mean, min, max, p50, p95, p99;
+};
+
+FrameStats computeStats(std::vector<double> samples)
+{
+	FrameStats stats;
+	if (samples.empty())
+		return stats;
+
+	std::sort(samples.begin(), samples.end());
+	auto percentile = [&samples] (double p) -> double {
+		size_t index = (size_t) (p * (samples.size() - 1) + 0.5);
+		return samples[index];
+	};
+
+	double sum = 0.0;
+	for (double sample : samples)
+		sum += sample;
+
+	stats.count = samples.size();
+	stats.mean = sum / samples.size();
+	stats.min = samples.front();
+	stats.max = samples.back();
+	stats.p50 = percentile(0.50);
+	stats.p95 = percentile(0.95);
+	stats.p99 = percentile(0.99);
+	return stats;
+}
+
+void writeStats(FILE* out, const char* name, const FrameStats& stats, bool last)
+{
+	if (stats.count == 0) {
+		fprintf(out, "  \"%s\": null%s\n", name, last ? "" : ",");
+		return;
+	}
+	fprintf(out, "  \"%s\": {\"count\": %zu, \"mean\": %.4f, \"min\": %.4f, \"max\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f}%s\n",
+			name, stats.count, stats.mean, stats.min, stats.max, stats.p50, stats.p95, stats.p99, last ? "" : ",");
+}
+
+}
+
+void Benchmark::frames(uint32_t numFrames, const char* outPath, Skinned::ModelFlags skinnedFlags, bool animLod, bool packedVertices, bool meshLod)
+{
+	// 60 Hz steps keep animation poses identical between runs
+	constexpr double FRAME_STEP = 1.0 / 60.0;
+
+	if (packedVertices)
+		skinnedFlags |= Skinned::ModelFlag_packedVertices;
+
+	Engine engine;
+	engine.getVulkanManager().setSkinnedModelFlags(skinnedFlags);
+	engine.getVulkanManager().setModelFlags(packedVertices ? Model::ModelFlag_packedVertices : 0);
+	engine.init(true);
+
+	VulkanManager& vulkanManager = engine.getVulkanManager();
+	if (!animLod) {
+		vulkanManager.getAnimLod().setTiers({ { std::numeric_limits<float>::max(), 1 } });
+		vulkanManager.getAnimLod().setCulling(false);
+	}
+	vulkanManager.setMeshLod(meshLod);
+	// measured frames draw the full scene
+	vulkanManager.waitForAssets();
+	Timer& timer = engine.getTimer();
+	Camera& camera = engine.getCamera();
+
+	std::vector<double> frameTimes, cpuTimes, gpuTimes, bonesEvaluated, modelTriangles;
+	frameTimes.reserve(numFrames);
+	bonesEvaluated.reserve(numFrames);
+	modelTriangles.reserve(numFrames);
+	cpuTimes.reserve(numFrames);
+	gpuTimes.reserve(numFrames);
+
+	for (uint32_t i = 0; i < NUM_WARMUP_FRAMES + numFrames; ++i) {
+		timer.step(FRAME_STEP);
+		auto start = std::chrono::high_resolution_clock::now();
+		vulkanManager.updateUniformBuffers(timer, camera);
+		vulkanManager.draw();
+		double frameTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		if (i < NUM_WARMUP_FRAMES)
+			continue;
+		frameTimes.push_back(frameTime);
+		bonesEvaluated.push_back(vulkanManager.getAnimLod().stats().bonesEvaluated);
+		modelTriangles.push_back(vulkanManager.modelTrianglesDrawn());
+		// time blocked on the frame fence is GPU bound, not CPU work
+		cpuTimes.push_back(frameTime - vulkanManager.lastFenceWaitTime());
+		// GPU time of the older frame whose slot was just waited on
+		if (vulkanManager.lastGpuFrameTime() >= 0.0)
+			gpuTimes.push_back(vulkanManager.lastGpuFrameTime());
+	}
+	vulkanManager.waitIdle();
+
+	if (!outPath)
+		outPath = DEFAULT_OUT_PATH;
+	bool toStdout = strcmp(outPath, "-") == 0;
+	FILE* out = toStdout ? stdout : fopen(outPath, "w");
+	if (!out)
+		throw std::runtime_error(std::string("Failed to open benchmark output: ") + outPath);
+
+	const VulkanState& state = vulkanManager.getState();
+	fprintf(out, "{\n");
+	fprintf(out, "  \"device\": \"%s\",\n", state.deviceInfo.deviceName.c_str());
+	fprintf(out, "  \"width\": %u,\n", state.swapChainExtent.width);
+	fprintf(out, "  \"height\": %u,\n", state.swapChainExtent.height);
+	fprintf(out, "  \"frames\": %u,\n", numFrames);
+	fprintf(out, "  \"warmup_frames\": %u,\n", NUM_WARMUP_FRAMES);
+	fprintf(out, "  \"worker_threads\": %zu,\n", engine.getTaskManager().numThreads());
+	bool dualQuat = skinnedFlags & Skinned::ModelFlag_dualQuaternion;
+	fprintf(out, "  \"skinning\": \"%s\",\n", dualQuat ? "dual_quaternion" : "linear");
+	// uploaded per skinned model and frame, bones go to the palette ring
+	fprintf(out, "  \"skinned_ubo_bytes\": %zu,\n", sizeof(Skinned::UBO));
+	fprintf(out, "  \"palette_bytes_per_bone\": %zu,\n", dualQuat ? 2 * sizeof(glm::vec4) : sizeof(glm::mat4));
+	// models with too many bones for packed vertices keep floats, see the load log
+	fprintf(out, "  \"vertices\": \"%s\",\n", packedVertices ? "packed" : "float");
+	fprintf(out, "  \"skinned_vertex_bytes\": %zu,\n", packedVertices ? sizeof(Skinned::PackedVertex) : sizeof(Skinned::Vertex));
+	fprintf(out, "  \"model_vertex_bytes\": %zu,\n", packedVertices ? sizeof(Model::PackedVertex) : sizeof(Model::Vertex));
+	writeStats(out, "frame_ms", computeStats(frameTimes), false);
+	writeStats(out, "cpu_ms", computeStats(cpuTimes), false);
+	fprintf(out, "  \"anim_lod\": %s,\n", animLod ? "true" : "false");
+	writeStats(out, "bones_evaluated", computeStats(bonesEvaluated), false);
+	fprintf(out, "  \"mesh_lod\": %s,\n", meshLod ? "true" : "false");
+	writeStats(out, "model_triangles", computeStats(modelTriangles), false);
+	writeStats(out, "gpu_ms", computeStats(gpuTimes), true);
+	fprintf(out, "}\n");
+
+	if (!toStdout) {
+		fclose(out);
+		LOG("BENCHMARK written to %s", outPath);
+	}
+}
+
+namespace
+{
+
+// Previous sampling: every component scans its keys from the first one
+// and is built as a full matrix. Kept only as the benchmark baseline.
+aiMatrix4x4 legacyTranslation(float progress, const std::vector<aiVectorKey>& keys)
+{
+	aiMatrix4x4 translation;
+	if (keys.empty())
+		return translation;
+	if (keys.size() == 1) {
+		aiMatrix4x4::Translation(keys[0].mValue, translation);
+		return translation;
+	}
+	for (size_t i = 0; i < keys.size() - 1; ++i) {
+		if (progress < keys[i + 1].mTime) {
+			float t = (progress - keys[i].mTime) / (keys[i + 1].mTime - keys[i].mTime);
+			if (t < 0.0f || t > 1.0f)
+				return translation;
+			aiMatrix4x4::Translation(keys[i].mValue + t * (keys[i + 1].mValue - keys[i].mValue), translation);
+			return translation;
+		}
+	}
+	return translation;
+}
+
+aiMatrix4x4 legacyRotation(float progress, const std::vector<aiQuatKey>& keys)
+{
+	if (keys.empty())
+		return aiMatrix4x4();
+	if (keys.size() == 1)
+		return aiMatrix4x4(keys[0].mValue.GetMatrix());
+	for (size_t i = 0; i < keys.size() - 1; ++i) {
+		if (progress < keys[i + 1].mTime) {
+			float t = (progress - keys[i].mTime) / (keys[i + 1].mTime - keys[i].mTime);
+			if (t < 0.0f || t > 1.0f)
+				return aiMatrix4x4();
+			aiQuaternion q;
+			aiQuaternion::Interpolate(q, keys[i].mValue, keys[i + 1].mValue, t);
+			q.Normalize();
+			return aiMatrix4x4(q.GetMatrix());
+		}
+	}
+	return aiMatrix4x4();
+}
+
+aiMatrix4x4 legacyScaling(float progress, const std::vector<aiVectorKey>& keys)
+{
+	aiMatrix4x4 scaling;
+	if (keys.empty())
+		return scaling;
+	if (keys.size() == 1) {
+		aiMatrix4x4::Scaling(keys[0].mValue, scaling);
+		return scaling;
+	}
+	for (size_t i = 0; i < keys.size() - 1; ++i) {
+		if (progress < keys[i + 1].mTime) {
+			float t = (progress - keys[i].mTime) / (keys[i + 1].mTime - keys[i].mTime);
+			if (t < 0.0f || t > 1.0f)
+				return scaling;
+			aiMatrix4x4::Scaling(keys[i].mValue + t * (keys[i + 1].mValue - keys[i].mValue), scaling);
+			return scaling;
+		}
+	}
+	return scaling;
+}
+
+constexpr uint32_t ANIM_BONES = 64;
+constexpr uint32_t ANIM_FRAMES = 2000;
+// 30 keys per second played at 60 Hz
+constexpr float ANIM_TICKS_PER_FRAME = 0.5f;
+
+// Bones without hierarchy, each played from its own point of the clip
+// so the whole clip is sampled whatever its length
+std::vector<AnimChannel> createAnimChannels(uint32_t numKeys)
+{
+	std::mt19937 random(numKeys);
+	std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+
+	std::vector<AnimChannel> channels(ANIM_BONES);
+	for (AnimChannel& channel : channels) {
+		channel.animated = true;
+		for (uint32_t k = 0; k < numKeys; ++k) {
+			aiQuaternion q(value(random), value(random), value(random), value(random));
+			q.Normalize();
+			channel.positionKeys.push_back(aiVectorKey(k, aiVector3D(value(random), value(random), value(random))));
+			channel.rotationKeys.push_back(aiQuatKey(k, q));
+			channel.scalingKeys.push_back(aiVectorKey(k, aiVector3D(1.0f + 0.1f * value(random))));
+		}
+	}
+	return channels;
+}
+
+float boneTime(uint32_t bone, uint32_t frame, float duration)
+{
+	return fmodf(bone * duration / ANIM_BONES + frame * ANIM_TICKS_PER_FRAME, duration);
+}
+
+template <class F>
+double nsPerSample(size_t numSamples, F f)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	float sum = f();
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+	// keeps the samples from being optimized away
+	volatile float sink = sum;
+	(void) sink;
+	return ns / numSamples;
+}
+
+template <class F>
+double nsPerBone(F f)
+{
+	return nsPerSample((size_t) ANIM_FRAMES * ANIM_BONES, f);
+}
+
+aiMatrix4x4 legacyTransform(float time, const AnimChannel& channel)
+{
+	return legacyTranslation(time, channel.positionKeys) * 
+			legacyRotation(time, channel.rotationKeys) * 
+			legacyScaling(time, channel.scalingKeys);
+}
+
+}
+
+void Benchmark::animationSampling()
+{
+	LOG("ANIMATION SAMPLING bones: %u frames: %u", ANIM_BONES, ANIM_FRAMES);
+	LOG("%8s %16s %16s %16s %16s %12s %12s %12s", 
+			"keys", "legacy ns/bone", "cursor ns/bone", "seek ns/bone", "packed ns/bone", "raw KB", "packed KB", "max rad");
+	for (uint32_t numKeys = 16; numKeys <= 16384; numKeys *= 4) {
+		std::vector<AnimChannel> channels = createAnimChannels(numKeys);
+		float duration = (float) (numKeys - 1);
+
+		double legacy = nsPerBone([&] () -> float {
+			float sum = 0.0f;
+			for (uint32_t frame = 0; frame < ANIM_FRAMES; ++frame) {
+				for (uint32_t bone = 0; bone < ANIM_BONES; ++bone) {
+					aiMatrix4x4 m = legacyTransform(boneTime(bone, frame, duration), channels[bone]);
+					sum += m.a4;
+				}
+			}
+			return sum;
+		});
+
+		std::vector<const AnimChannel*> clipChannels;
+		for (const AnimChannel& channel : channels)
+			clipChannels.push_back(&channel);
+		AnimClip clip;
+		clip.compile(clipChannels, AnimClip::DEFAULT_TICKS_PER_SECOND, duration);
+		AnimClip::Cursor cursor;
+		clip.resetCursor(cursor);
+		PoseBatch batch;
+		batch.resize(ANIM_BONES);
+		std::vector<glm::mat4> locals(batch.paddedCount);
+
+		double cursored = nsPerBone([&] () -> float {
+			float sum = 0.0f;
+			for (uint32_t frame = 0; frame < ANIM_FRAMES; ++frame) {
+				for (uint32_t bone = 0; bone < ANIM_BONES; ++bone)
+					clip.sampleKeys(bone, boneTime(bone, frame, duration), cursor, batch, bone);
+				PoseKernels::composeTRS(batch, locals.data());
+				sum += locals[frame % ANIM_BONES][3][0];
+			}
+			return sum;
+		});
+
+		// random times every sample, every lookup is a binary search
+		std::vector<float> times(ANIM_FRAMES);
+		std::mt19937 random(numKeys);
+		std::uniform_real_distribution<float> time(0.0f, duration);
+		for (float& t : times)
+			t = time(random);
+
+		double seek = nsPerBone([&] () -> float {
+			float sum = 0.0f;
+			for (uint32_t frame = 0; frame < ANIM_FRAMES; ++frame) {
+				for (uint32_t bone = 0; bone < ANIM_BONES; ++bone)
+					clip.sampleKeys(bone, times[frame], cursor, batch, bone);
+				PoseKernels::composeTRS(batch, locals.data());
+				sum += locals[frame % ANIM_BONES][3][0];
+			}
+			return sum;
+		});
+
+		// random keys leave nothing to drop, this is the cost of decoding
+		AnimClip packedClip;
+		packedClip.compileCompressed(clipChannels, AnimClip::DEFAULT_TICKS_PER_SECOND, duration, AnimClip::Compression());
+		packedClip.resetCursor(cursor);
+		double packed = nsPerBone([&] () -> float {
+			float sum = 0.0f;
+			for (uint32_t frame = 0; frame < ANIM_FRAMES; ++frame) {
+				for (uint32_t bone = 0; bone < ANIM_BONES; ++bone)
+					packedClip.sampleKeys(bone, boneTime(bone, frame, duration), cursor, batch, bone);
+				PoseKernels::composeTRS(batch, locals.data());
+				sum += locals[frame % ANIM_BONES][3][0];
+			}
+			return sum;
+		});
+		const AnimClip::Stats& stats = packedClip.stats();
+
+		LOG("%8u %16.1f %16.1f %16.1f %16.1f %12.1f %12.1f %12.6f", 
+				numKeys, legacy, cursored, seek, packed, 
+				stats.rawBytes / 1024.0, stats.bytes / 1024.0, stats.maxRotationError);
+	}
+}
+
+namespace
+{
+
+struct PoseClip {
+	std::string name;
+	std::vector<AnimChannel> channels;
+	double ticksPerSecond, duration;
+};
+
+// Channels of the first animation of a model, one bone per channel
+bool loadPoseClip(const char* name, const std::string& path, PoseClip& clip)
+{
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, 0);
+	if (!scene || scene->mNumAnimations == 0) {
+		LOG("POSE KERNELS skipping %s: %s", name, importer.GetErrorString());
+		return false;
+	}
+
+	const aiAnimation* animation = scene->mAnimations[0];
+	clip.name = name;
+	clip.ticksPerSecond = animation->mTicksPerSecond > 0.0 ? animation->mTicksPerSecond : AnimClip::DEFAULT_TICKS_PER_SECOND;
+	clip.duration = animation->mDuration > 0.0 ? animation->mDuration : AnimClip::DEFAULT_TICKS_DURATION;
+	clip.channels.resize(animation->mNumChannels);
+	for (uint32_t i = 0; i < animation->mNumChannels; ++i) {
+		const aiNodeAnim* nodeAnim = animation->mChannels[i];
+		AnimChannel& channel = clip.channels[i];
+		channel.animated = true;
+		channel.positionKeys.assign(nodeAnim->mPositionKeys, nodeAnim->mPositionKeys + nodeAnim->mNumPositionKeys);
+		channel.rotationKeys.assign(nodeAnim->mRotationKeys, nodeAnim->mRotationKeys + nodeAnim->mNumRotationKeys);
+		channel.scalingKeys.assign(nodeAnim->mScalingKeys, nodeAnim->mScalingKeys + nodeAnim->mNumScalingKeys);
+	}
+	return true;
+}
+
+float poseTime(const PoseClip& clip, uint32_t frame)
+{
+	// 60 Hz playback
+	return (float) fmod(frame * clip.ticksPerSecond / 60.0, clip.duration);
+}
+
+}
+
+void Benchmark::poseKernels()
+{
+	std::vector<PoseClip> clips(1);
+	clips[0].name = "synthetic";
+	clips[0].channels = createAnimChannels(64);
+	clips[0].ticksPerSecond = 30.0;
+	clips[0].duration = 63.0;
+
+	PoseClip clip;
+	if (loadPoseClip("guard", FileManager::getModelsPath("guard/boblampclean.md5mesh"), clip))
+		clips.push_back(std::move(clip));
+	if (loadPoseClip("dwarf", FileManager::getModelsPath("dwarf/dwarf2.ms3d"), clip))
+		clips.push_back(std::move(clip));
+
+	const PoseKernels::Isa isas[] = {PoseKernels::Isa_scalar, PoseKernels::Isa_sse, PoseKernels::Isa_avx2};
+
+	LOG("POSE KERNELS frames: %u detected: %s", ANIM_FRAMES, PoseKernels::isaName(PoseKernels::detectIsa()));
+	LOG("%10s %6s %8s %16s %16s %16s %12s", "clip", "bones", "kernel", "legacy ns/bone", "sample ns/bone", "compose ns/bone", "max error");
+	for (const PoseClip& poseClip : clips) {
+		uint32_t numBones = (uint32_t) poseClip.channels.size();
+		size_t numSamples = (size_t) ANIM_FRAMES * numBones;
+
+		double legacy = nsPerSample(numSamples, [&] () -> float {
+			float sum = 0.0f;
+			for (uint32_t frame = 0; frame < ANIM_FRAMES; ++frame) {
+				float time = poseTime(poseClip, frame);
+				for (uint32_t bone = 0; bone < numBones; ++bone)
+					sum += legacyTransform(time, poseClip.channels[bone]).a4;
+			}
+			return sum;
+		});
+
+		std::vector<const AnimChannel*> channels;
+		for (const AnimChannel& channel : poseClip.channels)
+			channels.push_back(&channel);
+		AnimClip animClip;
+		animClip.compile(channels, poseClip.ticksPerSecond, poseClip.duration);
+		AnimClip::Cursor cursor;
+		PoseBatch batch;
+		batch.resize(numBones);
+		std::vector<glm::mat4> locals(batch.paddedCount), reference(batch.paddedCount);
+
+		for (PoseKernels::Isa isa : isas) {
+			if (!PoseKernels::isSupported(isa))
+				continue;
+
+			animClip.resetCursor(cursor);
+			double sampled = nsPerSample(numSamples, [&] () -> float {
+				float sum = 0.0f;
+				for (uint32_t frame = 0; frame < ANIM_FRAMES; ++frame) {
+					float time = poseTime(poseClip, frame);
+					for (uint32_t bone = 0; bone < numBones; ++bone)
+						animClip.sampleKeys(bone, time, cursor, batch, bone);
+					PoseKernels::composeTRS(batch, locals.data(), isa);
+					sum += locals[frame % numBones][3][0];
+				}
+				return sum;
+			});
+
+			// keys of the last frame composed over and over
+			double composed = nsPerSample(numSamples, [&] () -> float {
+				float sum = 0.0f;
+				for (uint32_t frame = 0; frame < ANIM_FRAMES; ++frame) {
+					PoseKernels::composeTRS(batch, locals.data(), isa);
+					sum += locals[frame % numBones][3][0];
+				}
+				return sum;
+			});
+
+			// against the legacy matrices over the whole clip
+			float maxError = 0.0f;
+			animClip.resetCursor(cursor);
+			for (uint32_t frame = 0; frame < ANIM_FRAMES; frame += 7) {
+				float time = poseTime(poseClip, frame);
+				for (uint32_t bone = 0; bone < numBones; ++bone)
+					animClip.sampleKeys(bone, time, cursor, batch, bone);
+				PoseKernels::composeTRS(batch, locals.data(), isa);
+				for (uint32_t bone = 0; bone < numBones; ++bone) {
+					aiMatrix4x4 m = legacyTransform(time, poseClip.channels[bone]);
+					// aiMatrix4x4 is row major
+					for (uint32_t c = 0; c < 4; ++c)
+						for (uint32_t r = 0; r < 4; ++r)
+							maxError = std::max(maxError, std::abs(locals[bone][c][r] - m[r][c]));
+				}
+			}
+
+			LOG("%10s %6u %8s %16.1f %16.1f %16.1f %12.2e", poseClip.name.c_str(), numBones, PoseKernels::isaName(isa),
+					legacy, sampled, composed, maxError);
+		}
+	}
+}
+
+void Benchmark::poseCache()
+{
+	constexpr uint32_t NUM_INSTANCES = 256;
+	constexpr uint32_t NUM_FRAMES = 200;
+	constexpr double TICKS_PER_SECOND = 30.0;
+
+	std::vector<AnimChannel> channels = createAnimChannels(64);
+	std::vector<const AnimChannel*> clipChannels;
+	for (const AnimChannel& channel : channels)
+		clipChannels.push_back(&channel);
+	AnimClip clip;
+	clip.compile(clipChannels, TICKS_PER_SECOND, 63.0);
+
+	// binary tree of bones, every instance owns its skeleton and cursor as Skinned does
+	Skeleton skeleton;
+	for (uint32_t i = 0; i < ANIM_BONES; ++i)
+		skeleton.addNode(i == 0 ? -1 : (int32_t) (i - 1) / 2, i, glm::mat4(1.0f));
+	skeleton.boneOffsets.assign(ANIM_BONES, glm::mat4(1.0f));
+	std::vector<Skeleton> skeletons(NUM_INSTANCES, skeleton);
+	std::vector<AnimClip::Cursor> cursors(NUM_INSTANCES);
+	std::vector<glm::mat4> palettes(NUM_INSTANCES * ANIM_BONES);
+	std::vector<uint32_t> offsets(NUM_INSTANCES);
+
+	PoseCache poseCache;
+	LOG("POSE CACHE instances: %u bones: %u frames: %u", NUM_INSTANCES, ANIM_BONES, NUM_FRAMES);
+	LOG("%8s %16s %16s %12s", "poses", "direct ms/frame", "cached ms/frame", "evaluated");
+	for (uint32_t numPoses = 1; numPoses <= NUM_INSTANCES; numPoses *= 4) {
+		auto instanceTime = [&] (uint32_t instance, uint32_t frame) -> float {
+			// instances of a group start together
+			double seconds = frame / 60.0 + (instance % numPoses) * 0.37;
+			return (float) fmod(seconds * TICKS_PER_SECOND, clip.duration());
+		};
+		for (AnimClip::Cursor& cursor : cursors)
+			clip.resetCursor(cursor);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t frame = 0; frame < NUM_FRAMES; ++frame)
+			for (uint32_t i = 0; i < NUM_INSTANCES; ++i)
+				skeletons[i].computePalette(clip, instanceTime(i, frame), cursors[i], &palettes[i * ANIM_BONES], ANIM_BONES);
+		double direct = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / NUM_FRAMES;
+
+		uint32_t evaluations = 0;
+		start = std::chrono::high_resolution_clock::now();
+		for (uint32_t frame = 0; frame < NUM_FRAMES; ++frame) {
+			poseCache.beginFrame();
+			for (uint32_t i = 0; i < NUM_INSTANCES; ++i) {
+				// palettes stands in for the ring, hits only take the offset
+				PoseCache::Claim claim;
+				float time = instanceTime(i, frame);
+				offsets[i] = poseCache.find(0, 0, clip, time, claim);
+				if (offsets[i] != PoseCache::INVALID_OFFSET)
+					continue;
+				offsets[i] = i * ANIM_BONES;
+				skeletons[i].computePalette(clip, poseCache.poseTime(clip, time), cursors[i], &palettes[offsets[i]], ANIM_BONES);
+				poseCache.publish(claim, offsets[i]);
+			}
+			evaluations += poseCache.stats().evaluations;
+		}
+		double cached = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / NUM_FRAMES;
+
+		LOG("%8u %16.3f %16.3f %12.1f", numPoses, direct, cached, (double) evaluations / NUM_FRAMES);
+	}
+}
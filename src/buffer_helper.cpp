@@ -2,7 +2,6 @@
 
 BufferInfo::BufferInfo(const VkDevice& device):
 	buffer(VK_NULL_HANDLE),
-	memory(VK_NULL_HANDLE),
 	size(0),
 	mVkDevice(device)
 
@@ -13,7 +12,6 @@ BufferInfo::BufferInfo(const VkDevice& device):
 
 BufferInfo::BufferInfo(const VkDevice& device, VkDeviceSize size):
 	buffer(VK_NULL_HANDLE),
-	memory(VK_NULL_HANDLE),
 	size(size),
 	mVkDevice(device)
 {
@@ -24,8 +22,8 @@ BufferInfo::~BufferInfo()
 {
 	if (buffer != VK_NULL_HANDLE)
 		vkDestroyBuffer(mVkDevice, buffer, nullptr);
-	if (memory != VK_NULL_HANDLE)
-		vkFreeMemory(mVkDevice, memory, nullptr);
+	if (allocation.allocator)
+		allocation.allocator->free(allocation);
 }
 
 uint32_t BufferHelper::getMemoryType(
@@ -38,14 +36,16 @@ uint32_t BufferHelper::getMemoryType(
 
 	for (size_t i = 0; i < memProps.memoryTypeCount; ++i)
 		if ((typeFilter & (1 << i)) 
-		&& (memProps.memoryTypes[i].propertyFlags & flags))
+		&& (memProps.memoryTypes[i].propertyFlags & flags) == flags)
 			return i;
 	throw std::runtime_error("Failed to find memory type");
 }
 
 void BufferHelper::mapMemory(const VulkanState& state, BufferInfo& bufferInfo, const void* src) 
 {
-	mapMemory(state, bufferInfo.memory, 0, bufferInfo.size, src);
+	if (!bufferInfo.allocation.mapped)
+		throw std::runtime_error("Buffer memory is not host visible");
+	memcpy(bufferInfo.allocation.mapped, src, (size_t) bufferInfo.size);
 }
 
 void BufferHelper::mapMemory(const VulkanState& state, VkDeviceMemory& memory, VkDeviceSize size, const void* src) 
@@ -134,25 +134,31 @@ void BufferHelper::createBuffer(
 			VkBufferUsageFlags usage,
 			VkMemoryPropertyFlags prop) 
 {
-	createBuffer(
-			state.physicalDevice,
-			state.device,
-			bufferInfo.buffer,
-			bufferInfo.size,
-			bufferInfo.memory,
-			usage,
-			prop);
+	VkBufferCreateInfo buffInfo = {};
+	buffInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffInfo.size = bufferInfo.size;
+	buffInfo.usage = usage;
+	buffInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VK_CHECK_RESULT(vkCreateBuffer(state.device, &buffInfo, nullptr, &bufferInfo.buffer));
+	
+	VkMemoryRequirements memReqs;
+	vkGetBufferMemoryRequirements(state.device, bufferInfo.buffer, &memReqs);
 
+	// sub-allocated from a shared block
+	bufferInfo.allocation = state.memoryAllocator->allocate(memReqs, prop, true);
+	VK_CHECK_RESULT(vkBindBufferMemory(
+			state.device, 
+			bufferInfo.buffer, 
+			bufferInfo.allocation.memory, 
+			bufferInfo.allocation.offset));
 }
 
 void BufferHelper::createVertexBuffer(const VulkanState& state, BufferInfo& bufferInfo)
 {
 	createBuffer(
-			state.physicalDevice,
-			state.device,
-			bufferInfo.buffer,
-			bufferInfo.size,
-			bufferInfo.memory,
+			state,
+			bufferInfo,
 			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 }
@@ -160,15 +166,11 @@ void BufferHelper::createVertexBuffer(const VulkanState& state, BufferInfo& buff
 void BufferHelper::createCommonBuffer(const VulkanState& state, BufferInfo& bufferInfo)
 {
 	createBuffer(
-		state.physicalDevice,
-		state.device,
-		bufferInfo.buffer,
-		bufferInfo.size,
-		bufferInfo.memory,
+			state,
+			bufferInfo,
 		VK_BUFFER_USAGE_TRANSFER_DST_BIT 
-		| VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT 
-		| VK_BUFFER_USAGE_INDEX_BUFFER_BIT
-		| VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		| VK_BUFFER_USAGE_VERTEX_BUFFER_BIT 
+		| VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
 }
@@ -176,11 +178,8 @@ void BufferHelper::createCommonBuffer(const VulkanState& state, BufferInfo& buff
 void BufferHelper::createIndexBuffer(const VulkanState& state, BufferInfo& bufferInfo)
 {
 	createBuffer(
-			state.physicalDevice,
-			state.device,
-			bufferInfo.buffer,
-			bufferInfo.size,
-			bufferInfo.memory,
+			state,
+			bufferInfo,
 			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 }
@@ -188,25 +187,31 @@ void BufferHelper::createIndexBuffer(const VulkanState& state, BufferInfo& buffe
 void BufferHelper::createUniformBuffer(const VulkanState& state, BufferInfo& bufferInfo)
 {
 	createBuffer(
-			state.physicalDevice,
-			state.device,
-			bufferInfo.buffer,
-			bufferInfo.size,
-			bufferInfo.memory,
+			state,
+			bufferInfo,
 			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 }
 
+void BufferHelper::createStorageBuffer(const VulkanState& state, BufferInfo& bufferInfo)
+{
+	createBuffer(
+			state,
+			bufferInfo,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
 
 void BufferHelper::createStagingBuffer(
 			const VulkanState& state,
 			BufferInfo& bufferInfo) 
 {
-	createStagingBuffer(
+	createBuffer(
 			state,
-			bufferInfo.buffer,
-			bufferInfo.size,
-			bufferInfo.memory);
+			bufferInfo,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 }
 
 void BufferHelper::createStagingBuffer(
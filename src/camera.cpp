@@ -117,3 +117,34 @@ glm::mat4& Camera::proj()
 {
 	return mProj;
 }
+
+const glm::vec3& Camera::eye() const
+{
+	return mEye;
+}
+
+bool Camera::isSphereVisible(const glm::vec3& center, float radius) const
+{
+	// planes from the rows of the view projection, the near one is the OpenGL one,
+	// behind the zero to one near plane, which only keeps a few more spheres
+	glm::mat4 viewProj = mProj * mView;
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i)
+		rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+
+	glm::vec4 planes[] = {
+		rows[3] + rows[0],
+		rows[3] - rows[0],
+		rows[3] + rows[1],
+		rows[3] - rows[1],
+		rows[3] + rows[2],
+		rows[3] - rows[2]
+	};
+
+	for (const glm::vec4& plane : planes) {
+		float length = glm::length(glm::vec3(plane));
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius * length)
+			return false;
+	}
+	return true;
+}
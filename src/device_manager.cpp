@@ -124,14 +124,17 @@ void DeviceManager::createPhysicalDevice(SwapchainManager& swapchainManager)
 
 	for (const auto& device : devices) {
 		DeviceQueueIndicies dqi = getDeviceQueueFamilyIndices(device);
-		bool extenstionsSupported = deviceExtensionsSupported(device);
+		bool extenstionsSupported = mVulkanState.headless || deviceExtensionsSupported(device);
 		
 		if (!extenstionsSupported)
 			continue;
 
-		SwapChainDesc swapChainDesc = swapchainManager.getSwapChainDesc(device, mVulkanState.surface);
-		if (!swapChainDesc.supported()) 
-			continue;
+		SwapChainDesc swapChainDesc;
+		if (!mVulkanState.headless) {
+			swapChainDesc = swapchainManager.getSwapChainDesc(device, mVulkanState.surface);
+			if (!swapChainDesc.supported()) 
+				continue;
+		}
 
 		if (dqi.graphicsIndexSet() && dqi.supportedIndexSet()) {
 			mVulkanState.physicalDevice = device;
@@ -176,7 +179,8 @@ void DeviceManager::createLogicalDevice()
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.queueCreateInfoCount = (uint32_t) queueCreateInfos.size();
 	createInfo.pEnabledFeatures = &deviceFeatures;
-	createInfo.enabledExtensionCount = sDeviceExtensions.size();
+	// nothing is presented without a surface
+	createInfo.enabledExtensionCount = mVulkanState.headless ? 0 : sDeviceExtensions.size();
 	createInfo.ppEnabledExtensionNames = sDeviceExtensions.data();
 	
 #ifdef AMVK_DEBUG
@@ -201,6 +205,17 @@ void DeviceManager::createLogicalDevice()
 	mVulkanState.deviceInfo.samplerAnisotropy = physicalDeviceFeatures.samplerAnisotropy;
 	mVulkanState.deviceInfo.maxPushConstantsSize = physicalDeviceProperties.limits.maxPushConstantsSize;
 	mVulkanState.deviceInfo.minUniformBufferOffsetAlignment = physicalDeviceProperties.limits.minUniformBufferOffsetAlignment;
+	mVulkanState.deviceInfo.timestampPeriod = physicalDeviceProperties.limits.timestampPeriod;
+	mVulkanState.deviceInfo.deviceName = physicalDeviceProperties.deviceName;
+
+	uint32_t numQueueFamilies = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(mVulkanState.physicalDevice, &numQueueFamilies, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(numQueueFamilies);
+	vkGetPhysicalDeviceQueueFamilyProperties(mVulkanState.physicalDevice, &numQueueFamilies, queueFamilies.data());
+	mVulkanState.deviceInfo.timestampValidBits = queueFamilies[mVulkanState.graphicsQueueIndex].timestampValidBits;
+	LOG("DEVICE %s timestamp bits: %u", 
+			mVulkanState.deviceInfo.deviceName.c_str(), 
+			mVulkanState.deviceInfo.timestampValidBits);
 	LOG("ANISOTROPY %u", physicalDeviceFeatures.samplerAnisotropy);
 	LOG("MAX PUSH CONST SIZE max: %u", mVulkanState.deviceInfo.maxPushConstantsSize);
 
@@ -242,8 +257,9 @@ std::vector<const char*> DeviceManager::getExtensionNames()
 
     //throw std::runtime_error("DeviceManager::getExtensionNames is unsupported");
 #else
+    // headless instances need no window system extensions
     unsigned numExt = 0;
-    const char **ppExtenstions = glfwGetRequiredInstanceExtensions(&numExt);
+    const char **ppExtenstions = mVulkanState.headless ? nullptr : glfwGetRequiredInstanceExtensions(&numExt);
     extensions.reserve(numExt);
     for (unsigned i = 0; i < numExt; ++i)
         extensions.push_back(ppExtenstions[i]);
@@ -279,8 +295,10 @@ DeviceQueueIndicies DeviceManager::getDeviceQueueFamilyIndices(const VkPhysicalD
 			//if (prop.queueFlags & VK_QUEUE_TRANSFER_BIT) 
 			//	deviceQueueIndicies.setTransferIndex(i);
 
-			VkBool32 surfaceSupported = false;
-			VK_CHECK_RESULT(vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, mVulkanState.surface, &surfaceSupported));
+			// nothing is presented when headless, any graphics queue will do
+			VkBool32 surfaceSupported = (prop.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+			if (!mVulkanState.headless)
+				VK_CHECK_RESULT(vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, mVulkanState.surface, &surfaceSupported));
 
 			if (surfaceSupported) 
 				deviceQueueIndicies.setSupportedIndex(i);
@@ -10,7 +10,7 @@ Engine::~Engine()
 #ifdef __ANDROID__
 
 Engine::Engine():
-        mVulkanManager(mWindow),
+        mVulkanManager(mWindow, mTaskManager),
         isReady(false),
         hasFocus(false)
 {
@@ -26,7 +26,6 @@ void Engine::init(android_app* state)
     LOG("WINDOW ASPECT %f width: %u height: %u", mWindow.mAspect, mWindow.mWidth, mWindow.mHeight);
     mCamera.setAspect(mWindow.mAspect);
     mVulkanManager.init();
-    mVulkanManager.buildCommandBuffers(mTimer, mCamera);
 
     JNIEnv* jni;
     state->activity->vm->AttachCurrentThread(&jni, NULL);
@@ -111,7 +110,7 @@ void Engine::handleCmd(struct android_app *app, int32_t cmd)
 #else
 
 Engine::Engine():
-	mVulkanManager(mWindow)
+	mVulkanManager(mWindow, mTaskManager)
 {
 
 }
@@ -199,8 +198,16 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mode
 	}
 }
 
-void Engine::init()
+void Engine::init(bool headless)
 {
+	if (headless) {
+		mVulkanManager.init(true);
+		// no window, the offscreen images set the aspect
+		const VkExtent2D& extent = mVulkanManager.getState().swapChainExtent;
+		mCamera.setAspect((float) extent.width / extent.height);
+		return;
+	}
+
 	mWindow.initWindow(*this);
 	mWindow.setWindowSizeCallback(onWindowResized);
 	InputManager& inputManager = mWindow.getInputManager();
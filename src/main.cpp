@@ -119,13 +119,64 @@ Java_vulkan_melnichuk_al_amvk_MainNativeActivity_setForwardMovement(JNIEnv *env,
 
 #include <iostream>
 #include <string>
+#include <cstring>
 #include "macro.h"
 #include "task_manager.h"
+#include "benchmark.h"
 #include "engine.h"
 
 #include <GLFW/glfw3.h>
 
-int main() {
+int main(int argc, char** argv) {
+
+    bool bench = false;
+    uint32_t numFrames = Benchmark::DEFAULT_NUM_FRAMES;
+    const char* benchOut = nullptr;
+    Skinned::ModelFlags skinnedFlags = 0;
+    bool animLod = true;
+    bool packedVertices = true;
+    bool meshLod = true;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--bench-tasks") == 0) {
+            Benchmark::taskThroughput();
+            return 0;
+        } else if (strcmp(argv[i], "--bench-anim") == 0) {
+            Benchmark::animationSampling();
+            return 0;
+        } else if (strcmp(argv[i], "--bench-poses") == 0) {
+            Benchmark::poseKernels();
+            return 0;
+        } else if (strcmp(argv[i], "--bench-pose-cache") == 0) {
+            Benchmark::poseCache();
+            return 0;
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            bench = true;
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            numFrames = (uint32_t) std::stoul(argv[++i]);
+        } else if (strcmp(argv[i], "--bench-out") == 0 && i + 1 < argc) {
+            benchOut = argv[++i];
+        } else if (strcmp(argv[i], "--skinning") == 0 && i + 1 < argc) {
+            // lbs (default) or dq
+            if (strcmp(argv[++i], "dq") == 0)
+                skinnedFlags |= Skinned::ModelFlag_dualQuaternion;
+        } else if (strcmp(argv[i], "--anim-lod") == 0 && i + 1 < argc) {
+            // on (default) or off
+            animLod = strcmp(argv[++i], "off") != 0;
+        } else if (strcmp(argv[i], "--vertices") == 0 && i + 1 < argc) {
+            // packed (default) or float
+            packedVertices = strcmp(argv[++i], "float") != 0;
+        } else if (strcmp(argv[i], "--mesh-lod") == 0 && i + 1 < argc) {
+            // on (default) or off
+            meshLod = strcmp(argv[++i], "off") != 0;
+        }
+    }
+
+    // headless, runs without a display: myengine --bench [--frames N] [--bench-out file.json|-] [--skinning lbs|dq] [--anim-lod on|off]
+    //                                   [--vertices packed|float] [--mesh-lod on|off]
+    if (bench) {
+        Benchmark::frames(numFrames, benchOut, skinnedFlags, animLod, packedVertices, meshLod);
+        return 0;
+    }
 
     Engine engine;
     engine.init();
@@ -136,8 +187,6 @@ int main() {
     Timer& timer = engine.getTimer();
     Camera& camera = engine.getCamera();
 
-    vulkanManager.buildCommandBuffers(timer, camera);
-
     while (window.isOpen()) {
         inputManager.pollEvents();
         double dt = timer.tick();
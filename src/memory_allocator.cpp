@@ -0,0 +1,254 @@
+#include "memory_allocator.h"
+
+MemoryAllocator::MemoryAllocator(VulkanState& vulkanState):
+	mState(vulkanState),
+	mMemoryProperties(),
+	mBlockSize(DEFAULT_BLOCK_SIZE),
+	mNumDeviceAllocations(0)
+{
+
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+	for (auto& blocks : mBlocks) {
+		for (auto& block : blocks) {
+			if (block->numAllocations > 0)
+				LOG("MEMORY BLOCK LEAKED type: %u allocations: %u", block->memoryType, block->numAllocations);
+			if (block->mapped)
+				vkUnmapMemory(mState.device, block->memory);
+			vkFreeMemory(mState.device, block->memory, nullptr);
+		}
+		blocks.clear();
+	}
+}
+
+void MemoryAllocator::init(VkDeviceSize blockSize)
+{
+	mBlockSize = blockSize;
+	vkGetPhysicalDeviceMemoryProperties(mState.physicalDevice, &mMemoryProperties);
+}
+
+uint32_t MemoryAllocator::numDeviceAllocations() const
+{
+	return mNumDeviceAllocations;
+}
+
+MemoryAllocation MemoryAllocator::allocate(const VkMemoryRequirements& memReqs, VkMemoryPropertyFlags flags, bool linear)
+{
+	uint32_t memoryType = getMemoryType(memReqs.memoryTypeBits, flags);
+	VkDeviceSize alignment = memReqs.alignment > 0 ? memReqs.alignment : 1;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	// small heaps get smaller blocks
+	uint32_t heapIndex = mMemoryProperties.memoryTypes[memoryType].heapIndex;
+	VkDeviceSize blockSize = std::min(mBlockSize, mMemoryProperties.memoryHeaps[heapIndex].size / 8);
+
+	MemoryBlock* block = nullptr;
+	VkDeviceSize offset = 0;
+	if (memReqs.size > blockSize / 2) {
+		block = createBlock(memoryType, memReqs.size, linear, true);
+		allocateFrom(*block, memReqs.size, alignment, offset);
+	} else {
+		for (auto& candidate : mBlocks[memoryType]) {
+			if (!candidate->dedicated 
+			&& candidate->linear == linear 
+			&& allocateFrom(*candidate, memReqs.size, alignment, offset)) {
+				block = candidate.get();
+				break;
+			}
+		}
+		if (!block) {
+			block = createBlock(memoryType, blockSize, linear, false);
+			if (!allocateFrom(*block, memReqs.size, alignment, offset))
+				throw std::runtime_error("Failed to sub-allocate device memory");
+		}
+	}
+
+	block->used += memReqs.size;
+	++block->numAllocations;
+
+	MemoryAllocation allocation;
+	allocation.allocator = this;
+	allocation.block = block;
+	allocation.memory = block->memory;
+	allocation.offset = offset;
+	allocation.size = memReqs.size;
+	allocation.mapped = block->mapped ? block->mapped + offset : nullptr;
+	return allocation;
+}
+
+void MemoryAllocator::free(MemoryAllocation& allocation)
+{
+	if (!allocation.block)
+		return;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	MemoryBlock& block = *allocation.block;
+	auto& ranges = block.freeRanges;
+	VkDeviceSize offset = allocation.offset;
+	VkDeviceSize size = allocation.size;
+
+	// merge with the following and the preceding free range
+	auto next = ranges.lower_bound(offset);
+	if (next != ranges.end() && offset + size == next->first) {
+		size += next->second;
+		next = ranges.erase(next);
+	}
+	if (next != ranges.begin()) {
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == offset) {
+			offset = prev->first;
+			size += prev->second;
+			ranges.erase(prev);
+		}
+	}
+	ranges[offset] = size;
+
+	block.used -= allocation.size;
+	--block.numAllocations;
+	allocation = MemoryAllocation();
+
+	if (block.numAllocations > 0)
+		return;
+
+	// keep one empty block around, so load and unload cycles do not hit the driver
+	bool keep = !block.dedicated;
+	for (auto& other : mBlocks[block.memoryType]) {
+		if (other.get() != &block 
+		&& !other->dedicated 
+		&& other->linear == block.linear 
+		&& other->numAllocations == 0) {
+			keep = false;
+			break;
+		}
+	}
+	if (!keep)
+		destroyBlock(&block);
+}
+
+bool MemoryAllocator::allocateFrom(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+	auto best = block.freeRanges.end();
+	for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it) {
+		VkDeviceSize aligned = (it->first + alignment - 1) / alignment * alignment;
+		if (aligned + size > it->first + it->second)
+			continue;
+		if (best == block.freeRanges.end() || it->second < best->second)
+			best = it;
+	}
+	if (best == block.freeRanges.end())
+		return false;
+
+	VkDeviceSize rangeOffset = best->first;
+	VkDeviceSize rangeEnd = best->first + best->second;
+	offset = (rangeOffset + alignment - 1) / alignment * alignment;
+	block.freeRanges.erase(best);
+
+	// alignment padding stays free and merges back once a neighbour is freed
+	if (offset > rangeOffset)
+		block.freeRanges[rangeOffset] = offset - rangeOffset;
+	if (offset + size < rangeEnd)
+		block.freeRanges[offset + size] = rangeEnd - offset - size;
+	return true;
+}
+
+MemoryBlock* MemoryAllocator::createBlock(uint32_t memoryType, VkDeviceSize size, bool linear, bool dedicated)
+{
+	std::unique_ptr<MemoryBlock> block(new MemoryBlock());
+	block->size = size;
+	block->memoryType = memoryType;
+	block->linear = linear;
+	block->dedicated = dedicated;
+	block->mapped = nullptr;
+	block->used = 0;
+	block->numAllocations = 0;
+	block->freeRanges[0] = size;
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryType;
+	VK_CHECK_RESULT(vkAllocateMemory(mState.device, &allocInfo, nullptr, &block->memory));
+	++mNumDeviceAllocations;
+
+	// a VkDeviceMemory can be mapped only once, so host visible blocks are mapped for their lifetime
+	if (mMemoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		VK_CHECK_RESULT(vkMapMemory(mState.device, block->memory, 0, VK_WHOLE_SIZE, 0, (void**) &block->mapped));
+
+	MemoryBlock* result = block.get();
+	mBlocks[memoryType].push_back(std::move(block));
+	return result;
+}
+
+void MemoryAllocator::destroyBlock(MemoryBlock* block)
+{
+	auto& blocks = mBlocks[block->memoryType];
+	for (auto it = blocks.begin(); it != blocks.end(); ++it) {
+		if (it->get() != block)
+			continue;
+		if (block->mapped)
+			vkUnmapMemory(mState.device, block->memory);
+		vkFreeMemory(mState.device, block->memory, nullptr);
+		--mNumDeviceAllocations;
+		blocks.erase(it);
+		return;
+	}
+}
+
+uint32_t MemoryAllocator::getMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags flags) const
+{
+	for (uint32_t i = 0; i < mMemoryProperties.memoryTypeCount; ++i)
+		if ((typeFilter & (1 << i)) 
+		&& (mMemoryProperties.memoryTypes[i].propertyFlags & flags) == flags)
+			return i;
+	throw std::runtime_error("Failed to find memory type");
+}
+
+void MemoryAllocator::dumpStats()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	LOG("DEVICE MEMORY device allocations: %u block size: %llu", 
+			mNumDeviceAllocations, 
+			(unsigned long long) mBlockSize);
+
+	for (uint32_t heapIndex = 0; heapIndex < mMemoryProperties.memoryHeapCount; ++heapIndex) {
+		uint32_t numBlocks = 0, numAllocations = 0, numFreeRanges = 0;
+		VkDeviceSize reserved = 0, used = 0, free = 0, largestFree = 0, contiguousFree = 0;
+
+		for (uint32_t type = 0; type < mMemoryProperties.memoryTypeCount; ++type) {
+			if (mMemoryProperties.memoryTypes[type].heapIndex != heapIndex)
+				continue;
+			for (auto& block : mBlocks[type]) {
+				++numBlocks;
+				numAllocations += block->numAllocations;
+				reserved += block->size;
+				used += block->used;
+				VkDeviceSize blockLargestFree = 0;
+				for (auto& range : block->freeRanges) {
+					++numFreeRanges;
+					free += range.second;
+					blockLargestFree = std::max(blockLargestFree, range.second);
+				}
+				contiguousFree += blockLargestFree;
+				largestFree = std::max(largestFree, blockLargestFree);
+			}
+		}
+
+		// share of free memory outside the largest free range of its block
+		double fragmentation = free > 0 ? 1.0 - (double) contiguousFree / free : 0.0;
+		const VkMemoryHeap& heap = mMemoryProperties.memoryHeaps[heapIndex];
+		LOG("HEAP %u%s size: %llu blocks: %u reserved: %llu used: %llu (%.1f%%) allocations: %u free ranges: %u largest free: %llu fragmentation: %.1f%%", 
+				heapIndex, 
+				(heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " device local" : "",
+				(unsigned long long) heap.size,
+				numBlocks,
+				(unsigned long long) reserved,
+				(unsigned long long) used,
+				reserved > 0 ? 100.0 * used / reserved : 0.0,
+				numAllocations,
+				numFreeRanges,
+				(unsigned long long) largestFree,
+				100.0 * fragmentation);
+	}
+}
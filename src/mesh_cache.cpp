@@ -0,0 +1,222 @@
+#include "mesh_cache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifndef WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+std::string MeshCache::cachePath(const std::string& sourcePath)
+{
+	std::string folder = FileManager::stripPath(FileManager::getFilePath(sourcePath));
+	std::string file = FileManager::stripPath(std::string(sourcePath));
+	return FileManager::getCachePath(folder + "_" + file + ".mesh");
+}
+
+bool MeshCache::makeKey(
+		const std::string& sourcePath,
+		Kind kind,
+		uint32_t vertexSize,
+		uint32_t importFlags,
+		uint32_t modelFlags,
+		Key& key,
+		uint64_t settingsHash)
+{
+#ifdef __ANDROID__
+	// models are read through the asset manager, there is nothing to stat
+	return false;
+#else
+	struct stat sb;
+	if (stat(sourcePath.c_str(), &sb) != 0)
+		return false;
+
+	key = Key();
+	key.kind = kind;
+	key.vertexSize = vertexSize;
+	key.importFlags = importFlags;
+	key.modelFlags = modelFlags;
+	key.sourceSize = (uint64_t) sb.st_size;
+	key.sourceTime = (int64_t) sb.st_mtime;
+	key.settingsHash = settingsHash;
+	return true;
+#endif
+}
+
+MappedFile::MappedFile():
+	mData(nullptr),
+	mSize(0)
+{
+
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+#ifdef WINDOWS
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+	if (!file.is_open())
+		return false;
+	mBuffer.resize((size_t) file.tellg());
+	file.seekg(0);
+	file.read(mBuffer.data(), mBuffer.size());
+	if (!file)
+		return false;
+	mData = mBuffer.data();
+	mSize = mBuffer.size();
+	return true;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat sb;
+	if (fstat(fd, &sb) != 0 || sb.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	void* data = mmap(nullptr, (size_t) sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// mapping stays valid once the descriptor is closed
+	::close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	mData = (const char*) data;
+	mSize = (size_t) sb.st_size;
+	return true;
+#endif
+}
+
+void MappedFile::close()
+{
+#ifdef WINDOWS
+	mBuffer.clear();
+#else
+	if (mData)
+		munmap((void*) mData, mSize);
+#endif
+	mData = nullptr;
+	mSize = 0;
+}
+
+bool MeshCacheReader::open(const std::string& path, const MeshCache::Key& key)
+{
+	if (!mFile.open(path))
+		return false;
+
+	if (mFile.size() < sizeof(MeshCache::Header)) {
+		LOG("MESH CACHE TRUNCATED: %s", path.c_str());
+		mFile.close();
+		return false;
+	}
+
+	memcpy(&mHeader, mFile.data(), sizeof(MeshCache::Header));
+	const MeshCache::Key& cached = mHeader.key;
+	bool valid = mHeader.magic == MeshCache::MAGIC &&
+			mHeader.version == MeshCache::VERSION &&
+			cached.kind == key.kind &&
+			cached.vertexSize == key.vertexSize &&
+			cached.importFlags == key.importFlags &&
+			cached.modelFlags == key.modelFlags &&
+			cached.sourceSize == key.sourceSize &&
+			cached.sourceTime == key.sourceTime &&
+			cached.settingsHash == key.settingsHash;
+
+	for (uint32_t i = 0; valid && i < MeshCache::NUM_SECTIONS; ++i) {
+		const MeshCache::SectionRange& range = mHeader.sections[i];
+		valid = range.offset % MeshCache::SECTION_ALIGNMENT == 0 &&
+				range.offset <= mFile.size() &&
+				range.size <= mFile.size() - range.offset;
+	}
+
+	if (!valid) {
+		LOG("MESH CACHE STALE: %s", path.c_str());
+		mFile.close();
+	}
+	return valid;
+}
+
+const char* MeshCacheReader::section(MeshCache::Section section, size_t& size) const
+{
+	const MeshCache::SectionRange& range = mHeader.sections[section];
+	size = (size_t) range.size;
+	return mFile.data() + range.offset;
+}
+
+MeshCacheStream MeshCacheReader::stream(MeshCache::Section section) const
+{
+	size_t size;
+	const char* data = this->section(section, size);
+	return MeshCacheStream(data, size);
+}
+
+void MeshCacheWriter::writeBytes(MeshCache::Section section, const void* data, size_t size)
+{
+	const char* bytes = (const char*) data;
+	mSections[section].insert(mSections[section].end(), bytes, bytes + size);
+}
+
+void MeshCacheWriter::save(const std::string& path, const MeshCache::Key& key)
+{
+	MeshCache::Header header = MeshCache::Header();
+	header.magic = MeshCache::MAGIC;
+	header.version = MeshCache::VERSION;
+	header.key = key;
+
+	auto align = [] (uint64_t offset) -> uint64_t {
+		return (offset + MeshCache::SECTION_ALIGNMENT - 1) & ~(MeshCache::SECTION_ALIGNMENT - 1);
+	};
+
+	uint64_t offset = align(sizeof(header));
+	for (uint32_t i = 0; i < MeshCache::NUM_SECTIONS; ++i) {
+		header.sections[i].offset = offset;
+		header.sections[i].size = mSections[i].size();
+		offset = align(offset + mSections[i].size());
+	}
+
+	std::string tmpPath = path + ".tmp";
+	{
+		std::ofstream file(tmpPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			LOG("MESH CACHE CANNOT BE WRITTEN: %s", tmpPath.c_str());
+			return;
+		}
+
+		const char padding[MeshCache::SECTION_ALIGNMENT] = {};
+		file.write((const char*) &header, sizeof(header));
+		uint64_t written = sizeof(header);
+		for (uint32_t i = 0; i < MeshCache::NUM_SECTIONS; ++i) {
+			file.write(padding, header.sections[i].offset - written);
+			file.write(mSections[i].data(), mSections[i].size());
+			written = header.sections[i].offset + mSections[i].size();
+		}
+
+		if (!file) {
+			LOG("MESH CACHE CANNOT BE WRITTEN: %s", tmpPath.c_str());
+			file.close();
+			std::remove(tmpPath.c_str());
+			return;
+		}
+	}
+
+#ifdef WINDOWS
+	// rename does not replace an existing file there
+	std::remove(path.c_str());
+#endif
+	if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+		LOG("MESH CACHE CANNOT BE RENAMED: %s", path.c_str());
+		std::remove(tmpPath.c_str());
+		return;
+	}
+	LOG("MESH CACHE WRITTEN: %s %llu bytes", path.c_str(), (unsigned long long) offset);
+}
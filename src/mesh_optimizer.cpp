@@ -0,0 +1,539 @@
+#include "mesh_optimizer.h"
+
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+
+constexpr float CACHE_DECAY_POWER = 1.5f;
+constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+constexpr float VALENCE_BOOST_SCALE = 2.0f;
+constexpr float VALENCE_BOOST_POWER = 0.5f;
+// smallest cluster optimizeOverdraw splits off inside a run of the cache order
+constexpr uint32_t MIN_CLUSTER_TRIANGLES = 16;
+
+float vertexScore(int32_t cachePosition, uint32_t liveTriangles)
+{
+	// no triangle left to emit
+	if (liveTriangles == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		// vertices of the last triangle score the same, so the next one does not
+		// just continue the strip it came from
+		if (cachePosition < 3) {
+			score = LAST_TRIANGLE_SCORE;
+		} else {
+			float scale = 1.0f / (MeshOptimizer::CACHE_SIZE - 3);
+			score = std::pow(1.0f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+		}
+	}
+	// finish vertices with few triangles left, lone vertices are costly later
+	score += VALENCE_BOOST_SCALE * std::pow((float) liveTriangles, -VALENCE_BOOST_POWER);
+	return score;
+}
+
+// FIFO cache of vertices or lines, with a cold reset
+class FifoCache {
+public:
+	FifoCache(uint32_t numEntries, uint32_t size):
+		mEntries(numEntries, 0),
+		mSize(size),
+		mTime(size + 1) {}
+
+	// false on a miss, the entry is loaded
+	bool access(uint32_t entry)
+	{
+		if (mTime - mEntries[entry] < mSize)
+			return true;
+		mEntries[entry] = ++mTime;
+		return false;
+	}
+
+	void reset() { mTime += mSize + 1; }
+
+private:
+	// miss count an entry was loaded at
+	std::vector<uint64_t> mEntries;
+	uint64_t mSize, mTime;
+};
+
+}
+
+MeshOptimizer::Stats MeshOptimizer::analyze(const uint32_t* indices, size_t numIndices, uint32_t numVertices, size_t vertexSize)
+{
+	Stats stats;
+	size_t numTriangles = numIndices / 3;
+	if (numTriangles == 0 || vertexSize == 0)
+		return stats;
+
+	size_t numLines = (numVertices * vertexSize + FETCH_LINE_SIZE - 1) / FETCH_LINE_SIZE;
+	FifoCache vertexCache(numVertices, STATS_CACHE_SIZE);
+	FifoCache lineCache((uint32_t) numLines, FETCH_CACHE_LINES);
+	std::vector<bool> referenced(numVertices, false);
+	size_t misses = 0, fetchedLines = 0, numReferenced = 0;
+
+	for (size_t i = 0; i < numTriangles * 3; ++i) {
+		uint32_t vertex = indices[i];
+		if (!referenced[vertex]) {
+			referenced[vertex] = true;
+			++numReferenced;
+		}
+		if (vertexCache.access(vertex))
+			continue;
+		++misses;
+		// a vertex may straddle two lines
+		size_t firstLine = vertex * vertexSize / FETCH_LINE_SIZE;
+		size_t lastLine = ((vertex + 1) * vertexSize - 1) / FETCH_LINE_SIZE;
+		for (size_t line = firstLine; line <= lastLine; ++line)
+			if (!lineCache.access((uint32_t) line))
+				++fetchedLines;
+	}
+
+	stats.acmr = (float) misses / numTriangles;
+	stats.overfetch = (float) (fetchedLines * FETCH_LINE_SIZE) / (numReferenced * vertexSize);
+	return stats;
+}
+
+uint64_t MeshOptimizer::hashBytes(const void* data, size_t size)
+{
+	// FNV-1a over 32 bit words, weld keys are made of floats and integers
+	const unsigned char* bytes = (const unsigned char*) data;
+	uint64_t hash = 14695981039346656037ull;
+	size_t i = 0;
+	for (; i + 4 <= size; i += 4) {
+		uint32_t word;
+		std::memcpy(&word, bytes + i, 4);
+		hash = (hash ^ word) * 1099511628211ull;
+	}
+	for (; i < size; ++i)
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	// low bits pick the slot, fold the well mixed high bits into them
+	return hash ^ (hash >> 32);
+}
+
+void MeshOptimizer::optimizeVertexCache(uint32_t* indices, size_t numIndices, uint32_t numVertices)
+{
+	uint32_t numTriangles = (uint32_t) (numIndices / 3);
+	if (numTriangles == 0)
+		return;
+
+	// triangles of every vertex, offsets into one array
+	std::vector<uint32_t> liveTriangles(numVertices, 0);
+	for (uint32_t i = 0; i < numTriangles * 3; ++i)
+		++liveTriangles[indices[i]];
+	std::vector<uint32_t> triangleOffsets(numVertices + 1, 0);
+	for (uint32_t i = 0; i < numVertices; ++i)
+		triangleOffsets[i + 1] = triangleOffsets[i] + liveTriangles[i];
+	std::vector<uint32_t> vertexTriangles(numTriangles * 3);
+	std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+	for (uint32_t i = 0; i < numTriangles * 3; ++i)
+		vertexTriangles[fill[indices[i]]++] = i / 3;
+
+	std::vector<int32_t> cachePositions(numVertices, -1);
+	std::vector<float> vertexScores(numVertices);
+	for (uint32_t i = 0; i < numVertices; ++i)
+		vertexScores[i] = vertexScore(-1, liveTriangles[i]);
+
+	std::vector<float> triangleScores(numTriangles);
+	std::vector<bool> emitted(numTriangles, false);
+	for (uint32_t i = 0; i < numTriangles; ++i) {
+		const uint32_t* triangle = indices + 3 * i;
+		triangleScores[i] = vertexScores[triangle[0]] + vertexScores[triangle[1]] + vertexScores[triangle[2]];
+	}
+
+	std::vector<uint32_t> output(numTriangles * 3);
+	std::vector<uint32_t> cache, nextCache;
+	cache.reserve(CACHE_SIZE + 3);
+	nextCache.reserve(CACHE_SIZE + 3);
+	uint32_t bestTriangle = (uint32_t) (std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+	// restarts take the next triangle of the input, a search of all of them
+	// would be quadratic on meshes of many small pieces
+	uint32_t inputCursor = 0;
+
+	for (uint32_t n = 0; n < numTriangles; ++n) {
+		if (bestTriangle == UINT32_MAX) {
+			while (emitted[inputCursor])
+				++inputCursor;
+			bestTriangle = inputCursor;
+		}
+
+		const uint32_t* triangle = indices + 3 * bestTriangle;
+		emitted[bestTriangle] = true;
+		for (uint32_t k = 0; k < 3; ++k) {
+			output[3 * n + k] = triangle[k];
+			--liveTriangles[triangle[k]];
+		}
+
+		// emitted vertices move to the front, the rest shift back, the tail is evicted
+		nextCache.assign(triangle, triangle + 3);
+		for (uint32_t vertex : cache)
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+				nextCache.push_back(vertex);
+		for (size_t i = 0; i < nextCache.size(); ++i) {
+			uint32_t vertex = nextCache[i];
+			cachePositions[vertex] = i < CACHE_SIZE ? (int32_t) i : -1;
+			vertexScores[vertex] = vertexScore(cachePositions[vertex], liveTriangles[vertex]);
+		}
+		if (nextCache.size() > CACHE_SIZE)
+			nextCache.resize(CACHE_SIZE);
+		cache.swap(nextCache);
+
+		// only triangles around changed vertices change score
+		float bestScore = -1.0f;
+		bestTriangle = UINT32_MAX;
+		for (uint32_t vertex : cache) {
+			for (uint32_t i = triangleOffsets[vertex]; i < triangleOffsets[vertex + 1]; ++i) {
+				uint32_t t = vertexTriangles[i];
+				if (emitted[t])
+					continue;
+				const uint32_t* other = indices + 3 * t;
+				float score = vertexScores[other[0]] + vertexScores[other[1]] + vertexScores[other[2]];
+				triangleScores[t] = score;
+				if (score > bestScore) {
+					bestScore = score;
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::optimizeOverdraw(
+		uint32_t* indices,
+		size_t numIndices,
+		const glm::vec3* positions,
+		uint32_t numVertices,
+		float threshold)
+{
+	uint32_t numTriangles = (uint32_t) (numIndices / 3);
+	if (numTriangles < 2)
+		return;
+
+	// runs of the cache order start where all three vertices miss
+	std::vector<uint32_t> hardStarts;
+	FifoCache cache(numVertices, STATS_CACHE_SIZE);
+	for (uint32_t i = 0; i < numTriangles; ++i) {
+		uint32_t misses = 0;
+		for (uint32_t k = 0; k < 3; ++k)
+			misses += cache.access(indices[3 * i + k]) ? 0 : 1;
+		if (misses == 3 || i == 0)
+			hardStarts.push_back(i);
+	}
+	hardStarts.push_back(numTriangles);
+
+	// runs are split further where the ACMR from a cold cache stays within
+	// threshold of the ACMR of the whole run
+	std::vector<uint32_t> starts;
+	for (size_t h = 0; h + 1 < hardStarts.size(); ++h) {
+		uint32_t begin = hardStarts[h], end = hardStarts[h + 1];
+		cache.reset();
+		uint32_t runMisses = 0;
+		for (uint32_t i = begin * 3; i < end * 3; ++i)
+			runMisses += cache.access(indices[i]) ? 0 : 1;
+		float maxAcmr = threshold * runMisses / (end - begin);
+
+		starts.push_back(begin);
+		cache.reset();
+		uint32_t pieceStart = begin, pieceMisses = 0;
+		for (uint32_t i = begin; i < end; ++i) {
+			for (uint32_t k = 0; k < 3; ++k)
+				pieceMisses += cache.access(indices[3 * i + k]) ? 0 : 1;
+			uint32_t pieceTriangles = i + 1 - pieceStart;
+			if (i + 1 < end &&
+					pieceTriangles >= MIN_CLUSTER_TRIANGLES &&
+					pieceMisses <= maxAcmr * pieceTriangles) {
+				starts.push_back(i + 1);
+				cache.reset();
+				pieceStart = i + 1;
+				pieceMisses = 0;
+			}
+		}
+	}
+	starts.push_back(numTriangles);
+	size_t numClusters = starts.size() - 1;
+
+	// area weighted centroids and normals, normals keep their area for the winding test
+	std::vector<glm::vec3> centroids(numClusters, glm::vec3(0.0f));
+	std::vector<glm::vec3> normals(numClusters, glm::vec3(0.0f));
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < numClusters; ++c) {
+		float area = 0.0f;
+		for (uint32_t i = starts[c]; i < starts[c + 1]; ++i) {
+			const glm::vec3& p0 = positions[indices[3 * i]];
+			const glm::vec3& p1 = positions[indices[3 * i + 1]];
+			const glm::vec3& p2 = positions[indices[3 * i + 2]];
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float triangleArea = glm::length(normal);
+			centroids[c] += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normals[c] += normal;
+			area += triangleArea;
+		}
+		meshCentroid += centroids[c];
+		meshArea += area;
+		centroids[c] = area > 0.0f ? centroids[c] / area : positions[indices[3 * starts[c]]];
+	}
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	// imports flip winding and mirror positions, outward is the side the
+	// clusters face on average
+	float facing = 0.0f;
+	for (size_t c = 0; c < numClusters; ++c)
+		facing += glm::dot(centroids[c] - meshCentroid, normals[c]);
+	float winding = facing < 0.0f ? -1.0f : 1.0f;
+
+	std::vector<float> keys(numClusters);
+	for (size_t c = 0; c < numClusters; ++c) {
+		float length = glm::length(normals[c]);
+		keys[c] = length > 0.0f ? winding * glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.0f;
+	}
+
+	std::vector<uint32_t> order(numClusters);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&keys] (uint32_t a, uint32_t b) {
+		return keys[a] > keys[b];
+	});
+
+	std::vector<uint32_t> output;
+	output.reserve(numTriangles * 3);
+	for (uint32_t c : order)
+		output.insert(output.end(), indices + 3 * starts[c], indices + 3 * starts[c + 1]);
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::optimizeVertexFetch(uint32_t* indices, size_t numIndices, uint32_t numVertices, std::vector<uint32_t>& remap)
+{
+	remap.assign(numVertices, UINT32_MAX);
+	uint32_t next = 0;
+	for (size_t i = 0; i < numIndices; ++i) {
+		uint32_t& vertex = indices[i];
+		if (remap[vertex] == UINT32_MAX)
+			remap[vertex] = next++;
+		vertex = remap[vertex];
+	}
+	for (uint32_t& vertex : remap)
+		if (vertex == UINT32_MAX)
+			vertex = next++;
+}
+
+namespace
+{
+
+// symmetric 4x4 matrix of the summed squared plane distances, upper triangle
+// xx xy xz xw yy yz yw zz zw ww
+struct Quadric {
+	Quadric() { std::fill(a, a + 10, 0.0); }
+
+	void addPlane(const glm::dvec3& n, double d)
+	{
+		a[0] += n.x * n.x; a[1] += n.x * n.y; a[2] += n.x * n.z; a[3] += n.x * d;
+		a[4] += n.y * n.y; a[5] += n.y * n.z; a[6] += n.y * d;
+		a[7] += n.z * n.z; a[8] += n.z * d;
+		a[9] += d * d;
+	}
+
+	void add(const Quadric& q)
+	{
+		for (uint32_t i = 0; i < 10; ++i)
+			a[i] += q.a[i];
+	}
+
+	// summed squared distance of p to the planes
+	double evaluate(const glm::vec3& p) const
+	{
+		double x = p.x, y = p.y, z = p.z;
+		double error = a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x
+				+ a[4] * y * y + 2.0 * a[5] * y * z + 2.0 * a[6] * y
+				+ a[7] * z * z + 2.0 * a[8] * z
+				+ a[9];
+		return std::max(error, 0.0);
+	}
+
+	double a[10];
+};
+
+struct Collapse {
+	uint32_t from, to;
+	double error;
+};
+
+glm::vec3 triangleNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+	return glm::cross(b - a, c - a);
+}
+
+}
+
+float MeshOptimizer::simplify(
+		const uint32_t* indices,
+		size_t numIndices,
+		const glm::vec3* positions,
+		uint32_t numVertices,
+		size_t targetIndexCount,
+		float maxError,
+		std::vector<uint32_t>& result)
+{
+	result.assign(indices, indices + numIndices - numIndices % 3);
+	if (result.size() <= targetIndexCount)
+		return 0.0f;
+
+	std::vector<uint8_t> locked(numVertices, 0);
+	// seams, vertices split from a neighbour by another normal or texture coordinate
+	std::vector<uint32_t> byPosition(numVertices);
+	std::iota(byPosition.begin(), byPosition.end(), 0);
+	auto positionLess = [positions] (uint32_t a, uint32_t b) {
+		const glm::vec3& pa = positions[a];
+		const glm::vec3& pb = positions[b];
+		if (pa.x != pb.x)
+			return pa.x < pb.x;
+		if (pa.y != pb.y)
+			return pa.y < pb.y;
+		return pa.z < pb.z;
+	};
+	std::sort(byPosition.begin(), byPosition.end(), positionLess);
+	for (uint32_t i = 1; i < numVertices; ++i) {
+		uint32_t a = byPosition[i - 1], b = byPosition[i];
+		if (positions[a] == positions[b])
+			locked[a] = locked[b] = 1;
+	}
+
+	// borders, edges of a single triangle
+	std::vector<uint64_t> edges;
+	edges.reserve(result.size());
+	for (size_t i = 0; i < result.size(); i += 3) {
+		for (uint32_t k = 0; k < 3; ++k) {
+			uint64_t a = result[i + k], b = result[i + (k + 1) % 3];
+			edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	for (size_t i = 0; i < edges.size(); ) {
+		size_t j = i + 1;
+		while (j < edges.size() && edges[j] == edges[i])
+			++j;
+		if (j - i == 1)
+			locked[edges[i] >> 32] = locked[edges[i] & 0xFFFFFFFF] = 1;
+		i = j;
+	}
+
+	std::vector<Quadric> quadrics(numVertices);
+	for (size_t i = 0; i < result.size(); i += 3) {
+		const glm::vec3& p0 = positions[result[i]];
+		glm::dvec3 n = glm::dvec3(triangleNormal(p0, positions[result[i + 1]], positions[result[i + 2]]));
+		double length = glm::length(n);
+		if (length <= 0.0)
+			continue;
+		n /= length;
+		double d = -glm::dot(n, glm::dvec3(p0));
+		for (uint32_t k = 0; k < 3; ++k)
+			quadrics[result[i + k]].addPlane(n, d);
+	}
+
+	double maxSquaredError = (double) maxError * maxError;
+	double reachedError = 0.0;
+	std::vector<uint32_t> triangleOffsets(numVertices + 1), vertexTriangles, remap(numVertices);
+	std::vector<uint8_t> touched(numVertices);
+	std::vector<Collapse> collapses;
+
+	for (uint32_t pass = 0; pass < MAX_SIMPLIFY_PASSES && result.size() > targetIndexCount; ++pass) {
+		size_t numTriangles = result.size() / 3;
+
+		// triangles around each vertex
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (uint32_t vertex : result)
+			++triangleOffsets[vertex + 1];
+		for (uint32_t i = 0; i < numVertices; ++i)
+			triangleOffsets[i + 1] += triangleOffsets[i];
+		vertexTriangles.resize(result.size());
+		std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for (size_t i = 0; i < result.size(); ++i)
+			vertexTriangles[fill[result[i]]++] = (uint32_t) (i / 3);
+
+		// both directions of every edge, the moving vertex must be free
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (uint32_t k = 0; k < 3; ++k) {
+				uint32_t a = result[i + k], b = result[i + (k + 1) % 3];
+				for (uint32_t direction = 0; direction < 2; ++direction) {
+					uint32_t from = direction ? b : a, to = direction ? a : b;
+					if (locked[from])
+						continue;
+					Quadric q = quadrics[from];
+					q.add(quadrics[to]);
+					Collapse collapse = { from, to, q.evaluate(positions[to]) };
+					collapses.push_back(collapse);
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [] (const Collapse& a, const Collapse& b) {
+			return a.error < b.error;
+		});
+
+		// a collapse removes two triangles, vertices around a collapse wait
+		// for the next pass so every check sees the mesh it changes
+		size_t wanted = (numTriangles - targetIndexCount / 3 + 1) / 2;
+		size_t numCollapsed = 0;
+		std::iota(remap.begin(), remap.end(), 0);
+		std::fill(touched.begin(), touched.end(), 0);
+		for (const Collapse& collapse : collapses) {
+			if (collapse.error > maxSquaredError || numCollapsed >= wanted)
+				break;
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			// also rejects collapses next to one made this pass
+			bool flips = false;
+			for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1] && !flips; ++t) {
+				const uint32_t* triangle = &result[3 * vertexTriangles[t]];
+				// a neighbour collapsed this pass, the check would see the old triangle
+				if (touched[triangle[0]] || touched[triangle[1]] || touched[triangle[2]]) {
+					flips = true;
+					break;
+				}
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+					continue;
+				glm::vec3 p[3], q[3];
+				for (uint32_t k = 0; k < 3; ++k) {
+					p[k] = positions[triangle[k]];
+					q[k] = triangle[k] == collapse.from ? positions[collapse.to] : p[k];
+				}
+				glm::vec3 before = triangleNormal(p[0], p[1], p[2]);
+				glm::vec3 after = triangleNormal(q[0], q[1], q[2]);
+				flips = glm::dot(before, after) <= 0.0f;
+			}
+			if (flips)
+				continue;
+
+			for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1]; ++t)
+				for (uint32_t k = 0; k < 3; ++k)
+					touched[result[3 * vertexTriangles[t] + k]] = 1;
+			touched[collapse.to] = 1;
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].add(quadrics[collapse.from]);
+			reachedError = std::max(reachedError, collapse.error);
+			++numCollapsed;
+		}
+		if (numCollapsed == 0)
+			break;
+
+		// collapsed triangles lose a corner
+		size_t numKept = 0;
+		for (size_t i = 0; i < result.size(); i += 3) {
+			uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+			result[numKept++] = a;
+			result[numKept++] = b;
+			result[numKept++] = c;
+		}
+		result.resize(numKept);
+	}
+	return (float) std::sqrt(reachedError);
+}
@@ -1,4 +1,10 @@
 #include "model.h"
+#include "vertex_packing.h"
+#include "mesh_optimizer.h"
+#include "task_manager.h"
+
+#include <chrono>
+#include <limits>
 
 static const aiTextureType Model_TEXTURE_TYPES[] ={
 	aiTextureType_DIFFUSE
@@ -11,18 +17,24 @@ const aiTextureType* Model::TEXTURE_TYPES = Model_TEXTURE_TYPES;
 
 const uint32_t Model::NUM_TEXTURE_TYPES = ARRAY_SIZE(Model_TEXTURE_TYPES);
 
-Model::Model(VulkanState& vulkanState):
+Model::Model(VulkanState& vulkanState, UniformRing& uniformRing):
 	numVertices(0),
 	numIndices(0),
 	uniformBufferOffset(0),
 	vertexBufferOffset(0),
 	indexBufferOffset(0),
+	mLodSelection(true),
+	mTrianglesDrawn(0),
 	mNumSamplerDescriptors(0),
 	mState(vulkanState),
+	mUniformRing(uniformRing),
 	mCommonBufferInfo(mState.device),
-	mCommonStagingBufferInfo(mState.device),
+	mPackedVertices(false),
+	mIndexType(VK_INDEX_TYPE_UINT32),
 	mPath(""),
-	mFolder("")
+	mFolder(""),
+	mModelFlags(0),
+	mCacheable(false)
 {
 
 
@@ -33,16 +45,27 @@ Model::~Model()
 {	
 }
 
-void Model::init(std::string modelPath, unsigned int pFlags) 
+void Model::init(std::string modelPath, unsigned int pFlags, ModelFlags modelFlags) 
 {	
-	init(modelPath.c_str(), pFlags);	
+	init(modelPath.c_str(), pFlags, modelFlags);	
 }
 
-void Model::init(const char* modelPath, unsigned int pFlags)
+void Model::init(const char* modelPath, unsigned int pFlags, ModelFlags modelFlags)
 {
 	mPath = modelPath;
 	mFolder = FileManager::getFilePath(std::string(modelPath));
+	mModelFlags = modelFlags;
+	if (lodSettings.numLods < 1 || lodSettings.numLods > MAX_LODS)
+		lodSettings.numLods = lodSettings.numLods < 1 ? 1 : MAX_LODS;
 	LOG("FOLDER: %s", mFolder.c_str());
+
+	std::string cachePath = MeshCache::cachePath(mPath);
+	// packing happens on upload, the LOD chain is baked
+	uint64_t lodHash = MeshOptimizer::hashBytes(&lodSettings, sizeof(LodSettings));
+	mCacheable = MeshCache::makeKey(mPath, MeshCache::Kind_model, sizeof(Vertex), pFlags, 0, mCacheKey, lodHash);
+	if (mCacheable && loadCache(cachePath))
+		return;
+
 	Assimp::Importer importer;
 #ifdef __ANDROID__
 	importer.SetIOHandler(FileManager::newAssimpIOSystem());
@@ -64,6 +87,7 @@ void Model::processModel(const aiScene& scene)
 {
 	std::vector<Vertex> vertices;
 	std::vector<uint32_t> indices;
+	std::vector<TextureRef> textures;
 	mMeshes.resize(scene.mNumMeshes);
 
 	for (size_t i = 0; i < scene.mNumMeshes; ++i) {
@@ -78,7 +102,8 @@ void Model::processModel(const aiScene& scene)
 		// Vertices
 		meshInfo.baseVertex = vertices.size();
 		for (size_t j = 0; j < mesh.mNumVertices; ++j) {
-			Vertex vertex;
+			// attributes the mesh lacks are zero, vertices are welded byte for byte
+			Vertex vertex = {};
 			if (hasPositions) { 
 				convertVector(mesh.mVertices[j], vertex.pos);
 				vertex.pos.y *= -1;
@@ -99,7 +124,7 @@ void Model::processModel(const aiScene& scene)
 		meshInfo.baseIndex = indices.size();
 		for (size_t j = 0; j < mesh.mNumFaces; ++j) 
 			for (size_t k = 0; k < 3; ++k)
-				indices.push_back(mesh.mFaces[j].mIndices[k] + meshInfo.baseIndex);
+				indices.push_back(mesh.mFaces[j].mIndices[k] + meshInfo.baseVertex);
 		meshInfo.numIndices = indices.size() - meshInfo.baseIndex;
 		
 		// Textures
@@ -121,31 +146,16 @@ void Model::processModel(const aiScene& scene)
 					TextureDesc textureDesc(fullTexturePath);
 					ImageInfo* imageInfo = TextureManager::load(
 							mState, 
-							mState.commandPool, 
-							mState.graphicsQueue, 
 							textureDesc);
 
 					LOG("AFTER LOAD");
-					switch(textureType) {
-						case aiTextureType_DIFFUSE:
-							materialInfo.diffuseImages.push_back(imageInfo);
-							++materialInfo.numImages;
-							break;
-						case aiTextureType_SPECULAR:
-							materialInfo.specularImages.push_back(imageInfo);
-							++materialInfo.numImages;
-							break;
-						case aiTextureType_HEIGHT:
-							materialInfo.heightImages.push_back(imageInfo);
-							++materialInfo.numImages;
-							break;
-						case aiTextureType_AMBIENT:
-							materialInfo.ambientImages.push_back(imageInfo);
-							++materialInfo.numImages;
-							break;
-						default:
-							break;
-					}
+					addMaterialImage(materialInfo, textureType, imageInfo);
+
+					TextureRef textureRef;
+					textureRef.materialIndex = mesh.mMaterialIndex;
+					textureRef.type = textureType;
+					textureRef.path = texturePath.C_Str();
+					textures.push_back(textureRef);
 				}
 				mNumSamplerDescriptors += NUM_TEXTURE_TYPES;
 			}	
@@ -153,49 +163,299 @@ void Model::processModel(const aiScene& scene)
 		} else {LOG("MATERIAL EXISTS");}
 	}
 
+	// stats of the layout createCommonBuffer uploads
+	size_t vertexStride = (mModelFlags & ModelFlag_packedVertices) ? sizeof(PackedVertex) : sizeof(Vertex);
+	MeshOptimizer::optimizeMeshes(vertices, indices, mMeshes, MeshOptimizer::surfaceKey<Vertex>, vertexStride, mState.taskManager, mPath.c_str());
+	generateLods(vertices, indices);
+
+	if (mCacheable)
+		saveCache(MeshCache::cachePath(mPath), vertices, indices, textures);
+
 	createCommonBuffer(vertices, indices);
 	createDescriptorPool();
 	createDescriptorSet();
 }
 
+void Model::generateLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	// indices of levels 1 and up of each mesh, local to its vertices
+	std::vector<std::vector<uint32_t>> lodIndices(mMeshes.size() * MAX_LODS);
+
+	auto simplify = [&] (size_t begin, size_t end) {
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> current, next;
+		for (size_t i = begin; i < end; ++i) {
+			Mesh& meshInfo = mMeshes[i];
+			meshInfo.numLods = 1;
+			meshInfo.lods[0].baseIndex = meshInfo.baseIndex;
+			meshInfo.lods[0].numIndices = meshInfo.numIndices;
+			meshInfo.lods[0].error = 0.0f;
+
+			positions.resize(meshInfo.numVertices);
+			glm::vec3 minPos(0.0f), maxPos(0.0f);
+			for (uint32_t j = 0; j < meshInfo.numVertices; ++j) {
+				positions[j] = vertices[meshInfo.baseVertex + j].pos;
+				minPos = j ? glm::min(minPos, positions[j]) : positions[j];
+				maxPos = j ? glm::max(maxPos, positions[j]) : positions[j];
+			}
+			glm::vec3 center = (minPos + maxPos) * 0.5f;
+			float radius = 0.0f;
+			for (const glm::vec3& position : positions)
+				radius = std::max(radius, glm::length(position - center));
+			meshInfo.bounds = glm::vec4(center, radius);
+
+			current.resize(meshInfo.numIndices);
+			for (uint32_t j = 0; j < meshInfo.numIndices; ++j) {
+				uint32_t index = indices[meshInfo.baseIndex + j];
+				// optimizeMeshes logs meshes indexing outside their vertices, they keep one level
+				if (index < meshInfo.baseVertex || index - meshInfo.baseVertex >= meshInfo.numVertices || radius <= 0.0f) {
+					current.clear();
+					break;
+				}
+				current[j] = index - meshInfo.baseVertex;
+			}
+
+			float error = 0.0f;
+			while (meshInfo.numLods < lodSettings.numLods && current.size() >= 3) {
+				size_t target = (size_t) (current.size() / 3 * lodSettings.reduction) * 3;
+				// errors add up along the chain, each level starts from the one before
+				error += MeshOptimizer::simplify(
+						current.data(), 
+						current.size(), 
+						positions.data(), 
+						meshInfo.numVertices, 
+						target, 
+						std::max(lodSettings.maxError - error, 0.0f) * radius, 
+						next) / radius;
+				if (next.size() > current.size() * (1.0f - LOD_MIN_REDUCTION))
+					break;
+				MeshOptimizer::optimizeVertexCache(next.data(), next.size(), meshInfo.numVertices);
+
+				Lod& lod = meshInfo.lods[meshInfo.numLods];
+				lod.numIndices = (uint32_t) next.size();
+				lod.error = error;
+				lodIndices[i * MAX_LODS + meshInfo.numLods++] = next;
+				current.swap(next);
+			}
+		}
+	};
+	if (mState.taskManager)
+		mState.taskManager->parallelFor(mMeshes.size(), 1, simplify);
+	else
+		simplify(0, mMeshes.size());
+
+	uint32_t numFull = (uint32_t) indices.size();
+	for (size_t i = 0; i < mMeshes.size(); ++i) {
+		Mesh& meshInfo = mMeshes[i];
+		for (uint32_t level = 1; level < meshInfo.numLods; ++level) {
+			meshInfo.lods[level].baseIndex = (uint32_t) indices.size();
+			for (uint32_t index : lodIndices[i * MAX_LODS + level])
+				indices.push_back(index + meshInfo.baseVertex);
+		}
+	}
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	for (size_t i = 0; i < mMeshes.size(); ++i) {
+		const Mesh& meshInfo = mMeshes[i];
+		std::string levels;
+		for (uint32_t level = 0; level < meshInfo.numLods; ++level) {
+			char text[64];
+			snprintf(text, sizeof(text), " %u (%.4f)", meshInfo.lods[level].numIndices / 3, meshInfo.lods[level].error);
+			levels += text;
+		}
+		LOG("LODS of mesh %zu of %s, triangles (error):%s", i, mPath.c_str(), levels.c_str());
+	}
+	LOG("LODS of %s: %u -> %zu indices, generated in %.2f ms", mPath.c_str(), numFull, indices.size(), ms);
+}
+
+void Model::addMaterialImage(Material& material, aiTextureType type, ImageInfo* imageInfo)
+{
+	switch(type) {
+		case aiTextureType_DIFFUSE:
+			material.diffuseImages.push_back(imageInfo);
+			++material.numImages;
+			break;
+		case aiTextureType_SPECULAR:
+			material.specularImages.push_back(imageInfo);
+			++material.numImages;
+			break;
+		case aiTextureType_HEIGHT:
+			material.heightImages.push_back(imageInfo);
+			++material.numImages;
+			break;
+		case aiTextureType_AMBIENT:
+			material.ambientImages.push_back(imageInfo);
+			++material.numImages;
+			break;
+		default:
+			break;
+	}
+}
+
+void Model::saveCache(
+		const std::string& cachePath, 
+		const std::vector<Vertex>& vertices, 
+		const std::vector<uint32_t>& indices,
+		const std::vector<TextureRef>& textures)
+{
+	MeshCacheWriter writer;
+	writer.writeArray(MeshCache::Section_vertices, vertices.data(), vertices.size());
+	writer.writeArray(MeshCache::Section_indices, indices.data(), indices.size());
+
+	writer.write(MeshCache::Section_meshes, (uint32_t) mMeshes.size());
+	writer.writeArray(MeshCache::Section_meshes, mMeshes.data(), mMeshes.size());
+
+	writer.write(MeshCache::Section_materials, mNumSamplerDescriptors);
+	writer.write(MeshCache::Section_materials, (uint32_t) mMaterialIndexToMaterial.size());
+	for (const auto& materialPair : mMaterialIndexToMaterial) {
+		uint32_t numTextures = 0;
+		for (const TextureRef& texture : textures)
+			if (texture.materialIndex == materialPair.first)
+				++numTextures;
+
+		writer.write(MeshCache::Section_materials, materialPair.first);
+		writer.write(MeshCache::Section_materials, numTextures);
+		for (const TextureRef& texture : textures) {
+			if (texture.materialIndex != materialPair.first)
+				continue;
+			writer.write(MeshCache::Section_materials, (uint32_t) texture.type);
+			writer.writeString(MeshCache::Section_materials, texture.path);
+		}
+	}
+	writer.save(cachePath, mCacheKey);
+}
+
+bool Model::loadCache(const std::string& cachePath)
+{
+	MeshCacheReader reader;
+	if (!reader.open(cachePath, mCacheKey))
+		return false;
+
+	size_t verticesSize, indicesSize;
+	const char* vertices = reader.section(MeshCache::Section_vertices, verticesSize);
+	const char* indices = reader.section(MeshCache::Section_indices, indicesSize);
+
+	try {
+		MeshCacheStream meshes = reader.stream(MeshCache::Section_meshes);
+		meshes.readArray(mMeshes, meshes.read<uint32_t>());
+		// draws index the cached buffers directly, at every level of a mesh
+		uint64_t vertexCount = verticesSize / sizeof(Vertex), indexCount = indicesSize / sizeof(uint32_t);
+		if (vertexCount == 0 || indexCount == 0)
+			throw std::runtime_error("Mesh buffers missing");
+		for (const Mesh& mesh : mMeshes) {
+			if ((uint64_t) mesh.baseVertex + mesh.numVertices > vertexCount)
+				throw std::runtime_error("Mesh vertices out of range");
+			if ((uint64_t) mesh.baseIndex + mesh.numIndices > indexCount)
+				throw std::runtime_error("Mesh indices out of range");
+			if (mesh.numLods == 0 || mesh.numLods > MAX_LODS)
+				throw std::runtime_error("Mesh LOD count out of range");
+			for (uint32_t level = 0; level < mesh.numLods; ++level)
+				if ((uint64_t) mesh.lods[level].baseIndex + mesh.lods[level].numIndices > indexCount)
+					throw std::runtime_error("Mesh LOD indices out of range");
+		}
+
+		MeshCacheStream materials = reader.stream(MeshCache::Section_materials);
+		mNumSamplerDescriptors = materials.read<uint32_t>();
+		uint32_t numMaterials = materials.read<uint32_t>();
+		for (uint32_t i = 0; i < numMaterials; ++i) {
+			uint32_t materialIndex = materials.read<uint32_t>();
+			uint32_t numTextures = materials.read<uint32_t>();
+			Material materialInfo;
+			for (uint32_t j = 0; j < numTextures; ++j) {
+				aiTextureType textureType = (aiTextureType) materials.read<uint32_t>();
+				TextureDesc textureDesc(mFolder + "/" + materials.readString());
+				addMaterialImage(materialInfo, textureType, TextureManager::load(mState, textureDesc));
+			}
+			mMaterialIndexToMaterial[materialIndex] = materialInfo;
+		}
+	} catch (const std::runtime_error& e) {
+		LOG("MESH CACHE CORRUPT %s: %s", cachePath.c_str(), e.what());
+		mMeshes.clear();
+		mMaterialIndexToMaterial.clear();
+		mNumSamplerDescriptors = 0;
+		return false;
+	}
+
+	// uploads copy out of the mapping, it is released on return
+	createCommonBuffer(
+			(const Vertex*) vertices, 
+			(uint32_t) (verticesSize / sizeof(Vertex)), 
+			(const uint32_t*) indices, 
+			(uint32_t) (indicesSize / sizeof(uint32_t)));
+	createDescriptorPool();
+	createDescriptorSet();
+	LOG("MESH CACHE LOADED: %s", cachePath.c_str());
+	return true;
+}
+
 void Model::createCommonBuffer(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
 {
-	numVertices = vertices.size();
-	numIndices = indices.size();
+	createCommonBuffer(vertices.data(), vertices.size(), indices.data(), indices.size());
+}
 
-	VkDeviceSize uniformBufferSize = sizeof(UBO);
-	VkDeviceSize vertexBufferSize = sizeof(vertices[0]) * numVertices;
-	VkDeviceSize indexBufferSize = sizeof(indices[0]) * numIndices;
-	
-	uniformBufferOffset = 0;
-	vertexBufferOffset = uniformBufferSize;
-	indexBufferOffset = vertexBufferOffset + vertexBufferSize;
+void Model::createCommonBuffer(const Vertex* vertices, uint32_t numVertices, const uint32_t* indices, uint32_t numIndices)
+{
+	this->numVertices = numVertices;
+	this->numIndices = numIndices;
+
+	// the cache keeps float vertices, they are packed on the way to the GPU
+	std::vector<PackedVertex> packedVertices;
+	mPackedVertices = (mModelFlags & ModelFlag_packedVertices) != 0;
+	if (mPackedVertices) {
+		packedVertices.resize(numVertices);
+		for (uint32_t i = 0; i < numVertices; ++i) {
+			const Vertex& vertex = vertices[i];
+			PackedVertex& packed = packedVertices[i];
+			packed.pos = vertex.pos;
+			VertexPacking::packTangentFrame(vertex.normal, vertex.tangent, vertex.bitangent, packed.tangentFrame);
+			VertexPacking::packHalf2(vertex.texCoord, packed.texCoord);
+		}
+	}
+
+	// 16 bit indices relative to the first vertex of their mesh when every mesh
+	// fits, draws add the first vertex back
+	std::vector<uint16_t> packedIndices(numIndices);
+	mIndexType = VK_INDEX_TYPE_UINT16;
+	for (const Mesh& mesh : mMeshes) {
+		for (uint32_t level = 0; level < mesh.numLods && mIndexType == VK_INDEX_TYPE_UINT16; ++level) {
+			const Lod& lod = mesh.lods[level];
+			bool packed = lod.baseIndex + lod.numIndices <= numIndices && VertexPacking::packIndices16(
+					indices + lod.baseIndex, 
+					lod.numIndices, 
+					mesh.baseVertex, 
+					mesh.numVertices, 
+					packedIndices.data() + lod.baseIndex);
+			if (!packed)
+				mIndexType = VK_INDEX_TYPE_UINT32;
+		}
+	}
+	mMeshLods.assign(mMeshes.size(), 0);
 
-	mCommonBufferInfo.size = vertexBufferSize + indexBufferSize + uniformBufferSize;
-	mCommonStagingBufferInfo.size = mCommonBufferInfo.size;
-	BufferHelper::createStagingBuffer(mState, mCommonStagingBufferInfo);
+	VkDeviceSize vertexBufferSize = (VkDeviceSize) vertexStride() * numVertices;
+	VkDeviceSize indexBufferSize = (VkDeviceSize) indexSize() * numIndices;
 	
-	UBO ubo = {};
-	char* data;
-	vkMapMemory(mState.device, mCommonStagingBufferInfo.memory, 0, mCommonStagingBufferInfo.size, 0, (void**) &data);
-	memcpy(data + uniformBufferOffset, &ubo, uniformBufferSize);
-	memcpy(data + vertexBufferOffset, vertices.data(), vertexBufferSize);
-	memcpy(data + indexBufferOffset, indices.data(), indexBufferSize);
-	vkUnmapMemory(mState.device, mCommonStagingBufferInfo.memory);
+	// uniforms are written to the uniform ring every frame
+	vertexBufferOffset = 0;
+	indexBufferOffset = vertexBufferOffset + vertexBufferSize;
 
+	mCommonBufferInfo.size = vertexBufferSize + indexBufferSize;
 	BufferHelper::createCommonBuffer(mState, mCommonBufferInfo);
 
-	BufferHelper::copyBuffer(
-			mState,
-			mCommonStagingBufferInfo.buffer, 
-			mCommonBufferInfo.buffer, 
-			mCommonBufferInfo.size);
+	const void* vertexData = mPackedVertices ? (const void*) packedVertices.data() : (const void*) vertices;
+	mState.uploadManager->uploadBuffer(mCommonBufferInfo.buffer, vertexBufferOffset, vertexData, vertexBufferSize);
+	const void* indexData = mIndexType == VK_INDEX_TYPE_UINT16 ? (const void*) packedIndices.data() : (const void*) indices;
+	mState.uploadManager->uploadBuffer(mCommonBufferInfo.buffer, indexBufferOffset, indexData, indexBufferSize);
+	LOG("VERTICES of %s: %u, %u bytes each (%zu unpacked), %zu KB", 
+			mPath.c_str(), numVertices, vertexStride(), sizeof(Vertex), (size_t) (vertexBufferSize / 1024));
+	LOG("INDICES of %s: %u, %u bytes each, %zu KB", 
+			mPath.c_str(), numIndices, indexSize(), (size_t) (indexBufferSize / 1024));
 }
 
 void Model::createDescriptorPool() 
 {
 	VkDescriptorPoolSize uboSize = {};
-	uboSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	uboSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	uboSize.descriptorCount = mNumSamplerDescriptors + 1;
 	
 	VkDescriptorPoolSize samplerSize = {};
@@ -229,8 +489,8 @@ void Model::createDescriptorSet()
 	VK_CHECK_RESULT(vkAllocateDescriptorSets(mState.device, &allocInfo, &mUniformDescriptorSet));
 	
 	VkDescriptorBufferInfo buffInfo = {};
-	buffInfo.buffer = mCommonBufferInfo.buffer;
-	buffInfo.offset = uniformBufferOffset;
+	buffInfo.buffer = mUniformRing.buffer();
+	buffInfo.offset = 0;
 	buffInfo.range = sizeof(UBO);
 
 	VkWriteDescriptorSet uniformWriteSet = {};
@@ -238,7 +498,7 @@ void Model::createDescriptorSet()
 	uniformWriteSet.dstSet = mUniformDescriptorSet;
 	uniformWriteSet.dstBinding = 0;
 	uniformWriteSet.dstArrayElement = 0;
-	uniformWriteSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	uniformWriteSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	uniformWriteSet.descriptorCount = 1;
 	uniformWriteSet.pBufferInfo = &buffInfo;
 
@@ -316,9 +576,11 @@ void Model::draw(VkCommandBuffer& commandBuffer, VkPipeline& pipeline, VkPipelin
 	VkDeviceSize offset = vertexBufferOffset;
 	VkBuffer& commonBuff = mCommonBufferInfo.buffer;
 	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &commonBuff, &offset);
-	vkCmdBindIndexBuffer(commandBuffer, mCommonBufferInfo.buffer, indexBufferOffset, VK_INDEX_TYPE_UINT32);
+	vkCmdBindIndexBuffer(commandBuffer, mCommonBufferInfo.buffer, indexBufferOffset, mIndexType);
 	
-	for (const auto& mesh : mMeshes) {
+	uint32_t dynamicOffset = (uint32_t) uniformBufferOffset;
+	for (size_t i = 0; i < mMeshes.size(); ++i) {
+		const Mesh& mesh = mMeshes[i];
 		Material& material = mMaterialIndexToMaterial[mesh.materialIndex];
 		VkDescriptorSet sets[] = {
 			mUniformDescriptorSet,
@@ -332,26 +594,62 @@ void Model::draw(VkCommandBuffer& commandBuffer, VkPipeline& pipeline, VkPipelin
 			0, 
 			ARRAY_SIZE(sets), 
 			sets, 
-			0, 
-			nullptr);
-		vkCmdDrawIndexed(commandBuffer, mesh.numIndices, 1, mesh.baseIndex, 0, 0);
+			1, 
+			&dynamicOffset);
+		int32_t vertexOffset = mIndexType == VK_INDEX_TYPE_UINT16 ? (int32_t) mesh.baseVertex : 0;
+		const Lod& lod = mesh.lods[mMeshLods[i]];
+		vkCmdDrawIndexed(commandBuffer, lod.numIndices, 1, lod.baseIndex, vertexOffset, 0);
 	}
 }
 
-void Model::update(VkCommandBuffer& cmdBuffer, const Timer& timer, Camera& camera)
+void Model::update(const Timer& timer, Camera& camera)
 {
 	ubo.view = camera.view();
 	ubo.proj = camera.proj();
+	selectLods(camera);
 
-	vkCmdUpdateBuffer(
-			cmdBuffer,
-			mCommonBufferInfo.buffer,
-			uniformBufferOffset,
-			sizeof(UBO),
-			&ubo);
+	uniformBufferOffset = mUniformRing.write(ubo);
 			
 }
 
+void Model::selectLods(Camera& camera)
+{
+	glm::mat4 modelView = camera.view() * ubo.model;
+	float scale = std::max(glm::length(glm::vec3(ubo.model[0])), 
+			std::max(glm::length(glm::vec3(ubo.model[1])), glm::length(glm::vec3(ubo.model[2]))));
+	// cotangent of half the vertical field of view
+	float focal = std::fabs(camera.proj()[1][1]);
+
+	mTrianglesDrawn = 0;
+	for (size_t i = 0; i < mMeshes.size(); ++i) {
+		const Mesh& mesh = mMeshes[i];
+		uint32_t& level = mMeshLods[i];
+		if (!mLodSelection) {
+			level = 0;
+			mTrianglesDrawn += mesh.numIndices / 3;
+			continue;
+		}
+
+		glm::vec3 center = glm::vec3(modelView * glm::vec4(glm::vec3(mesh.bounds), 1.0f));
+		float radius = mesh.bounds.w * scale;
+		// radius over half the viewport height, lod errors are relative to it
+		float distance = glm::length(center);
+		float screenSize = distance > radius ? radius * focal / distance : std::numeric_limits<float>::max();
+
+		while (level + 1 < mesh.numLods 
+				&& mesh.lods[level + 1].error * screenSize <= LOD_SCREEN_ERROR * (1.0f - LOD_HYSTERESIS))
+			++level;
+		while (level > 0 && mesh.lods[level].error * screenSize > LOD_SCREEN_ERROR)
+			--level;
+		mTrianglesDrawn += mesh.lods[level].numIndices / 3;
+	}
+}
+
+PipelineInfo& Model::pipeline(Pipelines& pipelines) const
+{
+	return isPacked() ? pipelines.modelPacked : pipelines.model;
+}
+
 void Model::convertVector(const aiVector3D& src, glm::vec3& dest)
 {
     dest.x = src.x;
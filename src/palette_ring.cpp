@@ -0,0 +1,100 @@
+#include "palette_ring.h"
+
+PaletteRing::PaletteRing(VulkanState& vulkanState):
+	mState(vulkanState),
+	mBufferInfo(vulkanState.device),
+	mDescriptorPool(VK_NULL_HANDLE),
+	mDescriptorSet(VK_NULL_HANDLE),
+	mData(nullptr),
+	mFrameCount(0),
+	mFrameOffset(0),
+	mHead(0)
+{
+
+}
+
+PaletteRing::~PaletteRing()
+{
+	if (mDescriptorPool != VK_NULL_HANDLE)
+		vkDestroyDescriptorPool(mState.device, mDescriptorPool, nullptr);
+}
+
+void PaletteRing::init(uint32_t numFrames, VkDeviceSize frameSize)
+{
+	mFrameCount = (uint32_t) (frameSize / sizeof(glm::vec4));
+	mBufferInfo.size = (VkDeviceSize) mFrameCount * numFrames * sizeof(glm::vec4);
+
+	BufferHelper::createBuffer(
+			mState,
+			mBufferInfo,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	// host visible memory stays mapped by the allocator
+	mData = (glm::vec4*) mBufferInfo.allocation.mapped;
+
+	VkDescriptorPoolSize storageSize = {};
+	storageSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	storageSize.descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &storageSize;
+	poolInfo.maxSets = 1;
+
+	VK_CHECK_RESULT(vkCreateDescriptorPool(mState.device, &poolInfo, nullptr, &mDescriptorPool));
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = mDescriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &mState.descriptorSetLayouts.storage;
+
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(mState.device, &allocInfo, &mDescriptorSet));
+
+	// every frame region, indices passed to the shaders are absolute
+	VkDescriptorBufferInfo buffInfo = {};
+	buffInfo.buffer = mBufferInfo.buffer;
+	buffInfo.offset = 0;
+	buffInfo.range = mBufferInfo.size;
+
+	VkWriteDescriptorSet writeSet = {};
+	writeSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writeSet.dstSet = mDescriptorSet;
+	writeSet.dstBinding = 0;
+	writeSet.dstArrayElement = 0;
+	writeSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	writeSet.descriptorCount = 1;
+	writeSet.pBufferInfo = &buffInfo;
+
+	vkUpdateDescriptorSets(mState.device, 1, &writeSet, 0, nullptr);
+
+	LOG("PALETTE RING CREATED frames: %u frame size: %llu",
+			numFrames,
+			(unsigned long long) (mFrameCount * sizeof(glm::vec4)));
+}
+
+void PaletteRing::beginFrame(uint32_t frameIndex)
+{
+	mFrameOffset = frameIndex * mFrameCount;
+	mHead.store(0);
+}
+
+uint32_t PaletteRing::allocate(uint32_t count, glm::vec4** data)
+{
+	uint32_t offset = mHead.fetch_add(count);
+	if (offset + count > mFrameCount)
+		throw std::runtime_error("Palette ring frame overflow, increase frame size");
+	*data = mData + mFrameOffset + offset;
+	return mFrameOffset + offset;
+}
+
+VkDescriptorSet PaletteRing::descriptorSet() const
+{
+	return mDescriptorSet;
+}
+
+VkDeviceSize PaletteRing::used() const
+{
+	return std::min(mHead.load(), mFrameCount) * sizeof(glm::vec4);
+}
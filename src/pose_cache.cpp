@@ -0,0 +1,124 @@
+#include "pose_cache.h"
+
+#include <cmath>
+
+bool PoseCache::Key::operator==(const Key& other) const
+{
+	return skeletonId == other.skeletonId && clipId == other.clipId && frame == other.frame;
+}
+
+uint64_t PoseCache::hashKey(const Key& key)
+{
+	// splitmix64 finalizer over the combined fields
+	uint64_t h = key.skeletonId ^ ((uint64_t) key.clipId << 48) ^ ((uint64_t) key.frame * 0x9E3779B97F4A7C15ull);
+	h ^= h >> 30;
+	h *= 0xBF58476D1CE4E5B9ull;
+	h ^= h >> 27;
+	h *= 0x94D049BB133111EBull;
+	h ^= h >> 31;
+	// 0 marks free slots
+	return h ? h : 1;
+}
+
+PoseCache::PoseCache(double posesPerSecond):
+	mPosesPerSecond(posesPerSecond),
+	mCapacity(0),
+	mNumClaimed(0),
+	mOverflowed(false),
+	mNumLookups(0),
+	mNumEvaluations(0)
+{
+	resize(DEFAULT_CAPACITY);
+}
+
+void PoseCache::resize(uint32_t capacity)
+{
+	mSlots.reset(new Slot[capacity]);
+	mCapacity = capacity;
+}
+
+void PoseCache::beginFrame()
+{
+	if (mOverflowed.load()) {
+		resize(mCapacity * 2);
+		mOverflowed = false;
+	}
+	for (uint32_t i = 0; i < mCapacity; ++i) {
+		mSlots[i].hash.store(0, std::memory_order_relaxed);
+		mSlots[i].offset.store(INVALID_OFFSET, std::memory_order_relaxed);
+	}
+	mNumClaimed = 0;
+	mNumLookups = 0;
+	mNumEvaluations = 0;
+}
+
+int64_t PoseCache::poseFrame(const AnimClip& clip, float time) const
+{
+	double ticksPerPose = clip.ticksPerSecond() / mPosesPerSecond;
+	return (int64_t) std::floor(time / ticksPerPose);
+}
+
+float PoseCache::poseTime(const AnimClip& clip, float time) const
+{
+	// every instance in a quantization step samples the pose at its start
+	double ticksPerPose = clip.ticksPerSecond() / mPosesPerSecond;
+	return (float) (poseFrame(clip, time) * ticksPerPose);
+}
+
+uint32_t PoseCache::find(uint64_t skeletonId, uint32_t clipId, const AnimClip& clip, float time, Claim& claim)
+{
+	mNumLookups.fetch_add(1, std::memory_order_relaxed);
+	claim = Claim();
+	Key key;
+	key.skeletonId = skeletonId;
+	key.clipId = clipId;
+	key.frame = poseFrame(clip, time);
+	uint64_t hash = hashKey(key);
+
+	uint32_t mask = mCapacity - 1;
+	for (uint32_t probe = 0; probe < mCapacity; ++probe) {
+		Slot& slot = mSlots[(uint32_t) (hash + probe) & mask];
+		uint64_t slotHash = slot.hash.load(std::memory_order_acquire);
+
+		if (slotHash == 0) {
+			if (mNumClaimed.fetch_add(1, std::memory_order_relaxed) >= mCapacity / 4 * 3) {
+				// full for this frame, evaluated without sharing
+				mNumClaimed.fetch_sub(1, std::memory_order_relaxed);
+				mOverflowed = true;
+				break;
+			}
+			if (slot.hash.compare_exchange_strong(slotHash, hash, std::memory_order_acq_rel)) {
+				slot.key = key;
+				claim.slot = (uint32_t) (hash + probe) & mask;
+				break;
+			}
+			mNumClaimed.fetch_sub(1, std::memory_order_relaxed);
+			// lost the slot, slotHash is the winner's
+		}
+
+		if (slotHash == hash) {
+			uint32_t offset = slot.offset.load(std::memory_order_acquire);
+			// still being evaluated, the key may not be written yet
+			if (offset == INVALID_OFFSET)
+				break;
+			if (slot.key == key)
+				return offset;
+		}
+	}
+	mNumEvaluations.fetch_add(1, std::memory_order_relaxed);
+	return INVALID_OFFSET;
+}
+
+void PoseCache::publish(const Claim& claim, uint32_t offset)
+{
+	if (claim.isValid())
+		mSlots[claim.slot].offset.store(offset, std::memory_order_release);
+}
+
+PoseCache::Stats PoseCache::stats() const
+{
+	Stats stats;
+	stats.lookups = mNumLookups.load();
+	stats.evaluations = mNumEvaluations.load();
+	return stats;
+}
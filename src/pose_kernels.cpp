@@ -0,0 +1,374 @@
+#include "pose_kernels.h"
+
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && defined(__SSE2__)
+#define AMVK_POSE_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+void PoseBatch::resize(uint32_t count)
+{
+	uint32_t paddedCount = (count + MAX_LANES - 1) / MAX_LANES * MAX_LANES;
+	this->count = count;
+	if (paddedCount == this->paddedCount)
+		return;
+
+	uint32_t oldCount = this->paddedCount;
+	this->paddedCount = paddedCount;
+	for (uint32_t i = 0; i < NUM_STREAMS; ++i)
+		streams[i].resize(paddedCount);
+	for (uint32_t lane = oldCount; lane < paddedCount; ++lane)
+		setIdentity(lane);
+}
+
+void PoseBatch::setIdentity(uint32_t lane)
+{
+	for (uint32_t i = 0; i < NUM_STREAMS; ++i)
+		streams[i][lane] = 0.0f;
+	streams[Stream_q0w][lane] = 1.0f;
+	streams[Stream_q1w][lane] = 1.0f;
+	for (uint32_t i = Stream_s0x; i <= Stream_s1z; ++i)
+		streams[i][lane] = 1.0f;
+}
+
+namespace PoseKernels
+{
+
+// Nlerp moves at a constant rate along the chord, not the arc. Bending t by a
+// cubic fitted against the angle between the keys, d = |dot(q0, q1)|, keeps the
+// result within 1e-3 of slerp without any trigonometry
+#define SLERP_A0 1.0904f
+#define SLERP_A1 -3.2452f
+#define SLERP_A2 3.55645f
+#define SLERP_A3 -1.43519f
+#define SLERP_B0 0.848013f
+#define SLERP_B1 -1.06021f
+#define SLERP_B2 0.215638f
+
+static inline float slerpFactor(float t, float d)
+{
+	float a = SLERP_A0 + d * (SLERP_A1 + d * (SLERP_A2 + d * SLERP_A3));
+	float b = SLERP_B0 + d * (SLERP_B1 + d * SLERP_B2);
+	float k = a * (t - 0.5f) * (t - 0.5f) + b;
+	return t + t * (t - 0.5f) * (t - 1.0f) * k;
+}
+
+static void composeScalar(const PoseBatch& batch, glm::mat4* out)
+{
+	const float* p0x = batch.stream(PoseBatch::Stream_p0x);
+	const float* p0y = batch.stream(PoseBatch::Stream_p0y);
+	const float* p0z = batch.stream(PoseBatch::Stream_p0z);
+	const float* p1x = batch.stream(PoseBatch::Stream_p1x);
+	const float* p1y = batch.stream(PoseBatch::Stream_p1y);
+	const float* p1z = batch.stream(PoseBatch::Stream_p1z);
+	const float* pt = batch.stream(PoseBatch::Stream_pt);
+	const float* q0x = batch.stream(PoseBatch::Stream_q0x);
+	const float* q0y = batch.stream(PoseBatch::Stream_q0y);
+	const float* q0z = batch.stream(PoseBatch::Stream_q0z);
+	const float* q0w = batch.stream(PoseBatch::Stream_q0w);
+	const float* q1x = batch.stream(PoseBatch::Stream_q1x);
+	const float* q1y = batch.stream(PoseBatch::Stream_q1y);
+	const float* q1z = batch.stream(PoseBatch::Stream_q1z);
+	const float* q1w = batch.stream(PoseBatch::Stream_q1w);
+	const float* qt = batch.stream(PoseBatch::Stream_qt);
+	const float* s0x = batch.stream(PoseBatch::Stream_s0x);
+	const float* s0y = batch.stream(PoseBatch::Stream_s0y);
+	const float* s0z = batch.stream(PoseBatch::Stream_s0z);
+	const float* s1x = batch.stream(PoseBatch::Stream_s1x);
+	const float* s1y = batch.stream(PoseBatch::Stream_s1y);
+	const float* s1z = batch.stream(PoseBatch::Stream_s1z);
+	const float* st = batch.stream(PoseBatch::Stream_st);
+
+	for (uint32_t i = 0; i < batch.paddedCount; ++i) {
+		// shortest arc
+		float dot = q0x[i] * q1x[i] + q0y[i] * q1y[i] + q0z[i] * q1z[i] + q0w[i] * q1w[i];
+		float sign = dot < 0.0f ? -1.0f : 1.0f;
+		float t = slerpFactor(qt[i], std::abs(dot));
+		float x = q0x[i] + (sign * q1x[i] - q0x[i]) * t;
+		float y = q0y[i] + (sign * q1y[i] - q0y[i]) * t;
+		float z = q0z[i] + (sign * q1z[i] - q0z[i]) * t;
+		float w = q0w[i] + (sign * q1w[i] - q0w[i]) * t;
+		float invLength = 1.0f / std::sqrt(x * x + y * y + z * z + w * w);
+		x *= invLength;
+		y *= invLength;
+		z *= invLength;
+		w *= invLength;
+
+		float sx = s0x[i] + (s1x[i] - s0x[i]) * st[i];
+		float sy = s0y[i] + (s1y[i] - s0y[i]) * st[i];
+		float sz = s0z[i] + (s1z[i] - s0z[i]) * st[i];
+
+		glm::mat4& m = out[i];
+		m[0] = glm::vec4((1.0f - 2.0f * (y * y + z * z)) * sx, 2.0f * (x * y + w * z) * sx, 2.0f * (x * z - w * y) * sx, 0.0f);
+		m[1] = glm::vec4(2.0f * (x * y - w * z) * sy, (1.0f - 2.0f * (x * x + z * z)) * sy, 2.0f * (y * z + w * x) * sy, 0.0f);
+		m[2] = glm::vec4(2.0f * (x * z + w * y) * sz, 2.0f * (y * z - w * x) * sz, (1.0f - 2.0f * (x * x + y * y)) * sz, 0.0f);
+		m[3] = glm::vec4(
+			p0x[i] + (p1x[i] - p0x[i]) * pt[i],
+			p0y[i] + (p1y[i] - p0y[i]) * pt[i],
+			p0z[i] + (p1z[i] - p0z[i]) * pt[i],
+			1.0f);
+	}
+}
+
+#ifdef AMVK_POSE_KERNELS_X86
+
+// Columns of 4 lanes transposed into one matrix per lane
+static inline void storeColumnsSse(glm::mat4* out, __m128 c0[3], __m128 c1[3], __m128 c2[3], __m128 c3[3])
+{
+	__m128* columns[4] = {c0, c1, c2, c3};
+	for (uint32_t c = 0; c < 4; ++c) {
+		__m128 x = columns[c][0];
+		__m128 y = columns[c][1];
+		__m128 z = columns[c][2];
+		__m128 w = _mm_set1_ps(c == 3 ? 1.0f : 0.0f);
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		_mm_storeu_ps(&out[0][c][0], x);
+		_mm_storeu_ps(&out[1][c][0], y);
+		_mm_storeu_ps(&out[2][c][0], z);
+		_mm_storeu_ps(&out[3][c][0], w);
+	}
+}
+
+static inline __m128 lerpSse(__m128 a, __m128 b, __m128 t)
+{
+	return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+static inline __m128 slerpFactorSse(__m128 t, __m128 d)
+{
+	__m128 a = _mm_add_ps(_mm_set1_ps(SLERP_A0), _mm_mul_ps(d, _mm_add_ps(_mm_set1_ps(SLERP_A1),
+		_mm_mul_ps(d, _mm_add_ps(_mm_set1_ps(SLERP_A2), _mm_mul_ps(d, _mm_set1_ps(SLERP_A3)))))));
+	__m128 b = _mm_add_ps(_mm_set1_ps(SLERP_B0), _mm_mul_ps(d, _mm_add_ps(_mm_set1_ps(SLERP_B1), _mm_mul_ps(d, _mm_set1_ps(SLERP_B2)))));
+	__m128 centered = _mm_sub_ps(t, _mm_set1_ps(0.5f));
+	__m128 k = _mm_add_ps(_mm_mul_ps(a, _mm_mul_ps(centered, centered)), b);
+	__m128 bend = _mm_mul_ps(_mm_mul_ps(t, centered), _mm_sub_ps(t, _mm_set1_ps(1.0f)));
+	return _mm_add_ps(t, _mm_mul_ps(bend, k));
+}
+
+static void composeSse(const PoseBatch& batch, glm::mat4* out)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+
+	for (uint32_t i = 0; i < batch.paddedCount; i += 4) {
+		#define LOAD(s) _mm_loadu_ps(batch.stream(PoseBatch::s) + i)
+		__m128 q0x = LOAD(Stream_q0x), q0y = LOAD(Stream_q0y), q0z = LOAD(Stream_q0z), q0w = LOAD(Stream_q0w);
+		__m128 q1x = LOAD(Stream_q1x), q1y = LOAD(Stream_q1y), q1z = LOAD(Stream_q1z), q1w = LOAD(Stream_q1w);
+		__m128 qt = LOAD(Stream_qt);
+
+		// shortest arc, flip the sign bit of q1 where the dot product is negative
+		__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(q0x, q1x), _mm_mul_ps(q0y, q1y)),
+			_mm_add_ps(_mm_mul_ps(q0z, q1z), _mm_mul_ps(q0w, q1w)));
+		__m128 flip = _mm_and_ps(dot, signMask);
+		qt = slerpFactorSse(qt, _mm_andnot_ps(signMask, dot));
+		__m128 x = lerpSse(q0x, _mm_xor_ps(q1x, flip), qt);
+		__m128 y = lerpSse(q0y, _mm_xor_ps(q1y, flip), qt);
+		__m128 z = lerpSse(q0z, _mm_xor_ps(q1z, flip), qt);
+		__m128 w = lerpSse(q0w, _mm_xor_ps(q1w, flip), qt);
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+			_mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w))));
+		__m128 invLength = _mm_div_ps(one, length);
+		x = _mm_mul_ps(x, invLength);
+		y = _mm_mul_ps(y, invLength);
+		z = _mm_mul_ps(z, invLength);
+		w = _mm_mul_ps(w, invLength);
+
+		__m128 st = LOAD(Stream_st);
+		__m128 sx = lerpSse(LOAD(Stream_s0x), LOAD(Stream_s1x), st);
+		__m128 sy = lerpSse(LOAD(Stream_s0y), LOAD(Stream_s1y), st);
+		__m128 sz = lerpSse(LOAD(Stream_s0z), LOAD(Stream_s1z), st);
+
+		__m128 pt = LOAD(Stream_pt);
+		__m128 c3[3] = {
+			lerpSse(LOAD(Stream_p0x), LOAD(Stream_p1x), pt),
+			lerpSse(LOAD(Stream_p0y), LOAD(Stream_p1y), pt),
+			lerpSse(LOAD(Stream_p0z), LOAD(Stream_p1z), pt)
+		};
+		#undef LOAD
+
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		__m128 c0[3] = {
+			_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+			_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx),
+			_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx)
+		};
+		__m128 c1[3] = {
+			_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy),
+			_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+			_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy)
+		};
+		__m128 c2[3] = {
+			_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz),
+			_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz),
+			_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz)
+		};
+		storeColumnsSse(out + i, c0, c1, c2, c3);
+	}
+}
+
+#define AMVK_AVX2 __attribute__((target("avx2,fma")))
+
+static inline AMVK_AVX2 __m256 lerpAvx(__m256 a, __m256 b, __m256 t)
+{
+	return _mm256_fmadd_ps(_mm256_sub_ps(b, a), t, a);
+}
+
+static inline AMVK_AVX2 __m256 slerpFactorAvx(__m256 t, __m256 d)
+{
+	__m256 a = _mm256_fmadd_ps(d, _mm256_fmadd_ps(d, _mm256_fmadd_ps(d, _mm256_set1_ps(SLERP_A3), _mm256_set1_ps(SLERP_A2)),
+		_mm256_set1_ps(SLERP_A1)), _mm256_set1_ps(SLERP_A0));
+	__m256 b = _mm256_fmadd_ps(d, _mm256_fmadd_ps(d, _mm256_set1_ps(SLERP_B2), _mm256_set1_ps(SLERP_B1)), _mm256_set1_ps(SLERP_B0));
+	__m256 centered = _mm256_sub_ps(t, _mm256_set1_ps(0.5f));
+	__m256 k = _mm256_fmadd_ps(a, _mm256_mul_ps(centered, centered), b);
+	__m256 bend = _mm256_mul_ps(_mm256_mul_ps(t, centered), _mm256_sub_ps(t, _mm256_set1_ps(1.0f)));
+	return _mm256_fmadd_ps(bend, k, t);
+}
+
+// Columns of 8 lanes transposed into one matrix per lane, 4 lanes at a time
+static inline AMVK_AVX2 void storeColumnsAvx(glm::mat4* out, __m256 c0[3], __m256 c1[3], __m256 c2[3], __m256 c3[3])
+{
+	__m256* columns[4] = {c0, c1, c2, c3};
+	for (uint32_t c = 0; c < 4; ++c) {
+		__m128 w = _mm_set1_ps(c == 3 ? 1.0f : 0.0f);
+		for (uint32_t half = 0; half < 2; ++half) {
+			__m128 x = half ? _mm256_extractf128_ps(columns[c][0], 1) : _mm256_castps256_ps128(columns[c][0]);
+			__m128 y = half ? _mm256_extractf128_ps(columns[c][1], 1) : _mm256_castps256_ps128(columns[c][1]);
+			__m128 z = half ? _mm256_extractf128_ps(columns[c][2], 1) : _mm256_castps256_ps128(columns[c][2]);
+			__m128 hw = w;
+			_MM_TRANSPOSE4_PS(x, y, z, hw);
+			glm::mat4* m = out + half * 4;
+			_mm_storeu_ps(&m[0][c][0], x);
+			_mm_storeu_ps(&m[1][c][0], y);
+			_mm_storeu_ps(&m[2][c][0], z);
+			_mm_storeu_ps(&m[3][c][0], hw);
+		}
+	}
+}
+
+static AMVK_AVX2 void composeAvx2(const PoseBatch& batch, glm::mat4* out)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+	for (uint32_t i = 0; i < batch.paddedCount; i += 8) {
+		#define LOAD(s) _mm256_loadu_ps(batch.stream(PoseBatch::s) + i)
+		__m256 q0x = LOAD(Stream_q0x), q0y = LOAD(Stream_q0y), q0z = LOAD(Stream_q0z), q0w = LOAD(Stream_q0w);
+		__m256 q1x = LOAD(Stream_q1x), q1y = LOAD(Stream_q1y), q1z = LOAD(Stream_q1z), q1w = LOAD(Stream_q1w);
+		__m256 qt = LOAD(Stream_qt);
+
+		__m256 dot = _mm256_fmadd_ps(q0x, q1x, _mm256_fmadd_ps(q0y, q1y, _mm256_fmadd_ps(q0z, q1z, _mm256_mul_ps(q0w, q1w))));
+		__m256 flip = _mm256_and_ps(dot, signMask);
+		qt = slerpFactorAvx(qt, _mm256_andnot_ps(signMask, dot));
+		__m256 x = lerpAvx(q0x, _mm256_xor_ps(q1x, flip), qt);
+		__m256 y = lerpAvx(q0y, _mm256_xor_ps(q1y, flip), qt);
+		__m256 z = lerpAvx(q0z, _mm256_xor_ps(q1z, flip), qt);
+		__m256 w = lerpAvx(q0w, _mm256_xor_ps(q1w, flip), qt);
+		__m256 length = _mm256_sqrt_ps(_mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y, _mm256_fmadd_ps(z, z, _mm256_mul_ps(w, w)))));
+		__m256 invLength = _mm256_div_ps(one, length);
+		x = _mm256_mul_ps(x, invLength);
+		y = _mm256_mul_ps(y, invLength);
+		z = _mm256_mul_ps(z, invLength);
+		w = _mm256_mul_ps(w, invLength);
+
+		__m256 st = LOAD(Stream_st);
+		__m256 sx = lerpAvx(LOAD(Stream_s0x), LOAD(Stream_s1x), st);
+		__m256 sy = lerpAvx(LOAD(Stream_s0y), LOAD(Stream_s1y), st);
+		__m256 sz = lerpAvx(LOAD(Stream_s0z), LOAD(Stream_s1z), st);
+
+		__m256 pt = LOAD(Stream_pt);
+		__m256 c3[3] = {
+			lerpAvx(LOAD(Stream_p0x), LOAD(Stream_p1x), pt),
+			lerpAvx(LOAD(Stream_p0y), LOAD(Stream_p1y), pt),
+			lerpAvx(LOAD(Stream_p0z), LOAD(Stream_p1z), pt)
+		};
+		#undef LOAD
+
+		// products of doubled components, saving the multiplies by two
+		__m256 x2 = _mm256_add_ps(x, x), y2 = _mm256_add_ps(y, y), z2 = _mm256_add_ps(z, z);
+		__m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+		__m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+		__m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+
+		__m256 c0[3] = {
+			_mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx),
+			_mm256_mul_ps(_mm256_add_ps(xy, wz), sx),
+			_mm256_mul_ps(_mm256_sub_ps(xz, wy), sx)
+		};
+		__m256 c1[3] = {
+			_mm256_mul_ps(_mm256_sub_ps(xy, wz), sy),
+			_mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy),
+			_mm256_mul_ps(_mm256_add_ps(yz, wx), sy)
+		};
+		__m256 c2[3] = {
+			_mm256_mul_ps(_mm256_add_ps(xz, wy), sz),
+			_mm256_mul_ps(_mm256_sub_ps(yz, wx), sz),
+			_mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz)
+		};
+		storeColumnsAvx(out + i, c0, c1, c2, c3);
+	}
+}
+
+#endif
+
+Isa detectIsa()
+{
+	static const Isa isa = isSupported(Isa_avx2) ? Isa_avx2 : isSupported(Isa_sse) ? Isa_sse : Isa_scalar;
+	return isa;
+}
+
+bool isSupported(Isa isa)
+{
+	switch (isa) {
+		case Isa_scalar:
+			return true;
+#ifdef AMVK_POSE_KERNELS_X86
+		case Isa_sse:
+			return true;
+		case Isa_avx2:
+			return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+		default:
+			return false;
+	}
+}
+
+const char* isaName(Isa isa)
+{
+	switch (isa) {
+		case Isa_sse:
+			return "sse";
+		case Isa_avx2:
+			return "avx2";
+		default:
+			return "scalar";
+	}
+}
+
+void composeTRS(const PoseBatch& batch, glm::mat4* out)
+{
+	composeTRS(batch, out, detectIsa());
+}
+
+void composeTRS(const PoseBatch& batch, glm::mat4* out, Isa isa)
+{
+	switch (isa) {
+#ifdef AMVK_POSE_KERNELS_X86
+		case Isa_avx2:
+			composeAvx2(batch, out);
+			break;
+		case Isa_sse:
+			composeSse(batch, out);
+			break;
+#endif
+		default:
+			composeScalar(batch, out);
+			break;
+	}
+}
+
+};
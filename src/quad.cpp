@@ -1,9 +1,10 @@
 #include "quad.h"
 
-Quad::Quad(VulkanState& vulkanState):
+Quad::Quad(VulkanState& vulkanState, UniformRing& uniformRing):
+	mUniformBufferOffset(0),
 	mVulkanState(vulkanState), 
+	mUniformRing(uniformRing),
 	mCommonBufferInfo(vulkanState.device),
-	mCommonStagingBufferInfo(vulkanState.device),
 	mVertexBufferDesc(vulkanState.device),
 	mIndexBufferDesc(vulkanState.device),
 	mUniformBufferDesc(vulkanState.device),
@@ -22,15 +23,13 @@ void Quad::init()
 	TextureDesc textureDesc(FileManager::getResourcePath("texture/statue.jpg"));//"texture/statue.jpg"));
 	mTextureDesc = TextureManager::load(
 			mVulkanState, 
-			mVulkanState.commandPool, 
-			mVulkanState.graphicsQueue, 
 			textureDesc);
 
 	createBuffers();
 	createDescriptorSet();
 }
 
-void Quad::update(VkCommandBuffer& commandBuffer, const Timer& timer, Camera& camera) 
+void Quad::update(const Timer& timer, Camera& camera) 
 {
 
 	UBO ubo = {};
@@ -52,12 +51,7 @@ void Quad::update(VkCommandBuffer& commandBuffer, const Timer& timer, Camera& ca
 
 	//CmdPass cmdPass(mVulkanState.device, mVulkanState.commandPool, mVulkanState.graphicsQueue);
 
-	vkCmdUpdateBuffer(
-			commandBuffer,
-			mCommonBufferInfo.buffer,
-			mUniformBufferOffset,
-			UBO_SIZE,
-			&ubo);
+	mUniformBufferOffset = mUniformRing.write(ubo);
 	/*
 	void* data;
 	vkMapMemory(mVulkanState.device, mUniformStagingBufferDesc.memory, 0, sizeof(ubo), 0, &data);
@@ -103,6 +97,7 @@ void Quad::draw(VkCommandBuffer& commandBuffer)
 	//vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertBuf, offsets);
 	//vkCmdBindIndexBuffer(commandBuffer, mIndexBufferDesc.buffer, 0, VK_INDEX_TYPE_UINT32);
 	
+	uint32_t dynamicOffset = (uint32_t) mUniformBufferOffset;
 	vkCmdBindDescriptorSets(
 			commandBuffer, 
 			VK_PIPELINE_BIND_POINT_GRAPHICS, 
@@ -110,8 +105,8 @@ void Quad::draw(VkCommandBuffer& commandBuffer)
 			0, 
 			1, 
 			&mVkDescriptorSet, 
-			0, 
-			nullptr);
+			1, 
+			&dynamicOffset);
 
 	vkCmdDrawIndexed(commandBuffer, numIndices, 1, 0, 0, 0);
 }
@@ -145,36 +140,14 @@ void Quad::createBuffers()
 	numIndices = indices.size(); 
 	VkDeviceSize indexBufferSize = sizeof(indices[0]) * indices.size();
 	
-	// Uniform
-	//TODO: check how to add uniform without recopying same buffer
-	VkDeviceSize uniformBufferSize = UBO_SIZE;
-	UBO ubo = {};
-	
-	mUniformBufferOffset = 0;
-	mVertexBufferOffset = uniformBufferSize;
-	mIndexBufferOffset = uniformBufferSize + vertexBufferSize;
-
-	//mVertexBufferOffset = 0;
-	//mIndexBufferOffset = vertexBufferSize;
-	//mUniformBufferOffset = vertexBufferSize + indexBufferSize;
-	mCommonBufferInfo.size = vertexBufferSize + indexBufferSize + uniformBufferSize;
-	mCommonStagingBufferInfo.size = mCommonBufferInfo.size;
-	BufferHelper::createStagingBuffer(mVulkanState, mCommonStagingBufferInfo);
-	
-	char* data;
-	vkMapMemory(mVulkanState.device, mCommonStagingBufferInfo.memory, 0, mCommonStagingBufferInfo.size, 0, (void**) &data);
-	memcpy(data + mUniformBufferOffset, &ubo, (size_t) uniformBufferSize);
-	memcpy(data + mVertexBufferOffset, vertices.data(), vertexBufferSize);
-	memcpy(data + mIndexBufferOffset, indices.data(), indexBufferSize);
-	vkUnmapMemory(mVulkanState.device, mCommonStagingBufferInfo.memory);
-
+	// Uniforms are written to the uniform ring every frame
+	mVertexBufferOffset = 0;
+	mIndexBufferOffset = vertexBufferSize;
+	mCommonBufferInfo.size = vertexBufferSize + indexBufferSize;
 	BufferHelper::createCommonBuffer(mVulkanState, mCommonBufferInfo);
 
-	BufferHelper::copyBuffer(
-			mVulkanState,
-			mCommonStagingBufferInfo.buffer, 
-			mCommonBufferInfo.buffer, 
-			mCommonBufferInfo.size);
+	mVulkanState.uploadManager->uploadBuffer(mCommonBufferInfo.buffer, mVertexBufferOffset, vertices.data(), vertexBufferSize);
+	mVulkanState.uploadManager->uploadBuffer(mCommonBufferInfo.buffer, mIndexBufferOffset, indices.data(), indexBufferSize);
 }
 
 void Quad::createVertexBuffer() 
@@ -253,8 +226,8 @@ void Quad::createDescriptorSet()
 	VK_CHECK_RESULT(vkAllocateDescriptorSets(mVulkanState.device, &allocInfo, &mVkDescriptorSet));
 
 	VkDescriptorBufferInfo buffInfo = {};
-	buffInfo.buffer = mCommonBufferInfo.buffer;
-	buffInfo.offset = mUniformBufferOffset;
+	buffInfo.buffer = mUniformRing.buffer();
+	buffInfo.offset = 0;
 	buffInfo.range = UBO_SIZE;
 
 	VkDescriptorImageInfo imageInfo = {};
@@ -268,7 +241,7 @@ void Quad::createDescriptorSet()
 	writeSets[0].dstSet = mVkDescriptorSet;
 	writeSets[0].dstBinding = 0;
 	writeSets[0].dstArrayElement = 0;
-	writeSets[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	writeSets[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	writeSets[0].descriptorCount = 1;
 	writeSets[0].pBufferInfo = &buffInfo;
 
@@ -0,0 +1,55 @@
+#include "skeleton.h"
+
+PoseScratch& PoseScratch::local()
+{
+	static thread_local PoseScratch scratch;
+	return scratch;
+}
+
+Skeleton::Skeleton():
+	modelSpaceTransform(1.0f)
+{
+
+}
+
+uint32_t Skeleton::addNode(int32_t parent, uint32_t boneIndex, const glm::mat4& transformation)
+{
+	uint32_t index = numNodes();
+	parents.push_back(parent);
+	boneIndices.push_back(boneIndex);
+	transformations.push_back(transformation);
+	return index;
+}
+
+void Skeleton::clear()
+{
+	parents.clear();
+	boneIndices.clear();
+	transformations.clear();
+	boneOffsets.clear();
+	modelSpaceTransform = glm::mat4(1.0f);
+}
+
+void Skeleton::computePalette(const AnimClip& clip, float time, AnimClip::Cursor& cursor, glm::mat4* palette, uint32_t paletteSize)
+{
+	uint32_t numNodes = this->numNodes();
+	PoseScratch& scratch = PoseScratch::local();
+	scratch.batch.resize(numNodes);
+	scratch.animated.resize(numNodes);
+	scratch.localTransforms.resize(scratch.batch.paddedCount);
+	scratch.modelTransforms.resize(numNodes);
+
+	for (uint32_t i = 0; i < numNodes; ++i)
+		scratch.animated[i] = clip.sampleKeys(i, time, cursor, scratch.batch, i);
+	PoseKernels::composeTRS(scratch.batch, scratch.localTransforms.data());
+
+	for (uint32_t i = 0; i < numNodes; ++i) {
+		const glm::mat4& local = scratch.animated[i] ? scratch.localTransforms[i] : transformations[i];
+		int32_t parent = parents[i];
+		scratch.modelTransforms[i] = (parent < 0 ? modelSpaceTransform : scratch.modelTransforms[parent]) * local;
+
+		uint32_t bone = boneIndices[i];
+		if (bone < paletteSize)
+			palette[bone] = scratch.modelTransforms[i] * boneOffsets[bone];
+	}
+}
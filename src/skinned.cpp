@@ -1,4 +1,10 @@
 #include "skinned.h"
+#include "vertex_packing.h"
+#include "mesh_optimizer.h"
+#include "task_manager.h"
+
+#include <cmath>
+#include <algorithm>
 
 static const aiTextureType Skinned_TEXTURE_TYPES[] ={
 	aiTextureType_DIFFUSE
@@ -11,8 +17,10 @@ const aiTextureType* Skinned::TEXTURE_TYPES = Skinned_TEXTURE_TYPES;
 
 const uint32_t Skinned::NUM_TEXTURE_TYPES = ARRAY_SIZE(Skinned_TEXTURE_TYPES);
 
-Skinned::Skinned(VulkanState& vulkanState):
+Skinned::Skinned(VulkanState& vulkanState, UniformRing& uniformRing, PaletteRing& paletteRing):
 	animSpeedScale(1.f),
+	poseCache(nullptr),
+	animLod(nullptr),
 	numVertices(0),
 	numIndices(0),
 	numBones(0),
@@ -22,11 +30,24 @@ Skinned::Skinned(VulkanState& vulkanState):
 	indexBufferOffset(0),
 	mNumSamplerDescriptors(0),
 	mState(vulkanState),
+	mUniformRing(uniformRing),
+	mPaletteRing(paletteRing),
 	mCommonBufferInfo(mState.device),
-	mCommonStagingBufferInfo(mState.device),
+	mPackedVertices(false),
+	mIndexType(VK_INDEX_TYPE_UINT32),
 	mPath(""),
 	mFolder(""),
-	mAnimNodeRoot(NULL)
+	mCacheable(false),
+	mScene(NULL),
+	mCursorAnimation(UINT32_MAX),
+	mSkeletonId(0),
+	mBakedPaletteInfo(mState.device),
+	mBakedDescriptorSet(VK_NULL_HANDLE),
+	mBounds(0.0f),
+	mVisible(true),
+	mLodInterval(1),
+	mLodFrame(0),
+	mLodValid(false)
 {
 
 
@@ -47,7 +68,22 @@ void Skinned::init(const char* modelPath, unsigned int pFlags, ModelFlags modelF
 	mPath = modelPath;
 	mFolder = FileManager::getFilePath(std::string(modelPath));
 	mModelFlags = modelFlags;
+	// matrix and dual quaternion palettes of a model are not interchangeable
+	mSkeletonId = (std::hash<std::string>()(mPath) * 31 + pFlags) * 2 + ((modelFlags & ModelFlag_dualQuaternion) ? 1 : 0);
 	LOG("FOLDER: %s", mFolder.c_str());
+
+	std::string cachePath = MeshCache::cachePath(mPath);
+	// baking, the bone format and vertex packing happen after the cache, every mode shares one
+	ModelFlags cacheFlags = modelFlags & ~(
+			ModelFlag_bakeAnimations | 
+			ModelFlag_dualQuaternion | 
+			ModelFlag_compressAnimations | 
+			ModelFlag_packedVertices);
+	mCacheable = MeshCache::makeKey(mPath, MeshCache::Kind_skinned, sizeof(Vertex), pFlags, cacheFlags, mCacheKey);
+	if (mCacheable && loadCache(cachePath))
+		return;
+
+	Assimp::Importer importer;
 #ifdef __ANDROID__
 	importer.SetIOHandler(FileManager::newAssimpIOSystem());
 #endif
@@ -62,6 +98,9 @@ void Skinned::init(const char* modelPath, unsigned int pFlags, ModelFlags modelF
 		throwError("No amations found");
 
 	processModel(*mScene);
+	// scene is released with the importer
+	mScene = NULL;
+	mNodeToBoneIndexMap.clear();
 }
 
 
@@ -71,8 +110,6 @@ void Skinned::processMeshVertices(std::vector<Vertex>& vertices, aiMesh& mesh, M
 	bool hasNormals = mesh.HasNormals();
 	bool hasTangentsAndBitangents = mesh.HasTangentsAndBitangents();
 	bool hasTexCoords = mesh.HasTextureCoords(0);
-	auto it = mMaterialIndexToMaterial.find(mesh.mMaterialIndex);
-	bool hasMaterial = it != mMaterialIndexToMaterial.end();
 	// Vertices
 	for (size_t j = 0; j < mesh.mNumVertices; ++j) {
 		Vertex& vertex = vertices[meshInfo.baseVertex + j];
@@ -88,11 +125,6 @@ void Skinned::processMeshVertices(std::vector<Vertex>& vertices, aiMesh& mesh, M
 
 		if (hasTexCoords) 
 			convertVector(mesh.mTextureCoords[0][j], vertex.texCoord);
-		if (hasMaterial) {
-			Material& material = it->second;
-			if (!material.diffuseIndices.empty())
-				vertex.samplerIndices[0] = material.diffuseIndices[0];
-		}
 	}
 }
 
@@ -100,7 +132,7 @@ void Skinned::processMeshIndices(std::vector<uint32_t>& indices, aiMesh& mesh, M
 {
 	for (size_t j = 0; j < mesh.mNumFaces; ++j) 
 		for (size_t k = 0; k < 3; ++k)
-			indices[meshInfo.baseIndex + 3 * j + k] = mesh.mFaces[j].mIndices[k] + meshInfo.baseIndex;
+			indices[meshInfo.baseIndex + 3 * j + k] = mesh.mFaces[j].mIndices[k] + meshInfo.baseVertex;
 }
 
 void Skinned::processMeshMaterials(aiMesh& mesh, Mesh& meshInfo) 
@@ -121,46 +153,33 @@ void Skinned::processMeshMaterials(aiMesh& mesh, Mesh& meshInfo)
 
 				material.GetTexture(textureType, k, &texturePath);
 				std::string fullTexturePath = mFolder + "/";
+				std::string relativePath;
 				if (mModelFlags & ModelFlag_stripFullPath)
-					fullTexturePath += FileManager::stripPath(std::string(texturePath.C_Str()));
+					relativePath = FileManager::stripPath(std::string(texturePath.C_Str()));
 				else
-					fullTexturePath += texturePath.C_Str();
+					relativePath = texturePath.C_Str();
+				fullTexturePath += relativePath;
 
 				TextureDesc textureDesc(fullTexturePath);
 				ImageInfo* imageInfo = TextureManager::load(
 						mState, 
-						mState.commandPool, 
-						mState.graphicsQueue, 
 						textureDesc);
 				uint32_t index = numSamplers;
-				bool textureSupported = true;
-
-				switch(textureType) {
-					case aiTextureType_DIFFUSE: 
-						materialInfo.diffuseIndices.push_back(index);
-						break;
-					case aiTextureType_SPECULAR: 
-						materialInfo.specularIndices.push_back(index);
-						break;
-					case aiTextureType_HEIGHT: 
-						materialInfo.heightIndices.push_back(index);
-						break;
-					case aiTextureType_AMBIENT:
-						materialInfo.ambientIndices.push_back(index);
-						break;
-					default:
-						textureSupported = false;
-						break;
-				}
+				bool textureSupported = 
+					textureType == aiTextureType_DIFFUSE ||
+					textureType == aiTextureType_SPECULAR ||
+					textureType == aiTextureType_HEIGHT ||
+					textureType == aiTextureType_AMBIENT;
 
 				if (textureSupported) {
 					if (index >= SAMPLER_LIST_SIZE) 
 						throwError("SAMPLER OVERFLOW: Add support for model with more textures and sampler");
-					materialInfo.textures.push_back(MaterialTexture());
-					auto& texture = materialInfo.textures.back();
+					MaterialTexture texture;
 					texture.type = textureType;
 					texture.image = imageInfo;
 					texture.index = index;
+					texture.path = relativePath;
+					addMaterialTexture(materialInfo, texture);
 					++numSamplers;
 				}
 			}
@@ -192,7 +211,7 @@ void Skinned::processMeshBones(
 		if (it == boneNameToIndexMap.end()) {
 			boneIndex = numBones++;
 			boneNameToIndexMap[name] = boneIndex; 
-			mBoneTransforms[boneIndex] = bone->mOffsetMatrix;
+			mSkeleton.boneOffsets[boneIndex] = convertMatrix(bone->mOffsetMatrix);
 		} else {
 			boneIndex = it->second;
 		}
@@ -232,55 +251,47 @@ void Skinned::processMeshBones(
 }
 
 
-void Skinned::createAnimNode(aiNode* node, AnimNode* parent)
+void Skinned::createSkeletonNode(aiNode* node, int32_t parent, std::vector<std::vector<AnimChannel>>& channels)
 {
     auto it = mNodeToBoneIndexMap.find(node);
     if (it == mNodeToBoneIndexMap.end()) 
 		return;
-	AnimNode* animNode = new AnimNode(*node);
-
-	if (parent) 
-		parent->mChildren.push_back(animNode);
-	else 
-		mAnimNodeRoot = animNode;
-	
-	if (it->second != BONE_INDEX_UNSET)
-		animNode->boneIndex = it->second;
-
-	animNode->mAnimTypes.reserve(mScene->mNumAnimations);
+	int32_t index = (int32_t) mSkeleton.addNode(parent, it->second, convertMatrix(node->mTransformation));
 
+	channels.push_back(std::vector<AnimChannel>(mScene->mNumAnimations));
 	for (size_t i = 0; i < mScene->mNumAnimations; ++i) {
 		aiAnimation* anim = mScene->mAnimations[i];
-		bool hasAnim = false;
 		if (anim->mTicksPerSecond <= 0.0)
-			anim->mTicksPerSecond = AnimNode::DEFAULT_TICKS_PER_SECOND; 
+			anim->mTicksPerSecond = AnimClip::DEFAULT_TICKS_PER_SECOND; 
 	   
 		if (anim->mDuration <= 0.0)
-			anim->mDuration = AnimNode::DEFAULT_TICKS_DURATION;
+			anim->mDuration = AnimClip::DEFAULT_TICKS_DURATION;
 
 		for (size_t j = 0; j < anim->mNumChannels; ++j) {
 			aiNodeAnim* channel = anim->mChannels[j];
 			if (std::string(channel->mNodeName.C_Str()) == std::string(node->mName.C_Str())) {
-				hasAnim = true;
-				animNode->mAnimTypes.push_back(channel);
+				AnimChannel& animChannel = channels[index][i];
+				animChannel.animated = true;
+				animChannel.positionKeys.assign(channel->mPositionKeys, channel->mPositionKeys + channel->mNumPositionKeys);
+				animChannel.rotationKeys.assign(channel->mRotationKeys, channel->mRotationKeys + channel->mNumRotationKeys);
+				animChannel.scalingKeys.assign(channel->mScalingKeys, channel->mScalingKeys + channel->mNumScalingKeys);
 				break;
 			}
 		}
-   
-		if (!hasAnim)
-			animNode->mAnimTypes.push_back(NULL);
 	} 
 	
 	for (size_t i = 0; i < node->mNumChildren; ++i)
-		createAnimNode(node->mChildren[i], animNode);
+		createSkeletonNode(node->mChildren[i], index, channels);
 }
 
 
 
 void Skinned::processModel(const aiScene& scene) 
 {
-    mModelSpaceTransform = mScene->mRootNode->mTransformation;
-    mModelSpaceTransform.Inverse();
+    aiMatrix4x4 modelSpaceTransform = mScene->mRootNode->mTransformation;
+    modelSpaceTransform.Inverse();
+    mSkeleton.clear();
+    mSkeleton.modelSpaceTransform = convertMatrix(modelSpaceTransform);
 
 	mMeshes.resize(scene.mNumMeshes);
 
@@ -309,7 +320,7 @@ void Skinned::processModel(const aiScene& scene)
 	std::vector<Vertex> vertices(numVertices);
 	std::vector<uint32_t> vertexBoneIndices(numVertices);
 	std::vector<uint32_t> indices(numIndices);
-	mBoneTransforms.resize(baseBone);
+	mSkeleton.boneOffsets.resize(baseBone);
 	std::unordered_map<std::string, uint32_t> boneNameToIndexMap;
 
 	std::stack<aiNode*> s;
@@ -331,84 +342,396 @@ void Skinned::processModel(const aiScene& scene)
         for (size_t i = 0; i < n->mNumChildren; ++i)
             s.push(n->mChildren[i]);
 	}
+	// meshes share bones, palettes only hold the unique ones
+	mSkeleton.boneOffsets.resize(numBones);
+
+	// after the bones, vertices are welded and move with their weights
+	size_t vertexStride = packsVertices() ? sizeof(PackedVertex) : sizeof(Vertex);
+	MeshOptimizer::optimizeMeshes(vertices, indices, mMeshes, weldKey, vertexStride, mState.taskManager, mPath.c_str());
+
+	// flatten animated nodes, channels by node and animation
+	std::vector<std::vector<AnimChannel>> channels;
+	createSkeletonNode(mScene->mRootNode, -1, channels);
+
+	// createSkeletonNode fixes up missing timings
+	mAnimations.resize(mScene->mNumAnimations);
+	for (size_t i = 0; i < mScene->mNumAnimations; ++i) {
+		mAnimations[i].ticksPerSecond = mScene->mAnimations[i]->mTicksPerSecond;
+		mAnimations[i].duration = mScene->mAnimations[i]->mDuration;
+	}
+
+	if (mCacheable)
+		saveCache(MeshCache::cachePath(mPath), vertices, indices, channels);
+	compileClips(channels);
+	if (mModelFlags & ModelFlag_bakeAnimations)
+		bakeClips();
 
-	// create animated nodes tree
-	createAnimNode(mScene->mRootNode, NULL);
 	createCommonBuffer(vertices, indices);
 	createDescriptorPool();
 	createDescriptorSet();
 }
 
-void Skinned::processAnimNode(float progress, aiMatrix4x4& parentTransform, AnimNode* animNode, uint32_t animationIndex)
+Skinned::Vertex Skinned::weldKey(const Vertex& vertex)
 {
-  //  LOG("INDEX:" << animNode->boneIndex << "ANIM PROCESS:" << progress << " RELATED " << animNode->hasRelatedBone()); 
-    aiMatrix4x4 animTransform = animNode->getAnimatedTransform(progress, animationIndex);
-    aiMatrix4x4 currTransform = parentTransform * animTransform;
+	// only vertices with the same influences merge, bone indices are kept exact
+	Vertex key = MeshOptimizer::surfaceKey(vertex);
+	key.weights = MeshOptimizer::quantize(vertex.weights, MeshOptimizer::DEFAULT_WELD_EPSILON);
+	return key;
+}
 
-    if (animNode->boneIndex < MAX_BONES) {
-        // update bone
-        aiMatrix4x4 animatedTransform = mModelSpaceTransform * currTransform * mBoneTransforms[animNode->boneIndex];
-        // change row-order, since assimp is uses directx matrices row order
-		ubo.bones[animNode->boneIndex] = glm::transpose(glm::make_mat4(&animatedTransform.a1));
-    }
+void Skinned::addMaterialTexture(Material& material, const MaterialTexture& texture)
+{
+	switch(texture.type) {
+		case aiTextureType_DIFFUSE: 
+			material.diffuseIndices.push_back(texture.index);
+			break;
+		case aiTextureType_SPECULAR: 
+			material.specularIndices.push_back(texture.index);
+			break;
+		case aiTextureType_HEIGHT: 
+			material.heightIndices.push_back(texture.index);
+			break;
+		case aiTextureType_AMBIENT:
+			material.ambientIndices.push_back(texture.index);
+			break;
+		default:
+			return;
+	}
+	material.textures.push_back(texture);
+}
+
+void Skinned::saveCache(
+		const std::string& cachePath, 
+		const std::vector<Vertex>& vertices, 
+		const std::vector<uint32_t>& indices,
+		const std::vector<std::vector<AnimChannel>>& channels)
+{
+	MeshCacheWriter writer;
+	writer.writeArray(MeshCache::Section_vertices, vertices.data(), vertices.size());
+	writer.writeArray(MeshCache::Section_indices, indices.data(), indices.size());
+
+	writer.write(MeshCache::Section_meshes, (uint32_t) mMeshes.size());
+	writer.writeArray(MeshCache::Section_meshes, mMeshes.data(), mMeshes.size());
+
+	writer.write(MeshCache::Section_materials, numSamplers);
+	writer.write(MeshCache::Section_materials, (uint32_t) mMaterialIndexToMaterial.size());
+	for (const auto& materialPair : mMaterialIndexToMaterial) {
+		const Material& material = materialPair.second;
+		writer.write(MeshCache::Section_materials, materialPair.first);
+		writer.write(MeshCache::Section_materials, (uint32_t) material.textures.size());
+		for (const MaterialTexture& texture : material.textures) {
+			writer.write(MeshCache::Section_materials, (uint32_t) texture.type);
+			writer.write(MeshCache::Section_materials, texture.index);
+			writer.writeString(MeshCache::Section_materials, texture.path);
+		}
+	}
 
-    for (size_t i = 0; i < animNode->mChildren.size(); ++i)         
-        processAnimNode(progress, currTransform, animNode->mChildren[i] , animationIndex);
+	// nodes depth first, a parent is always written before its children
+	writer.write(MeshCache::Section_skeleton, numBones);
+	writer.write(MeshCache::Section_skeleton, mSkeleton.modelSpaceTransform);
+	writer.write(MeshCache::Section_skeleton, (uint32_t) mSkeleton.boneOffsets.size());
+	writer.writeArray(MeshCache::Section_skeleton, mSkeleton.boneOffsets.data(), mSkeleton.boneOffsets.size());
+	writer.write(MeshCache::Section_skeleton, mSkeleton.numNodes());
+	writer.writeArray(MeshCache::Section_skeleton, mSkeleton.parents.data(), mSkeleton.numNodes());
+	writer.writeArray(MeshCache::Section_skeleton, mSkeleton.boneIndices.data(), mSkeleton.numNodes());
+	writer.writeArray(MeshCache::Section_skeleton, mSkeleton.transformations.data(), mSkeleton.numNodes());
+
+	writer.write(MeshCache::Section_animations, (uint32_t) mAnimations.size());
+	writer.writeArray(MeshCache::Section_animations, mAnimations.data(), mAnimations.size());
+	for (const auto& nodeChannels : channels) {
+		for (const AnimChannel& channel : nodeChannels) {
+			writer.write(MeshCache::Section_animations, (uint32_t) channel.animated);
+			writer.write(MeshCache::Section_animations, (uint32_t) channel.positionKeys.size());
+			writer.write(MeshCache::Section_animations, (uint32_t) channel.rotationKeys.size());
+			writer.write(MeshCache::Section_animations, (uint32_t) channel.scalingKeys.size());
+			writer.writeArray(MeshCache::Section_animations, channel.positionKeys.data(), channel.positionKeys.size());
+			writer.writeArray(MeshCache::Section_animations, channel.rotationKeys.data(), channel.rotationKeys.size());
+			writer.writeArray(MeshCache::Section_animations, channel.scalingKeys.data(), channel.scalingKeys.size());
+		}
+	}
+	writer.save(cachePath, mCacheKey);
+}
+
+bool Skinned::loadCache(const std::string& cachePath)
+{
+	MeshCacheReader reader;
+	if (!reader.open(cachePath, mCacheKey))
+		return false;
+
+	size_t verticesSize, indicesSize;
+	const char* vertices = reader.section(MeshCache::Section_vertices, verticesSize);
+	const char* indices = reader.section(MeshCache::Section_indices, indicesSize);
+	std::vector<std::vector<AnimChannel>> channels;
+
+	try {
+		MeshCacheStream meshes = reader.stream(MeshCache::Section_meshes);
+		meshes.readArray(mMeshes, meshes.read<uint32_t>());
+		// draws index the cached buffers directly
+		uint64_t vertexCount = verticesSize / sizeof(Vertex), indexCount = indicesSize / sizeof(uint32_t);
+		if (vertexCount == 0 || indexCount == 0)
+			throw std::runtime_error("Mesh buffers missing");
+		for (const Mesh& mesh : mMeshes) {
+			if ((uint64_t) mesh.baseVertex + mesh.numVertices > vertexCount)
+				throw std::runtime_error("Mesh vertices out of range");
+			if ((uint64_t) mesh.baseIndex + mesh.numIndices > indexCount)
+				throw std::runtime_error("Mesh indices out of range");
+		}
+
+		MeshCacheStream materials = reader.stream(MeshCache::Section_materials);
+		numSamplers = materials.read<uint32_t>();
+		uint32_t numMaterials = materials.read<uint32_t>();
+		for (uint32_t i = 0; i < numMaterials; ++i) {
+			uint32_t materialIndex = materials.read<uint32_t>();
+			uint32_t numTextures = materials.read<uint32_t>();
+			Material materialInfo;
+			for (uint32_t j = 0; j < numTextures; ++j) {
+				MaterialTexture texture;
+				texture.type = (aiTextureType) materials.read<uint32_t>();
+				texture.index = materials.read<uint32_t>();
+				texture.path = materials.readString();
+				if (texture.index >= SAMPLER_LIST_SIZE)
+					throw std::runtime_error("Sampler index out of range");
+				texture.image = TextureManager::load(mState, TextureDesc(mFolder + "/" + texture.path));
+				addMaterialTexture(materialInfo, texture);
+			}
+			mMaterialIndexToMaterial[materialIndex] = materialInfo;
+		}
+
+		MeshCacheStream skeleton = reader.stream(MeshCache::Section_skeleton);
+		numBones = skeleton.read<uint32_t>();
+		mSkeleton.modelSpaceTransform = skeleton.read<glm::mat4>();
+		skeleton.readArray(mSkeleton.boneOffsets, skeleton.read<uint32_t>());
+		if (mSkeleton.boneOffsets.size() != numBones)
+			throw std::runtime_error("Bone offset count mismatch");
+		uint32_t numNodes = skeleton.read<uint32_t>();
+		skeleton.readArray(mSkeleton.parents, numNodes);
+		skeleton.readArray(mSkeleton.boneIndices, numNodes);
+		skeleton.readArray(mSkeleton.transformations, numNodes);
+		for (uint32_t i = 0; i < numNodes; ++i) {
+			int32_t parent = mSkeleton.parents[i];
+			if (parent >= (int32_t) i || (parent < 0 && i > 0))
+				throw std::runtime_error("Node parent out of order");
+			uint32_t bone = mSkeleton.boneIndices[i];
+			if (bone != BONE_INDEX_UNSET && bone >= mSkeleton.boneOffsets.size())
+				throw std::runtime_error("Bone index out of range");
+		}
+
+		MeshCacheStream animations = reader.stream(MeshCache::Section_animations);
+		animations.readArray(mAnimations, animations.read<uint32_t>());
+		channels.resize(numNodes);
+		for (auto& nodeChannels : channels) {
+			nodeChannels.resize(mAnimations.size());
+			for (AnimChannel& channel : nodeChannels) {
+				channel.animated = animations.read<uint32_t>() != 0;
+				uint32_t numPositionKeys = animations.read<uint32_t>();
+				uint32_t numRotationKeys = animations.read<uint32_t>();
+				uint32_t numScalingKeys = animations.read<uint32_t>();
+				animations.readArray(channel.positionKeys, numPositionKeys);
+				animations.readArray(channel.rotationKeys, numRotationKeys);
+				animations.readArray(channel.scalingKeys, numScalingKeys);
+			}
+		}
+	} catch (const std::runtime_error& e) {
+		LOG("MESH CACHE CORRUPT %s: %s", cachePath.c_str(), e.what());
+		mMeshes.clear();
+		mMaterialIndexToMaterial.clear();
+		mSkeleton.clear();
+		mAnimations.clear();
+		numSamplers = numBones = 0;
+		return false;
+	}
+	compileClips(channels);
+	if (mModelFlags & ModelFlag_bakeAnimations)
+		bakeClips();
+
+	// uploads copy out of the mapping, it is released on return
+	createCommonBuffer(
+			(const Vertex*) vertices, 
+			(uint32_t) (verticesSize / sizeof(Vertex)), 
+			(const uint32_t*) indices, 
+			(uint32_t) (indicesSize / sizeof(uint32_t)));
+	createDescriptorPool();
+	createDescriptorSet();
+	LOG("MESH CACHE LOADED: %s", cachePath.c_str());
+	return true;
+}
+
+void Skinned::compileClips(const std::vector<std::vector<AnimChannel>>& channels)
+{
+	std::vector<const AnimChannel*> animChannels(channels.size());
+	mClips.resize(mAnimations.size());
+	for (size_t i = 0; i < mAnimations.size(); ++i) {
+		for (size_t node = 0; node < channels.size(); ++node)
+			animChannels[node] = &channels[node][i];
+		if (!(mModelFlags & ModelFlag_compressAnimations)) {
+			mClips[i].compile(animChannels, mAnimations[i].ticksPerSecond, mAnimations[i].duration);
+			continue;
+		}
+		mClips[i].compileCompressed(animChannels, mAnimations[i].ticksPerSecond, mAnimations[i].duration, AnimClip::Compression());
+		const AnimClip::Stats& stats = mClips[i].stats();
+		LOG("CLIP COMPRESSED %s #%zu keys: %u -> %u bytes: %zu -> %zu max error position: %f rotation: %f scale: %f",
+				mPath.c_str(), i,
+				stats.rawKeys, stats.keys,
+				stats.rawBytes, stats.bytes,
+				stats.maxPositionError, stats.maxRotationError, stats.maxScaleError);
+	}
+	mCursorAnimation = UINT32_MAX;
+}
+
+void Skinned::bakeClips()
+{
+	uint32_t bonesPerFrame = (uint32_t) mSkeleton.boneOffsets.size();
+	if (bonesPerFrame == 0 || mClips.empty())
+		return;
+
+	mBakedClips.resize(mClips.size());
+	uint32_t numFrames = 0;
+	for (size_t i = 0; i < mClips.size(); ++i) {
+		const AnimClip& clip = mClips[i];
+		double seconds = clip.duration() / clip.ticksPerSecond();
+		// one frame past the end, so the last interval blends into the final keys
+		mBakedClips[i].baseFrame = numFrames;
+		mBakedClips[i].numFrames = (uint32_t) std::ceil(seconds * BAKE_FRAMES_PER_SECOND) + 1;
+		numFrames += mBakedClips[i].numFrames;
+	}
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(mState.physicalDevice, &properties);
+	VkDeviceSize size = (VkDeviceSize) numFrames * bonesPerFrame * sizeof(BakedBone);
+	if (size > properties.limits.maxStorageBufferRange)
+		throwError("Baked animations exceed the storage buffer range");
+
+	std::vector<BakedBone> bones((size_t) numFrames * bonesPerFrame);
+	std::vector<glm::mat4> palette(bonesPerFrame);
+	AnimClip::Cursor cursor;
+	for (size_t i = 0; i < mClips.size(); ++i) {
+		const AnimClip& clip = mClips[i];
+		const BakedClip& baked = mBakedClips[i];
+		clip.resetCursor(cursor);
+		for (uint32_t frame = 0; frame < baked.numFrames; ++frame) {
+			double ticks = std::min(frame * clip.ticksPerSecond() / BAKE_FRAMES_PER_SECOND, clip.duration());
+			std::fill(palette.begin(), palette.end(), glm::mat4(1.0f));
+			mSkeleton.computePalette(clip, (float) ticks, cursor, palette.data(), bonesPerFrame);
+
+			BakedBone* frameBones = &bones[(size_t) (baked.baseFrame + frame) * bonesPerFrame];
+			for (uint32_t bone = 0; bone < bonesPerFrame; ++bone) {
+				glm::mat4 rows = glm::transpose(palette[bone]);
+				for (uint32_t r = 0; r < 3; ++r)
+					frameBones[bone].rows[r] = rows[r];
+			}
+		}
+		LOG("BAKED CLIP %zu of %s: %u frames x %u bones, %zu KB", 
+				i, mPath.c_str(), baked.numFrames, bonesPerFrame, 
+				(size_t) baked.numFrames * bonesPerFrame * sizeof(BakedBone) / 1024);
+	}
+
+	mBakedPaletteInfo.size = size;
+	BufferHelper::createStorageBuffer(mState, mBakedPaletteInfo);
+	mState.uploadManager->uploadBuffer(mBakedPaletteInfo.buffer, 0, bones.data(), size);
+	LOG("BAKED PALETTES of %s: %zu clips, %zu KB", mPath.c_str(), mBakedClips.size(), (size_t) (size / 1024));
 }
 
 void Skinned::createCommonBuffer(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
 {
-	numVertices = vertices.size();
-	numIndices = indices.size();
+	createCommonBuffer(vertices.data(), vertices.size(), indices.data(), indices.size());
+}
 
-	VkDeviceSize uniformBufferSize = sizeof(UBO);
-	VkDeviceSize vertexBufferSize = sizeof(vertices[0]) * numVertices;
-	VkDeviceSize indexBufferSize = sizeof(indices[0]) * numIndices;
-	
-	uniformBufferOffset = 0;
-	vertexBufferOffset = uniformBufferSize;
-	indexBufferOffset = vertexBufferOffset + vertexBufferSize;
+void Skinned::createCommonBuffer(const Vertex* vertices, uint32_t numVertices, const uint32_t* indices, uint32_t numIndices)
+{
+	this->numVertices = numVertices;
+	this->numIndices = numIndices;
+
+	if (numVertices > 0) {
+		glm::vec3 minPos = vertices[0].pos, maxPos = vertices[0].pos;
+		for (uint32_t i = 1; i < numVertices; ++i) {
+			minPos = glm::min(minPos, vertices[i].pos);
+			maxPos = glm::max(maxPos, vertices[i].pos);
+		}
+		glm::vec3 center = 0.5f * (minPos + maxPos);
+		mBounds = glm::vec4(center, BOUNDS_MARGIN * glm::length(maxPos - center));
+	}
+
+	// the cache keeps float vertices, they are packed on the way to the GPU
+	std::vector<PackedVertex> packedVertices;
+	mPackedVertices = packsVertices();
+	if ((mModelFlags & ModelFlag_packedVertices) && !mPackedVertices)
+		LOG("%s has %u bones, vertices stay unpacked", mPath.c_str(), numBones);
+	if (mPackedVertices) {
+		packedVertices.resize(numVertices);
+		for (uint32_t i = 0; i < numVertices; ++i) {
+			const Vertex& vertex = vertices[i];
+			PackedVertex& packed = packedVertices[i];
+			packed.pos = vertex.pos;
+			VertexPacking::packTangentFrame(vertex.normal, vertex.tangent, vertex.bitangent, packed.tangentFrame);
+			VertexPacking::packHalf2(vertex.texCoord, packed.texCoord);
+			for (uint32_t j = 0; j < MAX_BONES_PER_VERTEX; ++j)
+				packed.boneIndices[j] = (uint8_t) vertex.boneIndices[j];
+			VertexPacking::packWeights(vertex.weights, packed.weights);
+		}
+	}
+
+	// 16 bit indices relative to the first vertex of their mesh when every mesh
+	// fits, draws add the first vertex back
+	std::vector<uint16_t> packedIndices(numIndices);
+	mIndexType = VK_INDEX_TYPE_UINT16;
+	for (const Mesh& mesh : mMeshes) {
+		bool packed = mesh.baseIndex + mesh.numIndices <= numIndices && VertexPacking::packIndices16(
+				indices + mesh.baseIndex, 
+				mesh.numIndices, 
+				mesh.baseVertex, 
+				mesh.numVertices, 
+				packedIndices.data() + mesh.baseIndex);
+		if (!packed) {
+			mIndexType = VK_INDEX_TYPE_UINT32;
+			break;
+		}
+	}
 
-	mCommonBufferInfo.size = vertexBufferSize + indexBufferSize + uniformBufferSize;
-	mCommonStagingBufferInfo.size = mCommonBufferInfo.size;
-	BufferHelper::createStagingBuffer(mState, mCommonStagingBufferInfo);
+	VkDeviceSize vertexBufferSize = (VkDeviceSize) vertexStride() * numVertices;
+	VkDeviceSize indexBufferSize = (VkDeviceSize) indexSize() * numIndices;
 	
-	char* data;
-	vkMapMemory(mState.device, mCommonStagingBufferInfo.memory, 0, mCommonStagingBufferInfo.size, 0, (void**) &data);
-	memcpy(data + uniformBufferOffset, &ubo, uniformBufferSize);
-	memcpy(data + vertexBufferOffset, vertices.data(), vertexBufferSize);
-	memcpy(data + indexBufferOffset, indices.data(), indexBufferSize);
-	vkUnmapMemory(mState.device, mCommonStagingBufferInfo.memory);
+	// uniforms are written to the uniform ring every frame
+	vertexBufferOffset = 0;
+	indexBufferOffset = vertexBufferOffset + vertexBufferSize;
 
+	mCommonBufferInfo.size = vertexBufferSize + indexBufferSize;
 	BufferHelper::createCommonBuffer(mState, mCommonBufferInfo);
 
-	BufferHelper::copyBuffer(
-			mState,
-			mCommonStagingBufferInfo.buffer, 
-			mCommonBufferInfo.buffer, 
-			mCommonBufferInfo.size);
+	const void* vertexData = mPackedVertices ? (const void*) packedVertices.data() : (const void*) vertices;
+	mState.uploadManager->uploadBuffer(mCommonBufferInfo.buffer, vertexBufferOffset, vertexData, vertexBufferSize);
+	const void* indexData = mIndexType == VK_INDEX_TYPE_UINT16 ? (const void*) packedIndices.data() : (const void*) indices;
+	mState.uploadManager->uploadBuffer(mCommonBufferInfo.buffer, indexBufferOffset, indexData, indexBufferSize);
+	LOG("VERTICES of %s: %u, %u bytes each (%zu unpacked), %zu KB", 
+			mPath.c_str(), numVertices, vertexStride(), sizeof(Vertex), (size_t) (vertexBufferSize / 1024));
+	LOG("INDICES of %s: %u, %u bytes each, %zu KB", 
+			mPath.c_str(), numIndices, indexSize(), (size_t) (indexBufferSize / 1024));
 }
 
 void Skinned::createDescriptorPool() 
 {
 	VkDescriptorPoolSize uboSize = {};
-	uboSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	uboSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	uboSize.descriptorCount = SAMPLER_LIST_SIZE + 1;
 	
 	VkDescriptorPoolSize samplerSize = {};
 	samplerSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	samplerSize.descriptorCount = SAMPLER_LIST_SIZE + 1;
 
+	VkDescriptorPoolSize storageSize = {};
+	storageSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	storageSize.descriptorCount = 1;
+
 	VkDescriptorPoolSize poolSizes[] = {
 		uboSize,
-		samplerSize
+		samplerSize,
+		storageSize
 	};
 	
 	VkDescriptorPoolCreateInfo poolInfo = {};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	poolInfo.poolSizeCount = ARRAY_SIZE(poolSizes);
 	poolInfo.pPoolSizes = poolSizes;
-	poolInfo.maxSets = SAMPLER_LIST_SIZE + 1;
+	poolInfo.maxSets = SAMPLER_LIST_SIZE + 2;
 	
 	LOG("NUM SAMPLERS: %u, materials: %zu", numSamplers, mMaterialIndexToMaterial.size());
 	LOG("MAX SETS: %u", poolInfo.maxSets);
@@ -427,16 +750,16 @@ void Skinned::createDescriptorSet()
 	VK_CHECK_RESULT(vkAllocateDescriptorSets(mState.device, &allocInfo, &mUniformDescriptorSet));
 	
 	VkDescriptorBufferInfo buffInfo = {};
-	buffInfo.buffer = mCommonBufferInfo.buffer;
-	buffInfo.offset = uniformBufferOffset;
-	buffInfo.range = sizeof(UBO);
+	buffInfo.buffer = mUniformRing.buffer();
+	buffInfo.offset = 0;
+	buffInfo.range = isBaked() ? sizeof(BakedUBO) : sizeof(UBO);
 
 	VkWriteDescriptorSet uniformWriteSet = {};
 	uniformWriteSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 	uniformWriteSet.dstSet = mUniformDescriptorSet;
 	uniformWriteSet.dstBinding = 0;
 	uniformWriteSet.dstArrayElement = 0;
-	uniformWriteSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	uniformWriteSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	uniformWriteSet.descriptorCount = 1;
 	uniformWriteSet.pBufferInfo = &buffInfo;
 
@@ -475,22 +798,62 @@ void Skinned::createDescriptorSet()
 	};
 
 	vkUpdateDescriptorSets(mState.device, ARRAY_SIZE(writeSets), writeSets, 0, nullptr);
+
+	mMeshSamplerIndices.assign(mMeshes.size(), 0);
+	for (size_t i = 0; i < mMeshes.size(); ++i) {
+		auto it = mMaterialIndexToMaterial.find(mMeshes[i].materialIndex);
+		if (it != mMaterialIndexToMaterial.end() && !it->second.diffuseIndices.empty())
+			mMeshSamplerIndices[i] = it->second.diffuseIndices[0];
+	}
+
+	if (!isBaked())
+		return;
+
+	VkDescriptorSetAllocateInfo storageAllocInfo = {};
+	storageAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	storageAllocInfo.descriptorPool = mDescriptorPool;
+	storageAllocInfo.descriptorSetCount = 1;
+	storageAllocInfo.pSetLayouts = &mState.descriptorSetLayouts.storage;
+
+	VK_CHECK_RESULT(vkAllocateDescriptorSets(mState.device, &storageAllocInfo, &mBakedDescriptorSet));
+
+	VkDescriptorBufferInfo paletteInfo = {};
+	paletteInfo.buffer = mBakedPaletteInfo.buffer;
+	paletteInfo.offset = 0;
+	paletteInfo.range = mBakedPaletteInfo.size;
+
+	VkWriteDescriptorSet paletteWriteSet = {};
+	paletteWriteSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	paletteWriteSet.dstSet = mBakedDescriptorSet;
+	paletteWriteSet.dstBinding = 0;
+	paletteWriteSet.dstArrayElement = 0;
+	paletteWriteSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	paletteWriteSet.descriptorCount = 1;
+	paletteWriteSet.pBufferInfo = &paletteInfo;
+
+	vkUpdateDescriptorSets(mState.device, 1, &paletteWriteSet, 0, nullptr);
 }
 
 void Skinned::draw(VkCommandBuffer& commandBuffer, VkPipeline& pipeline, VkPipelineLayout& pipelineLayout)
 {
+	if (!mVisible)
+		return;
+
 	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 	
 	VkDeviceSize offset = vertexBufferOffset;
 	VkBuffer& commonBuff = mCommonBufferInfo.buffer;
 	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &commonBuff, &offset);
-	vkCmdBindIndexBuffer(commandBuffer, mCommonBufferInfo.buffer, indexBufferOffset, VK_INDEX_TYPE_UINT32);
+	vkCmdBindIndexBuffer(commandBuffer, mCommonBufferInfo.buffer, indexBufferOffset, mIndexType);
 
+	// instances animated every frame share the palette ring set
 	VkDescriptorSet sets[] = {
 		mUniformDescriptorSet,
-		mSamplersDescriptorSet
+		mSamplersDescriptorSet,
+		isBaked() ? mBakedDescriptorSet : mPaletteRing.descriptorSet()
 	};
 
+	uint32_t dynamicOffset = (uint32_t) uniformBufferOffset;
 	vkCmdBindDescriptorSets(
 		commandBuffer, 
 		VK_PIPELINE_BIND_POINT_GRAPHICS, 
@@ -498,33 +861,189 @@ void Skinned::draw(VkCommandBuffer& commandBuffer, VkPipeline& pipeline, VkPipel
 		0, 
 		ARRAY_SIZE(sets), 
 		sets, 
-		0, 
-		nullptr);
+		1, 
+		&dynamicOffset);
+
+	for (size_t i = 0; i < mMeshes.size(); ++i) {
+		const Mesh& mesh = mMeshes[i];
+		PushConstants pushConstants;
+		pushConstants.samplerIndex = mMeshSamplerIndices[i];
+		vkCmdPushConstants(
+			commandBuffer, 
+			pipelineLayout, 
+			VK_SHADER_STAGE_FRAGMENT_BIT, 
+			0, 
+			sizeof(PushConstants), 
+			&pushConstants);
+		int32_t vertexOffset = mIndexType == VK_INDEX_TYPE_UINT16 ? (int32_t) mesh.baseVertex : 0;
+		vkCmdDrawIndexed(commandBuffer, mesh.numIndices, 1, mesh.baseIndex, vertexOffset, 0);
+	}
+}
 
-	vkCmdDrawIndexed(commandBuffer, numIndices, 1, 0, 0, 0);
+void Skinned::update(const Timer& timer, Camera& camera, uint32_t animationIndex /* = 0 */)
+{
+    animate(timer, camera, animationIndex);
+    writeUniforms(camera);
 }
 
-void Skinned::update(VkCommandBuffer& cmdBuffer, const Timer& timer, Camera& camera, uint32_t animationIndex /* = 0 */)
+void Skinned::animate(const Timer& timer, Camera& camera, uint32_t animationIndex /* = 0 */)
 {
-    if (animationIndex >= mScene->mNumAnimations) {
+    if (animationIndex >= mClips.size()) {
         LOG("ERROR: WRONG ANIMATION INDEX: %u", animationIndex);
+        mVisible = false;
+        return;
+    }
+
+    uint32_t updateInterval = 1;
+    mVisible = updateVisibility(camera, updateInterval);
+    if (!mVisible)
+        return;
+
+    const AnimClip& clip = mClips[animationIndex];
+    if (isBaked()) {
+        // the vertex shader samples the palette, nothing to evaluate here
+        const BakedClip& baked = mBakedClips[animationIndex];
+        double seconds = fmod(animSpeedScale * timer.total(), clip.duration() / clip.ticksPerSecond());
+        mBakedUbo.time = glm::vec4((float) (seconds * BAKE_FRAMES_PER_SECOND), 0.0f, 0.0f, 0.0f);
+        mBakedUbo.clip = glm::uvec4(baked.baseFrame, baked.numFrames, (uint32_t) mSkeleton.boneOffsets.size(), 0);
+        return;
+    }
+
+    if (mCursorAnimation != animationIndex) {
+        clip.resetCursor(mCursor);
+        mCursorAnimation = animationIndex;
+        mLodValid = false;
+    }
+
+    float progress = animSpeedScale * timer.total() * clip.ticksPerSecond();
+    progress = fmod(progress, clip.duration());
+
+    if (updateInterval <= 1) {
+        mLodValid = false;
+        ubo.palette.x = writePalette(clip, animationIndex, progress);
         return;
     }
 
-    aiMatrix4x4 initialTransform;
-    float progress = animSpeedScale * timer.total() * mScene->mAnimations[animationIndex]->mTicksPerSecond;
-    progress = fmod(progress, mScene->mAnimations[animationIndex]->mDuration);
-    processAnimNode(progress, initialTransform, mAnimNodeRoot, animationIndex);
+    // evaluated every updateInterval frames, the frames in between blend
+    // toward the latest evaluation, the pose lags by up to an interval.
+    // Blends are per instance, they bypass the pose cache
+    uint32_t numPaletteBones = (uint32_t) mSkeleton.boneOffsets.size();
+    if (!mLodValid || ++mLodFrame >= mLodInterval) {
+        mPrevPalette.swap(mNextPalette);
+        mNextPalette.resize(numPaletteBones);
+        evaluatePalette(clip, progress, mNextPalette.data());
+        if (!mLodValid)
+            mPrevPalette = mNextPalette;
+        mLodInterval = updateInterval;
+        mLodFrame = 0;
+        mLodValid = true;
+    } else if (animLod) {
+        animLod->addInterpolated();
+    }
+
+    glm::vec4* paletteData;
+    glm::mat4* palette = allocatePalette(paletteData);
+    float t = (float) (mLodFrame + 1) / mLodInterval;
+    for (uint32_t i = 0; i < numPaletteBones; ++i)
+        palette[i] = mPrevPalette[i] + (mNextPalette[i] - mPrevPalette[i]) * t;
+    finishPalette(palette, paletteData);
+}
+
+glm::mat4* Skinned::allocatePalette(glm::vec4*& paletteData)
+{
+    uint32_t numPaletteBones = (uint32_t) mSkeleton.boneOffsets.size();
+    bool dualQuat = isDualQuat();
+    ubo.palette.x = mPaletteRing.allocate((dualQuat ? 2 : 4) * numPaletteBones, &paletteData);
+    // matrices go straight to the ring, a mat4 is its four columns,
+    // dual quaternions are converted from the scratch of the thread
+    if (!dualQuat)
+        return (glm::mat4*) paletteData;
+    std::vector<glm::mat4>& scratch = PoseScratch::local().palette;
+    scratch.resize(numPaletteBones);
+    return scratch.data();
+}
+
+void Skinned::finishPalette(const glm::mat4* palette, glm::vec4* paletteData)
+{
+    if (!isDualQuat())
+        return;
+    uint32_t numPaletteBones = (uint32_t) mSkeleton.boneOffsets.size();
+    for (uint32_t i = 0; i < numPaletteBones; ++i)
+        convertDualQuat(palette[i], paletteData[2 * i], paletteData[2 * i + 1]);
+}
+
+uint32_t Skinned::writePalette(const AnimClip& clip, uint32_t animationIndex, float time)
+{
+    PoseCache::Claim claim;
+    if (poseCache) {
+        // hits draw from the ring slot of the instance that evaluated the pose
+        uint32_t offset = poseCache->find(mSkeletonId, animationIndex, clip, time, claim);
+        if (offset != PoseCache::INVALID_OFFSET)
+            return offset;
+        time = poseCache->poseTime(clip, time);
+    }
+
+    glm::vec4* paletteData;
+    glm::mat4* palette = allocatePalette(paletteData);
+    evaluatePalette(clip, time, palette);
+    finishPalette(palette, paletteData);
+    if (poseCache)
+        poseCache->publish(claim, ubo.palette.x);
+    return ubo.palette.x;
+}
+
+void Skinned::writeUniforms(Camera& camera)
+{
+	if (!mVisible)
+		return;
+
+	if (isBaked()) {
+		mBakedUbo.model = ubo.model;
+		mBakedUbo.view = camera.view();
+		mBakedUbo.proj = camera.proj();
+		uniformBufferOffset = mUniformRing.write(mBakedUbo);
+		return;
+	}
 
 	ubo.view = camera.view();
 	ubo.proj = camera.proj();
+	uniformBufferOffset = mUniformRing.write(ubo);
+}
+
+void Skinned::evaluatePalette(const AnimClip& clip, float time, glm::mat4* palette)
+{
+    uint32_t numPaletteBones = (uint32_t) mSkeleton.boneOffsets.size();
+    mSkeleton.computePalette(clip, time, mCursor, palette, numPaletteBones);
+    if (animLod)
+        animLod->addEvaluated(numPaletteBones);
+}
+
+bool Skinned::updateVisibility(Camera& camera, uint32_t& updateInterval)
+{
+    if (!animLod)
+        return true;
+
+    glm::vec3 center = glm::vec3(ubo.model * glm::vec4(glm::vec3(mBounds), 1.0f));
+    float scale = std::max(
+            glm::length(glm::vec3(ubo.model[0])), 
+            std::max(glm::length(glm::vec3(ubo.model[1])), glm::length(glm::vec3(ubo.model[2]))));
+    if (animLod->culling() && !camera.isSphereVisible(center, scale * mBounds.w)) {
+        // the last palettes are stale once the instance comes back
+        mLodValid = false;
+        animLod->addCulled();
+        return false;
+    }
+    updateInterval = animLod->updateInterval(glm::distance(camera.eye(), center));
+    return true;
+}
 
-	vkCmdUpdateBuffer(
-			cmdBuffer,
-			mCommonBufferInfo.buffer,
-			uniformBufferOffset,
-			sizeof(UBO),
-			&ubo);
+PipelineInfo& Skinned::pipeline(Pipelines& pipelines) const
+{
+	if (isBaked())
+		return isPacked() ? pipelines.skinnedBakedPacked : pipelines.skinnedBaked;
+	if (isDualQuat())
+		return isPacked() ? pipelines.skinnedDualQuatPacked : pipelines.skinnedDualQuat;
+	return isPacked() ? pipelines.skinnedPacked : pipelines.skinned;
 }
 
 void Skinned::convertVector(const aiVector3D& src, glm::vec3& dest)
@@ -540,6 +1059,29 @@ void Skinned::convertVector(const aiVector3D& src, glm::vec2& dest)
     dest.y = src.y; 
 }
 
+glm::mat4 Skinned::convertMatrix(const aiMatrix4x4& src)
+{
+    // assimp matrices are row major
+    return glm::mat4(
+        src.a1, src.b1, src.c1, src.d1,
+        src.a2, src.b2, src.c2, src.d2,
+        src.a3, src.b3, src.c3, src.d3,
+        src.a4, src.b4, src.c4, src.d4);
+}
+
+
+void Skinned::convertDualQuat(const glm::mat4& src, glm::vec4& real, glm::vec4& dual)
+{
+	glm::mat3 rotation(
+		glm::normalize(glm::vec3(src[0])),
+		glm::normalize(glm::vec3(src[1])),
+		glm::normalize(glm::vec3(src[2])));
+	glm::quat q = glm::quat_cast(rotation);
+	// translation part, 0.5 * t * q
+	glm::quat d = glm::quat(0.0f, src[3].x, src[3].y, src[3].z) * q * 0.5f;
+	real = glm::vec4(q.x, q.y, q.z, q.w);
+	dual = glm::vec4(d.x, d.y, d.z, d.w);
+}
 
 void Skinned::throwError(const char* error) 
 {
@@ -110,6 +110,43 @@ void SwapchainManager::createImageViews()
 	}
 }
 
+void SwapchainManager::createOffscreenImages(uint32_t numImages)
+{
+	mVulkanState.swapChainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	mVulkanState.swapChainExtent.width = mWindow.getWidth();
+	mVulkanState.swapChainExtent.height = mWindow.getHeight();
+
+	for (uint32_t i = 0; i < numImages; ++i) {
+		std::unique_ptr<ImageInfo> imageInfo(new ImageInfo(
+				mVulkanState.device, 
+				mVulkanState.swapChainExtent.width, 
+				mVulkanState.swapChainExtent.height));
+
+		ImageHelper::createImage(
+				mVulkanState, 
+				*imageInfo, 
+				mVulkanState.swapChainImageFormat, 
+				VK_IMAGE_TILING_OPTIMAL,
+				VK_IMAGE_LAYOUT_UNDEFINED,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, 
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		ImageHelper::createImageView(
+				mVulkanState.device,
+				*imageInfo,
+				mVulkanState.swapChainImageFormat,
+				VK_IMAGE_ASPECT_COLOR_BIT);
+
+		mSwapChainImages.push_back(imageInfo->image);
+		mSwapChainImageViews.push_back(imageInfo->imageView);
+		mOffscreenImages.push_back(std::move(imageInfo));
+	}
+	LOG("OFFSCREEN IMAGES CREATED count: %u width: %u height: %u", 
+			numImages, 
+			mVulkanState.swapChainExtent.width, 
+			mVulkanState.swapChainExtent.height);
+}
+
 void SwapchainManager::createDepthResources() 
 {
 	VkFormat depthFormat = ImageHelper::findSupportedFormat(
@@ -136,10 +173,8 @@ void SwapchainManager::createDepthResources()
 			depthFormat,
 			VK_IMAGE_ASPECT_DEPTH_BIT);
 
-	ImageHelper::transitionLayout(
-			mVulkanState, 
+	mVulkanState.uploadManager->transitionLayout(
 			mDepthImageDesc.image, 
-			depthFormat, 
 			VK_IMAGE_LAYOUT_UNDEFINED, 
 			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 
 			VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT, 
@@ -250,7 +285,8 @@ void SwapchainManager::createRenderPass()
 	att.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	att.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	att.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	att.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	// offscreen images are left ready to be copied out
+	att.finalLayout = mVulkanState.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 	VkAttachmentDescription depthAtt = {};
 	depthAtt.format = ImageHelper::findDepthFormat(mVulkanState.physicalDevice);
@@ -285,6 +321,24 @@ void SwapchainManager::createRenderPass()
 	dependancy.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT 
 							 | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
+	// every frame in flight shares the depth image, the clear waits for the
+	// depth writes of the frame before
+	VkSubpassDependency depthDependancy = {};
+	depthDependancy.srcSubpass = VK_SUBPASS_EXTERNAL;
+	depthDependancy.dstSubpass = 0;
+	depthDependancy.srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT 
+								 | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	depthDependancy.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT 
+								 | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	depthDependancy.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	depthDependancy.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT 
+								  | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	std::array<VkSubpassDependency, 2> dependancies = {
+		dependancy,
+		depthDependancy
+	};
+
 	std::array<VkAttachmentDescription, 2> attachments = {
 		att, 
 		depthAtt
@@ -296,8 +350,8 @@ void SwapchainManager::createRenderPass()
 	createInfo.pAttachments = attachments.data();
 	createInfo.subpassCount = 1;
 	createInfo.pSubpasses = &sub;
-	createInfo.dependencyCount = 1;
-	createInfo.pDependencies = &dependancy;
+	createInfo.dependencyCount = dependancies.size();
+	createInfo.pDependencies = dependancies.data();
 
 	VK_CHECK_RESULT(vkCreateRenderPass(mVulkanState.device, &createInfo, nullptr, &mVulkanState.renderPass));
 	LOG("RENDER PASS CREATED");
@@ -314,28 +368,3 @@ void SwapchainManager::createCommandPool()
 	LOG("COMMAND BUFFER CREATED");
 }
 
-void SwapchainManager::createCommandBuffers()
-{
-	cmdBuffers.resize(framebuffers.size());
-
-	VkCommandBufferAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.commandPool = mVulkanState.commandPool;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandBufferCount = (uint32_t) cmdBuffers.size();
-	
-	VK_CHECK_RESULT(vkAllocateCommandBuffers(mVulkanState.device, &allocInfo, cmdBuffers.data()));
-
-	LOG("COMMAND POOL ALLOCATED");
-
-//	buildCommandBuffers();
-}
-
-void SwapchainManager::createSemaphores()
-{
-	VkSemaphoreCreateInfo createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-	VK_CHECK_RESULT(vkCreateSemaphore(mVulkanState.device, &createInfo, nullptr, &mImageAvailableSemaphore));
-	VK_CHECK_RESULT(vkCreateSemaphore(mVulkanState.device, &createInfo, nullptr, &mRenderFinishedSemaphore));
-	LOG("SEMAPHORES CREATED");
-}
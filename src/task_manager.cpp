@@ -1,64 +1,335 @@
 #include "task_manager.h"
 #include <iostream>
 
-TaskManager::TaskManager(): mNumThreads(std::thread::hardware_concurrency())
-{
-	for (size_t i = 0; i < mNumThreads; ++i) {
-		auto f = [this] () -> void {
-			while (mContinue) {
-				Task* task = nullptr;
-				
-				{
-					std::unique_lock<std::mutex> lock(mTasksMutex);
-					mCondition.wait(lock, [this] () -> bool { 
-						return !mContinue || !mTasks.empty(); 
-					});
-					
-					if (mContinue && !mTasks.empty()) {
-						task = mTasks.front();
-						mTasks.pop();
-					}
-				}
+static thread_local TaskManager* tlsTaskManager = nullptr;
+static thread_local size_t tlsWorkerIndex = 0;
+static thread_local uint32_t tlsRandom = 0;
+// job running on this thread is a background job
+static thread_local bool tlsBackground = false;
+
+static uint32_t nextRandom()
+{
+	// xorshift, seeded per thread
+	if (tlsRandom == 0)
+		tlsRandom = (uint32_t) std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+	tlsRandom ^= tlsRandom << 13;
+	tlsRandom ^= tlsRandom >> 17;
+	tlsRandom ^= tlsRandom << 5;
+	return tlsRandom;
+}
+
+TaskManager::TaskManager():
+	TaskManager(std::thread::hardware_concurrency())
+{
+
+}
+
+TaskManager::TaskManager(size_t numThreads):
+	mNumThreads(numThreads > 0 ? numThreads : 1),
+	mContinue(true),
+	mNumQueued(0),
+	mNumSleeping(0),
+	mNumBackgroundQueued(0),
+	mNumBackgroundRunning(0),
+	// one worker is always free for frame jobs
+	mMaxBackground(std::max(1, (int) mNumThreads - 1))
+{
+	mWorkers.reserve(mNumThreads + 1);
+	for (size_t i = 0; i < mNumThreads + 1; ++i)
+		mWorkers.emplace_back(new Worker());
+
+	for (size_t i = 0; i < mNumThreads; ++i)
+		mPool.push_back(std::thread(&TaskManager::workerLoop, this, i));
+}
+
+TaskManager::~TaskManager()
+{
+	mContinue = false;
+	{
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+		mCondition.notify_all();
+	}
+
+	for (auto& t : mPool)
+		t.join();
+
+	// drop jobs that were never picked up
+	for (auto& worker : mWorkers) {
+		while (Job* job = worker->queue.steal()) {
+			job->discard();
+			job->setPending(false);
+		}
+	}
+	for (Job* job : mBackgroundJobs) {
+		job->discard();
+		job->setPending(false);
+	}
+	mBackgroundJobs.clear();
+}
+
+size_t TaskManager::numThreads() const
+{
+	return mNumThreads;
+}
+
+size_t TaskManager::workerIndex() const
+{
+	return currentWorkerIndex();
+}
+
+bool TaskManager::isInBackgroundJob() const
+{
+	return tlsBackground;
+}
 
-				if (task) {
-					task->execute();
-					delete task;
+void TaskManager::submit(Task* task)
+{
+	if (task)
+		submit([task] () {
+			task->execute();
+			delete task;
+		});
+}
+
+void TaskManager::submit(Task& task)
+{
+	Task* t = &task;
+	submit([t] () { t->execute(); });
+}
+
+TaskManager::Worker& TaskManager::currentWorker()
+{
+	return *mWorkers[currentWorkerIndex()];
+}
+
+size_t TaskManager::currentWorkerIndex() const
+{
+	return tlsTaskManager == this ? tlsWorkerIndex : mNumThreads;
+}
+
+bool TaskManager::isExternal(Worker& worker) const
+{
+	return &worker == mWorkers[mNumThreads].get();
+}
+
+Job* TaskManager::allocate()
+{
+	Worker& worker = currentWorker();
+	bool external = isExternal(worker);
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock;
+			if (external)
+				lock = std::unique_lock<std::mutex>(mExternalMutex);
+			// slots of long running background jobs are skipped, not waited on
+			for (uint32_t i = 0; i < POOL_SIZE; ++i) {
+				Job* job = &worker.jobs[worker.nextJob++ & (POOL_SIZE - 1)];
+				if (!job->isPending()) {
+					job->setPending(true);
+					return job;
 				}
 			}
-		};
+		}
+		// every job of the ring is still queued, blocked or running, help out
+		if (!runPendingJob())
+			std::this_thread::yield();
+	}
+}
 
-		mPool.push_back(std::thread(f));
+bool TaskManager::addDependencies(Job* job, JobCounter* const* predecessors, size_t numPredecessors)
+{
+	if (numPredecessors == 0)
+		return true;
+
+	// extra dependency keeps the job from being released while registering
+	job->setNumDependencies(numPredecessors + 1);
+	for (size_t i = 0; i < numPredecessors; ++i) {
+		JobCounter& predecessor = *predecessors[i];
+		bool registered = false;
+		{
+			std::lock_guard<std::mutex> lock(predecessor.mWaitersMutex);
+			if (predecessor.mValue.load() > 0) {
+				predecessor.mWaiters.push_back(job);
+				registered = true;
+			}
+		}
+		if (!registered)
+			job->resolveDependency();
 	}
+	return job->resolveDependency();
 }
 
-TaskManager::~TaskManager() 
+void TaskManager::schedule(Job* job)
 {
-	mContinue = false;
-	mCondition.notify_all();
-	while (!mTasks.empty()) {
-		Task* t = mTasks.front();
-		if (t) {
-			mTasks.pop();
-			delete t;
+	if (job->isBackground()) {
+		{
+			std::lock_guard<std::mutex> lock(mBackgroundMutex);
+			mBackgroundJobs.push_back(job);
 		}
+		mNumBackgroundQueued.fetch_add(1);
+		wakeWorker();
+		return;
 	}
-	
-	for (auto& t : mPool)
-		t.join();
 
-	std::cout<< "stop" << std::endl;
+	Worker& worker = currentWorker();
+	bool pushed;
+	{
+		std::unique_lock<std::mutex> lock;
+		if (isExternal(worker))
+			lock = std::unique_lock<std::mutex>(mExternalMutex);
+		pushed = worker.queue.push(job);
+	}
+
+	if (!pushed) {
+		execute(job);
+		return;
+	}
+
+	mNumQueued.fetch_add(1);
+	wakeWorker();
 }
 
-void TaskManager::submit(Task* task) {
-	if (task) 
-		submit(*task);
+void TaskManager::wakeWorker()
+{
+	if (mNumSleeping.load() > 0) {
+		std::lock_guard<std::mutex> sleepLock(mSleepMutex);
+		mCondition.notify_one();
+	}
 }
 
-void TaskManager::submit(Task& task) {
+void TaskManager::execute(Job* job)
+{
+	// waits inside the job may take background jobs only if it is one
+	bool background = tlsBackground;
+	tlsBackground = job->isBackground();
+	job->execute();
+	tlsBackground = background;
+	// slot may be reused as soon as it is not pending
+	JobCounter* counter = job->counter();
+	job->setCounter(nullptr);
+	job->setPending(false);
+	if (counter)
+		complete(*counter);
+}
+
+void TaskManager::complete(JobCounter& counter)
+{
+	counter.mNumCompleting.fetch_add(1);
+	if (counter.mValue.fetch_sub(1) != 1) {
+		counter.mNumCompleting.fetch_sub(1);
+		return;
+	}
+
+	std::vector<Job*> waiters;
 	{
-		std::unique_lock<std::mutex> lock(mTasksMutex);
-		mTasks.push(&task);
+		std::lock_guard<std::mutex> lock(counter.mWaitersMutex);
+		waiters.swap(counter.mWaiters);
 	}
-	
-	mCondition.notify_one();
+	// counter is not touched past this point
+	counter.mNumCompleting.fetch_sub(1);
+
+	for (Job* waiter : waiters)
+		if (waiter->resolveDependency())
+			schedule(waiter);
+}
+
+void TaskManager::wait(JobCounter& counter)
+{
+	while (!counter.done())
+		if (!runPendingJob())
+			std::this_thread::yield();
+}
+
+Job* TaskManager::findJob(size_t workerIndex)
+{
+	Job* job = nullptr;
+	// external queue may only be popped by its lock holder, steal from it instead
+	if (workerIndex < mNumThreads)
+		job = mWorkers[workerIndex]->queue.pop();
+
+	size_t numWorkers = mWorkers.size();
+	size_t start = nextRandom() % numWorkers;
+	for (size_t i = 0; !job && i < numWorkers; ++i) {
+		size_t victim = (start + i) % numWorkers;
+		if (victim != workerIndex || workerIndex == mNumThreads)
+			job = mWorkers[victim]->queue.steal();
+	}
+
+	if (job)
+		mNumQueued.fetch_sub(1);
+	return job;
+}
+
+bool TaskManager::runPendingJob()
+{
+	Job* job = findJob(currentWorkerIndex());
+	// background jobs help with their own sub jobs
+	if (!job && tlsBackground)
+		job = popBackgroundJob();
+	if (!job)
+		return false;
+	execute(job);
+	return true;
+}
+
+Job* TaskManager::popBackgroundJob()
+{
+	if (mNumBackgroundQueued.load() == 0)
+		return nullptr;
+	std::lock_guard<std::mutex> lock(mBackgroundMutex);
+	if (mBackgroundJobs.empty())
+		return nullptr;
+	Job* job = mBackgroundJobs.front();
+	mBackgroundJobs.pop_front();
+	mNumBackgroundQueued.fetch_sub(1);
+	return job;
+}
+
+bool TaskManager::runBackgroundJob()
+{
+	if (mNumBackgroundRunning.fetch_add(1) >= mMaxBackground) {
+		mNumBackgroundRunning.fetch_sub(1);
+		return false;
+	}
+	Job* job = popBackgroundJob();
+	if (job)
+		execute(job);
+	mNumBackgroundRunning.fetch_sub(1);
+	return job != nullptr;
+}
+
+bool TaskManager::hasRunnableJob() const
+{
+	return mNumQueued.load() > 0 
+		|| (mNumBackgroundQueued.load() > 0 && mNumBackgroundRunning.load() < mMaxBackground);
+}
+
+void TaskManager::workerLoop(size_t workerIndex)
+{
+	tlsTaskManager = this;
+	tlsWorkerIndex = workerIndex;
+	uint32_t spins = 0;
+
+	while (mContinue) {
+		if (runPendingJob() || runBackgroundJob()) {
+			spins = 0;
+			continue;
+		}
+
+		if (++spins < SPIN_COUNT) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mSleepMutex);
+		mNumSleeping.fetch_add(1);
+		mCondition.wait(lock, [this] () -> bool {
+			return !mContinue || hasRunnableJob();
+		});
+		mNumSleeping.fetch_sub(1);
+		spins = 0;
+	}
+
+	tlsTaskManager = nullptr;
 }
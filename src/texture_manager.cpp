@@ -8,28 +8,41 @@ TextureManager& TextureManager::getInstance()
 
 ImageInfo* TextureManager::load(
 			VulkanState& state, 
-			const VkCommandPool& cmdPool, 
-			const VkQueue& cmdQueue,
 			const TextureDesc& textureDesc)
 {
 	TextureManager& tm = getInstance();
-	std::lock_guard<std::mutex> guard(tm.lock);
-	// Check map, load image thread safely
-	auto it = tm.mPool.find(textureDesc);
-	if (it != tm.mPool.end()) {
+	std::promise<ImageInfo*> promise;
+	std::shared_future<ImageInfo*> found;
+	{
+		// Check map, decoding happens outside of the lock
+		std::lock_guard<std::mutex> guard(tm.lock);
+		auto it = tm.mPool.find(textureDesc);
+		if (it != tm.mPool.end())
+			found = it->second;
+		else
+			tm.mPool[textureDesc] = promise.get_future().share();
+	}
+
+	if (found.valid()) {
 		LOG("TEXTURE FOUND: %s", textureDesc.filename.c_str());
-		return it->second;	
+		// may still be decoded by another thread
+		return found.get();
 	}
 
-	TextureData textureData;
-	textureData.load(textureDesc.filename.c_str(), textureDesc.reqComp);
+	try {
+		TextureData textureData;
+		textureData.load(textureDesc.filename.c_str(), textureDesc.reqComp);
 
-	ImageInfo* info = new ImageInfo(state.device, textureData.width, textureData.height);
-	LOG("CREATE IMAGE INFO");
-	ImageHelper::createStagedImage(*info, textureData, state, cmdPool, cmdQueue);
-	LOG("IMAGE CREATED");
-	tm.mPool[textureDesc] = info;
-	return info;
+		ImageInfo* info = new ImageInfo(state.device, textureData.width, textureData.height);
+		LOG("CREATE IMAGE INFO");
+		ImageHelper::createStagedImage(*info, textureData, state);
+		LOG("IMAGE CREATED");
+		promise.set_value(info);
+		return info;
+	} catch (...) {
+		promise.set_exception(std::current_exception());
+		throw;
+	}
 }
 
 TextureManager::TextureManager()
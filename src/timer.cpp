@@ -1,8 +1,14 @@
 #include "timer.h"
 
-Timer::Timer()
+Timer::Timer():
+	mDt(0.0),
+	mFrameTime(0.0),
+	mTotalTime(0.0),
+	mNumFrames(0),
+	mFPS(0)
 {
 	mStartTime = std::chrono::high_resolution_clock::now();
+	mPrevTime = mStartTime;
 }
 
 double Timer::tick()
@@ -23,6 +29,12 @@ double Timer::tick()
 	return mDt;
 }
 
+double Timer::step(double dt)
+{
+	mDt = dt;
+	mTotalTime += dt;
+	return mDt;
+}
 
 double Timer::dt() const
 {
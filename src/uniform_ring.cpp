@@ -0,0 +1,70 @@
+#include "uniform_ring.h"
+
+UniformRing::UniformRing(VulkanState& vulkanState):
+	mState(vulkanState),
+	mBufferInfo(vulkanState.device),
+	mData(nullptr),
+	mAlignment(1),
+	mFrameSize(0),
+	mFrameOffset(0),
+	mHead(0)
+{
+
+}
+
+UniformRing::~UniformRing()
+{
+
+}
+
+void UniformRing::init(uint32_t numFrames, VkDeviceSize frameSize)
+{
+	VkDeviceSize minAlignment = mState.deviceInfo.minUniformBufferOffsetAlignment;
+	mAlignment = minAlignment > 0 ? minAlignment : 1;
+	// every frame region starts aligned
+	mFrameSize = (frameSize + mAlignment - 1) / mAlignment * mAlignment;
+	mBufferInfo.size = mFrameSize * numFrames;
+
+	BufferHelper::createBuffer(
+			mState,
+			mBufferInfo,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	// host visible memory stays mapped by the allocator
+	mData = mBufferInfo.allocation.mapped;
+	LOG("UNIFORM RING CREATED frames: %u frame size: %llu alignment: %llu", 
+			numFrames, 
+			(unsigned long long) mFrameSize, 
+			(unsigned long long) mAlignment);
+}
+
+void UniformRing::beginFrame(uint32_t frameIndex)
+{
+	mFrameOffset = frameIndex * mFrameSize;
+	mHead.store(0);
+}
+
+uint32_t UniformRing::allocate(VkDeviceSize size, void** data)
+{
+	VkDeviceSize alignedSize = (size + mAlignment - 1) / mAlignment * mAlignment;
+	VkDeviceSize offset = mHead.fetch_add(alignedSize);
+	if (offset + size > mFrameSize)
+		throw std::runtime_error("Uniform ring frame overflow, increase frame size");
+	*data = mData + mFrameOffset + offset;
+	return (uint32_t) (mFrameOffset + offset);
+}
+
+VkBuffer UniformRing::buffer() const
+{
+	return mBufferInfo.buffer;
+}
+
+VkDeviceSize UniformRing::frameSize() const
+{
+	return mFrameSize;
+}
+
+VkDeviceSize UniformRing::used() const
+{
+	return std::min(mHead.load(), mFrameSize);
+}
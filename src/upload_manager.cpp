@@ -0,0 +1,337 @@
+#include "upload_manager.h"
+
+// keeps buffer offsets valid for buffer and RGBA8 image copies
+static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+UploadManager::UploadManager(VulkanState& vulkanState):
+	mState(vulkanState),
+	mCommandPool(VK_NULL_HANDLE),
+	mStaging(vulkanState.device),
+	mStagingData(nullptr),
+	mStagingHead(0),
+	mStagingTail(0),
+	mRecordingSerial(0),
+	mNextSerial(1),
+	mRetiredSerial(0),
+	mNumSubmits(0),
+	mNumBytes(0)
+{
+
+}
+
+UploadManager::~UploadManager()
+{
+	if (mCommandPool == VK_NULL_HANDLE)
+		return;
+
+	waitIdle();
+	for (auto& batch : mBatches)
+		vkDestroyFence(mState.device, batch.fence, nullptr);
+	vkDestroyCommandPool(mState.device, mCommandPool, nullptr);
+}
+
+void UploadManager::init(VkDeviceSize stagingSize)
+{
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = mState.graphicsQueueIndex;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	VK_CHECK_RESULT(vkCreateCommandPool(mState.device, &poolInfo, nullptr, &mCommandPool));
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = mCommandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+	for (auto& batch : mBatches) {
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(mState.device, &allocInfo, &batch.cmdBuffer));
+		VK_CHECK_RESULT(vkCreateFence(mState.device, &fenceInfo, nullptr, &batch.fence));
+	}
+
+	mStaging.size = stagingSize;
+	BufferHelper::createStagingBuffer(mState, mStaging);
+	mStagingData = mStaging.allocation.mapped;
+	LOG("UPLOAD MANAGER CREATED staging: %llu", (unsigned long long) mStaging.size);
+}
+
+UploadHandle UploadManager::uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	VkBuffer src;
+	char* stagingData;
+	VkDeviceSize srcOffset = allocateStaging(size, src, &stagingData);
+	memcpy(stagingData, data, (size_t) size);
+
+	Batch& batch = recordingBatch();
+	VkBufferCopy bufferCopy = {};
+	bufferCopy.srcOffset = srcOffset;
+	bufferCopy.dstOffset = dstOffset;
+	bufferCopy.size = size;
+	vkCmdCopyBuffer(batch.cmdBuffer, src, dst, 1, &bufferCopy);
+
+	mNumBytes += size;
+	return UploadHandle(batch.serial);
+}
+
+UploadHandle UploadManager::uploadImage(VkImage dst, uint32_t width, uint32_t height, const void* pixels, VkDeviceSize size)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	VkBuffer src;
+	char* stagingData;
+	VkDeviceSize srcOffset = allocateStaging(size, src, &stagingData);
+	memcpy(stagingData, pixels, (size_t) size);
+
+	Batch& batch = recordingBatch();
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = dst;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(
+			batch.cmdBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
+
+	VkBufferImageCopy region = {};
+	region.bufferOffset = srcOffset;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = {0, 0, 0};
+	region.imageExtent = {width, height, 1};
+	vkCmdCopyBufferToImage(batch.cmdBuffer, src, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	// transitions to the shader layout are recorded together at submit
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	batch.imageBarriers.push_back(barrier);
+
+	mNumBytes += size;
+	return UploadHandle(batch.serial);
+}
+
+UploadHandle UploadManager::transitionLayout(
+		VkImage image,
+		VkImageLayout oldLayout,
+		VkImageLayout newLayout,
+		VkImageAspectFlags aspectMask,
+		VkAccessFlags srcAccessMask,
+		VkAccessFlags dstAccessMask)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	Batch& batch = recordingBatch();
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = aspectMask;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.srcAccessMask = srcAccessMask;
+	barrier.dstAccessMask = dstAccessMask;
+
+	vkCmdPipelineBarrier(
+			batch.cmdBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
+
+	return UploadHandle(batch.serial);
+}
+
+void UploadManager::flush()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	submit();
+	// recycle whatever already finished
+	while (retire(false));
+}
+
+bool UploadManager::isDone(UploadHandle handle)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	while (mRetiredSerial < handle.batch && retire(false));
+	return handle.batch <= mRetiredSerial;
+}
+
+void UploadManager::wait(UploadHandle handle)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (handle.batch == mRecordingSerial)
+		submit();
+	while (mRetiredSerial < handle.batch && retire(true));
+}
+
+void UploadManager::waitIdle()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	submit();
+	while (retire(true));
+}
+
+uint64_t UploadManager::numSubmits() const
+{
+	return mNumSubmits;
+}
+
+uint64_t UploadManager::numBytes() const
+{
+	return mNumBytes;
+}
+
+UploadManager::Batch& UploadManager::recordingBatch()
+{
+	if (mRecordingSerial != 0)
+		return mBatches[mRecordingSerial % MAX_BATCHES];
+
+	uint64_t serial = mNextSerial++;
+	Batch& batch = mBatches[serial % MAX_BATCHES];
+	// slot is still used by an older batch
+	while (mRetiredSerial < batch.serial && retire(true));
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VK_CHECK_RESULT(vkBeginCommandBuffer(batch.cmdBuffer, &beginInfo));
+
+	batch.serial = serial;
+	mRecordingSerial = serial;
+	return batch;
+}
+
+VkDeviceSize UploadManager::allocateStaging(VkDeviceSize size, VkBuffer& buffer, char** data)
+{
+	VkDeviceSize ringSize = mStaging.size;
+	if (size > ringSize) {
+		// does not fit the ring, staged through its own buffer freed with the batch
+		std::unique_ptr<BufferInfo> staging(new BufferInfo(mState.device, size));
+		BufferHelper::createStagingBuffer(mState, *staging);
+		*data = staging->allocation.mapped;
+		buffer = staging->buffer;
+		recordingBatch().dedicatedStaging.push_back(std::move(staging));
+		return 0;
+	}
+
+	for (;;) {
+		if (mRecordingSerial == 0 && mRetiredSerial + 1 == mNextSerial) {
+			// nothing in flight, start over from the beginning of the ring
+			mStagingHead = 0;
+			mStagingTail = 0;
+		}
+
+		VkDeviceSize pos = (mStagingHead + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+		VkDeviceSize ringPos = pos % ringSize;
+		// ranges never wrap around the end of the ring
+		if (ringPos + size > ringSize)
+			pos += ringSize - ringPos;
+
+		if (pos + size - mStagingTail <= ringSize) {
+			mStagingHead = pos + size;
+			buffer = mStaging.buffer;
+			*data = mStagingData + pos % ringSize;
+			return pos % ringSize;
+		}
+
+		// ring is full, the batch being recorded may hold the space as well
+		if (!retire(true))
+			submit();
+	}
+}
+
+void UploadManager::submit()
+{
+	if (mRecordingSerial == 0)
+		return;
+
+	Batch& batch = mBatches[mRecordingSerial % MAX_BATCHES];
+
+	// one barrier makes every copy of the batch visible to later submissions
+	VkMemoryBarrier memoryBarrier = {};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT
+								| VK_ACCESS_INDEX_READ_BIT
+								| VK_ACCESS_UNIFORM_READ_BIT
+								| VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(
+			batch.cmdBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+			| VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+			| VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0,
+			1, &memoryBarrier,
+			0, nullptr,
+			(uint32_t) batch.imageBarriers.size(), batch.imageBarriers.data());
+	batch.imageBarriers.clear();
+
+	VK_CHECK_RESULT(vkEndCommandBuffer(batch.cmdBuffer));
+	batch.stagingEnd = mStagingHead;
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &batch.cmdBuffer;
+
+	VK_CHECK_RESULT(vkResetFences(mState.device, 1, &batch.fence));
+	{
+		std::lock_guard<std::mutex> queueLock(mState.queueMutex);
+		VK_CHECK_RESULT(vkQueueSubmit(mState.graphicsQueue, 1, &submitInfo, batch.fence));
+	}
+	mRecordingSerial = 0;
+	++mNumSubmits;
+}
+
+bool UploadManager::retire(bool block)
+{
+	// batches are submitted and retired in serial order
+	uint64_t serial = mRetiredSerial + 1;
+	if (serial >= mNextSerial || serial == mRecordingSerial)
+		return false;
+
+	Batch& batch = mBatches[serial % MAX_BATCHES];
+	if (block)
+		VK_CHECK_RESULT(vkWaitForFences(mState.device, 1, &batch.fence, VK_TRUE, std::numeric_limits<uint64_t>::max()));
+	else if (vkGetFenceStatus(mState.device, batch.fence) != VK_SUCCESS)
+		return false;
+
+	mStagingTail = batch.stagingEnd;
+	batch.dedicatedStaging.clear();
+	mRetiredSerial = serial;
+	return true;
+}
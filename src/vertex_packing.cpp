@@ -0,0 +1,114 @@
+#include "vertex_packing.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include <glm/gtc/packing.hpp>
+
+namespace
+{
+
+constexpr float SNORM16_MAX = 32767.0f;
+constexpr float UNORM16_MAX = 65535.0f;
+constexpr float MIN_LENGTH = 1e-6f;
+
+int16_t packSnorm16(float v)
+{
+	return (int16_t) std::lround(glm::clamp(v, -1.0f, 1.0f) * SNORM16_MAX);
+}
+
+}
+
+void VertexPacking::packTangentFrame(
+		const glm::vec3& normal,
+		const glm::vec3& tangent,
+		const glm::vec3& bitangent,
+		int16_t frame[4])
+{
+	glm::vec3 n = glm::length(normal) > MIN_LENGTH ? glm::normalize(normal) : glm::vec3(0.0f, 0.0f, 1.0f);
+	// Gram-Schmidt, meshes without tangents get any tangent perpendicular to the normal
+	glm::vec3 t = tangent - n * glm::dot(n, tangent);
+	if (glm::length(t) <= MIN_LENGTH) {
+		glm::vec3 axis = std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		t = axis - n * glm::dot(n, axis);
+	}
+	t = glm::normalize(t);
+	glm::vec3 b = glm::cross(n, t);
+	bool reflected = glm::dot(b, bitangent) < 0.0f;
+
+	glm::quat q = glm::normalize(glm::quat_cast(glm::mat3(t, b, n)));
+	if (q.w < 0.0f)
+		q = -q;
+	// smallest w snorm16 keeps positive, the rest of the quaternion is scaled to stay unit
+	constexpr float MIN_W = 1.0f / SNORM16_MAX;
+	if (q.w < MIN_W) {
+		float scale = std::sqrt(1.0f - MIN_W * MIN_W);
+		q = glm::quat(MIN_W, q.x * scale, q.y * scale, q.z * scale);
+	}
+	if (reflected)
+		q = -q;
+
+	frame[0] = packSnorm16(q.x);
+	frame[1] = packSnorm16(q.y);
+	frame[2] = packSnorm16(q.z);
+	frame[3] = packSnorm16(q.w);
+}
+
+void VertexPacking::unpackTangentFrame(const int16_t frame[4], glm::vec3& normal, glm::vec3& tangent, glm::vec3& bitangent)
+{
+	glm::quat q(
+		std::max(frame[3] / SNORM16_MAX, -1.0f),
+		std::max(frame[0] / SNORM16_MAX, -1.0f),
+		std::max(frame[1] / SNORM16_MAX, -1.0f),
+		std::max(frame[2] / SNORM16_MAX, -1.0f));
+	float reflection = q.w < 0.0f ? -1.0f : 1.0f;
+	glm::mat3 m = glm::mat3_cast(glm::normalize(q));
+	tangent = m[0];
+	bitangent = m[1] * reflection;
+	normal = m[2];
+}
+
+void VertexPacking::packHalf2(const glm::vec2& v, uint16_t packed[2])
+{
+	uint32_t halves = glm::packHalf2x16(v);
+	packed[0] = (uint16_t) (halves & 0xFFFF);
+	packed[1] = (uint16_t) (halves >> 16);
+}
+
+void VertexPacking::packWeights(const glm::vec4& weights, uint16_t packed[4])
+{
+	float sum = weights.x + weights.y + weights.z + weights.w;
+	if (sum <= 0.0f) {
+		packed[0] = packed[1] = packed[2] = packed[3] = 0;
+		return;
+	}
+	glm::vec4 normalized = weights / sum;
+
+	int32_t total = 0;
+	uint32_t largest = 0;
+	for (uint32_t i = 0; i < 4; ++i) {
+		packed[i] = (uint16_t) std::lround(glm::clamp(normalized[i], 0.0f, 1.0f) * UNORM16_MAX);
+		total += packed[i];
+		if (normalized[i] > normalized[largest])
+			largest = i;
+	}
+	packed[largest] = (uint16_t) (packed[largest] + ((int32_t) UNORM16_MAX - total));
+}
+
+bool VertexPacking::packIndices16(
+		const uint32_t* indices, 
+		uint32_t numIndices, 
+		uint32_t baseVertex, 
+		uint32_t numVertices, 
+		uint16_t* packed)
+{
+	if (numVertices > UINT16_MAX + 1)
+		return false;
+	for (uint32_t i = 0; i < numIndices; ++i) {
+		uint32_t index = indices[i];
+		if (index < baseVertex || index - baseVertex >= numVertices)
+			return false;
+		packed[i] = (uint16_t) (index - baseVertex);
+	}
+	return true;
+}
@@ -5,7 +5,6 @@ ImageInfo::ImageInfo():
 	height(0),
 	image(VK_NULL_HANDLE),
 	imageView(VK_NULL_HANDLE),
-	memory(VK_NULL_HANDLE),
 	sampler(VK_NULL_HANDLE),
 	mVkDevice(nullptr)
 {
@@ -17,7 +16,6 @@ ImageInfo::ImageInfo(VkDevice& vkDevice):
 	height(0),
 	image(VK_NULL_HANDLE),
 	imageView(VK_NULL_HANDLE),
-	memory(VK_NULL_HANDLE),
 	sampler(VK_NULL_HANDLE),
 	mVkDevice(&vkDevice)
 {
@@ -29,7 +27,6 @@ ImageInfo::ImageInfo(VkDevice& vkDevice, uint32_t width, uint32_t height):
 	height(height),
 	image(VK_NULL_HANDLE),
 	imageView(VK_NULL_HANDLE),
-	memory(VK_NULL_HANDLE),
 	sampler(VK_NULL_HANDLE),
 	mVkDevice(&vkDevice)
 {
@@ -42,8 +39,8 @@ ImageInfo::~ImageInfo()
 		vkDestroyImageView(*mVkDevice, imageView, nullptr);
 	if (image != VK_NULL_HANDLE)
 		vkDestroyImage(*mVkDevice, image, nullptr);
-	if (memory != VK_NULL_HANDLE)
-		vkFreeMemory(*mVkDevice, memory, nullptr);
+	if (allocation.allocator)
+		allocation.allocator->free(allocation);
 }
 
 ImageInfo& ImageInfo::operator=(ImageInfo other) 
@@ -52,7 +49,7 @@ ImageInfo& ImageInfo::operator=(ImageInfo other)
 	height = other.height;
 	image = other.image;
 	imageView = other.imageView;
-	memory = other.memory;
+	allocation = other.allocation;
 	mVkDevice = other.mVkDevice;
 	LOG("__EQ");
 	return *this;	
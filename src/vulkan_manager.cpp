@@ -1,14 +1,28 @@
 #include "vulkan_manager.h"
 
 
-VulkanManager::VulkanManager(Window& window):
+VulkanManager::VulkanManager(Window& window, TaskManager& taskManager, uint32_t numFramesInFlight):
 	mWindow(window),
+	mTaskManager(taskManager),
 	mDeviceManager(mState),
+	mMemoryAllocator(mState),
 	mSwapChainManager(mState, mWindow),
-	quad(mState),
-	suit(mState),
-	dwarf(mState),
-    guard(mState),
+	mCommandPools(mState, taskManager),
+	mUniformRing(mState),
+	mPaletteRing(mState),
+	mUploadManager(mState),
+	mNumFramesInFlight(std::max<uint32_t>(1, numFramesInFlight)),
+	mFrameIndex(0),
+	mQueryPool(VK_NULL_HANDLE),
+	mLastGpuFrameTime(-1.0),
+	mLastFenceWaitTime(0.0),
+	quad(mState, mUniformRing),
+	suit(mState, mUniformRing),
+    guard(mState, mUniformRing, mPaletteRing),
+	dwarf(mState, mUniformRing, mPaletteRing),
+	mAssetLoader(mState, taskManager),
+	mSkinnedModelFlags(Skinned::ModelFlag_packedVertices),
+	mModelFlags(Model::ModelFlag_packedVertices),
 	imageIndex(0)
 {
 	
@@ -16,151 +30,447 @@ VulkanManager::VulkanManager(Window& window):
 
 VulkanManager::~VulkanManager()
 {
+	// loads still running record into the upload manager and allocator
+	mAssetLoader.waitAll();
+	destroyFrames();
 }
 
-void VulkanManager::init() 
+void VulkanManager::init(bool headless) 
 {
+	mState.headless = headless;
 	mDeviceManager.createVkInstance();
 #ifdef AMVK_DEBUG
 	mDeviceManager.enableDebug();
 #endif
-	mSwapChainManager.createSurface();
+	if (!headless)
+		mSwapChainManager.createSurface();
 	mDeviceManager.createPhysicalDevice(mSwapChainManager);
 	mDeviceManager.createLogicalDevice();
+	mMemoryAllocator.init();
+	mState.memoryAllocator = &mMemoryAllocator;
 
-	mSwapChainManager.createSwapChain();
-	mSwapChainManager.createImageViews();
+	if (headless) {
+		// one image per frame slot, frames never wait on each other's image
+		mSwapChainManager.createOffscreenImages(mNumFramesInFlight);
+	} else {
+		mSwapChainManager.createSwapChain();
+		mSwapChainManager.createImageViews();
+	}
 	
 	mSwapChainManager.createRenderPass();
 	mSwapChainManager.createCommandPool();
+	mUploadManager.init();
+	mState.uploadManager = &mUploadManager;
+	mState.taskManager = &mTaskManager;
 
 	ShaderManager::createShaders(mState);
 	DescriptorManager::createDescriptorSetLayouts(mState);
 	DescriptorManager::createDescriptorPool(mState);
     PipelineManager::createPipelines(mState);
+	mUniformRing.init(mNumFramesInFlight);
+	mPaletteRing.init(mNumFramesInFlight);
 
 
 	quad.init();
 
-    suit.init(FileManager::getModelsPath("nanosuit/nanosuit.obj"),
-              Model::DEFAULT_FLAGS | aiProcess_FlipUVs);
-
-	dwarf.init(FileManager::getModelsPath("dwarf/dwarf2.ms3d"),
-               Skinned::DEFAULT_FLAGS | aiProcess_FlipUVs | aiProcess_FlipWindingOrder,
-               Skinned::ModelFlag_stripFullPath);
-
+	// placement is set before the loads start, workers only touch the model itself
     dwarf.ubo.model = glm::scale(glm::vec3(0.15f, 0.15f, 0.15f));
     dwarf.ubo.model = glm::rotate(glm::radians(180.f), glm::vec3(1.f, 0.f, 0.f)) * dwarf.ubo.model;
     dwarf.ubo.model = glm::rotate(glm::radians(180.f), glm::vec3(0.f, 1.f, 0.f)) * dwarf.ubo.model;
     dwarf.ubo.model = glm::translate(glm::vec3(2.0f, 4.0f, 8.0f))  * dwarf.ubo.model;
     dwarf.animSpeedScale = 0.5f;
+    dwarf.poseCache = &mPoseCache;
+    dwarf.animLod = &mAnimLod;
 
-	guard.init(FileManager::getModelsPath("guard/boblampclean.md5mesh"),
-               Skinned::DEFAULT_FLAGS | aiProcess_FlipUVs | aiProcess_FlipWindingOrder,
-               0);
     guard.ubo.model = glm::scale(glm::vec3(0.18f, 0.18f, 0.18f));
     guard.ubo.model = glm::rotate(glm::radians(180.f), glm::vec3(1.f, 0.f, 0.f)) * guard.ubo.model;
     guard.ubo.model = glm::rotate(glm::radians(-30.f), glm::vec3(0.f, 1.f, 0.f)) * guard.ubo.model;
     guard.ubo.model = glm::translate(glm::vec3(-9.0f, 4.0f, 8.0f))  * guard.ubo.model;
+    guard.poseCache = &mPoseCache;
+    guard.animLod = &mAnimLod;
+
+	// models load on workers, frames are rendered without them until they are resident
+	std::string suitPath = FileManager::getModelsPath("nanosuit/nanosuit.obj");
+	mSuitAsset = mAssetLoader.load("nanosuit", [this, suitPath] () {
+		suit.init(suitPath, Model::DEFAULT_FLAGS | aiProcess_FlipUVs, mModelFlags);
+	});
+
+	std::string dwarfPath = FileManager::getModelsPath("dwarf/dwarf2.ms3d");
+	// background character, its loop is baked and played by the vertex shader
+	mDwarfAsset = mAssetLoader.load("dwarf", [this, dwarfPath] () {
+		dwarf.init(dwarfPath,
+				   Skinned::DEFAULT_FLAGS | aiProcess_FlipUVs | aiProcess_FlipWindingOrder,
+				   Skinned::ModelFlag_stripFullPath | Skinned::ModelFlag_bakeAnimations | mSkinnedModelFlags);
+	});
+
+	std::string guardPath = FileManager::getModelsPath("guard/boblampclean.md5mesh");
+	mGuardAsset = mAssetLoader.load("guard", [this, guardPath] () {
+		guard.init(guardPath,
+				   Skinned::DEFAULT_FLAGS | aiProcess_FlipUVs | aiProcess_FlipWindingOrder,
+				   Skinned::ModelFlag_compressAnimations | mSkinnedModelFlags);
+	});
 
 	mSwapChainManager.createDepthResources();
 	mSwapChainManager.createFramebuffers(mState.renderPass);
 
-	mSwapChainManager.createCommandBuffers();
-	mSwapChainManager.createSemaphores();
+	createFrames();
+	mCommandPools.init(mNumFramesInFlight);
+	createSceneObjects();
+
+	// everything loaded above goes out in as few submissions as the staging ring allows,
+	// models still loading are flushed by the asset loader
+	mUploadManager.flush();
+	LOG("UPLOADS submits: %llu bytes: %llu", 
+			(unsigned long long) mUploadManager.numSubmits(), 
+			(unsigned long long) mUploadManager.numBytes());
+	mMemoryAllocator.dumpStats();
 	
 	LOG("INIT SUCCESSFUL");
 }
 
+void VulkanManager::createFrames()
+{
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = mState.commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+
+	VkSemaphoreCreateInfo semaphoreInfo = {};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	// signaled, so the first wait on every frame returns immediately
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+	mFrames.resize(mNumFramesInFlight);
+	for (auto& frame : mFrames) {
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(mState.device, &allocInfo, &frame.cmdBuffer));
+		VK_CHECK_RESULT(vkCreateSemaphore(mState.device, &semaphoreInfo, nullptr, &frame.imageAvailableSemaphore));
+		VK_CHECK_RESULT(vkCreateSemaphore(mState.device, &semaphoreInfo, nullptr, &frame.renderFinishedSemaphore));
+		VK_CHECK_RESULT(vkCreateFence(mState.device, &fenceInfo, nullptr, &frame.fence));
+	}
+	mImageFences.assign(mSwapChainManager.framebuffers.size(), VK_NULL_HANDLE);
+
+	if (mState.deviceInfo.timestampValidBits > 0) {
+		VkQueryPoolCreateInfo queryPoolInfo = {};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 2 * mNumFramesInFlight;
+		VK_CHECK_RESULT(vkCreateQueryPool(mState.device, &queryPoolInfo, nullptr, &mQueryPool));
+	}
+	LOG("FRAMES IN FLIGHT: %u", mNumFramesInFlight);
+}
 
-void VulkanManager::updateUniformBuffers(const Timer& timer, Camera& camera)
+void VulkanManager::destroyFrames()
 {
-	CmdPass cmd(mState.device, mState.commandPool, mState.graphicsQueue);
-	quad.update(cmd.buffer, timer, camera);
-    suit.update(cmd.buffer, timer, camera);
-	dwarf.update(cmd.buffer, timer, camera);
-	guard.update(cmd.buffer, timer, camera);
+	if (mState.device == VK_NULL_HANDLE)
+		return;
+	for (auto& frame : mFrames) {
+		vkDestroySemaphore(mState.device, frame.imageAvailableSemaphore, nullptr);
+		vkDestroySemaphore(mState.device, frame.renderFinishedSemaphore, nullptr);
+		vkDestroyFence(mState.device, frame.fence, nullptr);
+		vkFreeCommandBuffers(mState.device, mState.commandPool, 1, &frame.cmdBuffer);
+	}
+	mFrames.clear();
+	if (mQueryPool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(mState.device, mQueryPool, nullptr);
+	mQueryPool = VK_NULL_HANDLE;
 }
 
-void VulkanManager::buildCommandBuffers(const Timer &timer, Camera &camera)
+void VulkanManager::createSceneObjects()
+
 {
+	SceneObject quadObject;
+	quadObject.async = false;
+	quadObject.update = [this] (const Timer& timer, Camera& camera) {
+		quad.update(timer, camera);
+	};
+	quadObject.draw = [this] (VkCommandBuffer& cmd) {
+		quad.draw(cmd);
+	};
+	mSceneObjects.push_back(quadObject);
+
+	SceneObject suitObject;
+	suitObject.async = true;
+	suitObject.asset = mSuitAsset;
+	suitObject.update = [this] (const Timer& timer, Camera& camera) {
+		suit.update(timer, camera);
+	};
+	suitObject.draw = [this] (VkCommandBuffer& cmd) {
+		PipelineInfo& pipeline = suit.pipeline(mState.pipelines);
+		suit.draw(cmd, pipeline.pipeline, pipeline.layout);
+	};
+	mSceneObjects.push_back(suitObject);
+
+	Skinned* skinnedModels[] = { &dwarf, &guard };
+	AssetLoader::Handle skinnedAssets[] = { mDwarfAsset, mGuardAsset };
+	for (size_t i = 0; i < ARRAY_SIZE(skinnedModels); ++i) {
+		Skinned* skinned = skinnedModels[i];
+		SceneObject skinnedObject;
+		skinnedObject.async = true;
+		skinnedObject.asset = skinnedAssets[i];
+		skinnedObject.skinned = skinned;
+		skinnedObject.update = [skinned] (const Timer& timer, Camera& camera) {
+			skinned->writeUniforms(camera);
+		};
+		skinnedObject.draw = [this, skinned] (VkCommandBuffer& cmd) {
+			PipelineInfo& pipeline = skinned->pipeline(mState.pipelines);
+			skinned->draw(cmd, pipeline.pipeline, pipeline.layout);
+		};
+		mSceneObjects.push_back(skinnedObject);
+	}
+}
 
+void VulkanManager::animateSceneObjects(const Timer& timer, Camera& camera)
+{
+	mAnimatedModels.clear();
+	uint64_t totalCost = 0;
+	for (size_t i : mVisibleObjects) {
+		Skinned* skinned = mSceneObjects[i].skinned;
+		if (skinned) {
+			mAnimatedModels.push_back(skinned);
+			totalCost += skinned->animationCost();
+		}
+	}
+	if (mAnimatedModels.empty())
+		return;
+
+	// few jobs per worker, cut by cost so large skeletons do not end up in one job.
+	// Palettes go straight to the mapped palette ring, evaluation works in the
+	// scratch of the worker
+	size_t numWorkers = mTaskManager.numThreads() + 1;
+	uint64_t jobCost = std::max<uint64_t>(1, totalCost / (4 * numWorkers));
+	JobCounter counter;
+	size_t begin = 0;
+	uint64_t cost = 0;
+	for (size_t i = 0; i < mAnimatedModels.size(); ++i) {
+		cost += mAnimatedModels[i]->animationCost();
+		if (cost < jobCost && i + 1 < mAnimatedModels.size())
+			continue;
+		size_t end = i + 1;
+		mTaskManager.submit(counter, [this, &timer, &camera, begin, end] () {
+			for (size_t j = begin; j < end; ++j)
+				mAnimatedModels[j]->animate(timer, camera);
+		});
+		begin = end;
+		cost = 0;
+	}
+	mTaskManager.wait(counter);
+}
+
+void VulkanManager::recordSceneObjects(Frame& frame, const Timer& timer, Camera& camera)
+{
+	// objects still loading are skipped
+	mVisibleObjects.clear();
+	for (size_t i = 0; i < mSceneObjects.size(); ++i)
+		if (!mSceneObjects[i].async || mAssetLoader.isResident(mSceneObjects[i].asset))
+			mVisibleObjects.push_back(i);
+
+	animateSceneObjects(timer, camera);
+
+	size_t numObjects = mVisibleObjects.size();
+	size_t numWorkers = mTaskManager.numThreads() + 1;
+	// few batches per worker, enough to balance uneven objects
+	size_t batchSize = std::max<size_t>(1, numObjects / (4 * numWorkers));
+	size_t numBatches = (numObjects + batchSize - 1) / batchSize;
+	frame.drawBuffers.resize(numBatches);
+
+	// framebuffer is left unknown, the image is acquired after recording
+	VkCommandBufferInheritanceInfo drawInheritanceInfo = {};
+	drawInheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	drawInheritanceInfo.renderPass = mState.renderPass;
+	drawInheritanceInfo.subpass = 0;
+	drawInheritanceInfo.framebuffer = VK_NULL_HANDLE;
+
+	VkCommandBufferBeginInfo drawBeginInfo = {};
+	drawBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	drawBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	drawBeginInfo.pInheritanceInfo = &drawInheritanceInfo;
+
+	VkViewport viewport;
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = (float) mState.swapChainExtent.width;
+	viewport.height = (float) mState.swapChainExtent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	
+	VkRect2D scissor = {};
+	scissor.offset = {0, 0};
+	scissor.extent = mState.swapChainExtent;
+
+	uint32_t slot = mFrameIndex;
+	mTaskManager.parallelFor(numObjects, batchSize, [&] (size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			mSceneObjects[mVisibleObjects[i]].update(timer, camera);
+
+		VkCommandBuffer drawBuffer = mCommandPools.next(slot);
+
+		// dynamic state is not inherited, every secondary buffer sets its own
+		VK_CHECK_RESULT(vkBeginCommandBuffer(drawBuffer, &drawBeginInfo));
+		vkCmdSetViewport(drawBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(drawBuffer, 0, 1, &scissor);
+		for (size_t i = begin; i < end; ++i)
+			mSceneObjects[mVisibleObjects[i]].draw(drawBuffer);
+		VK_CHECK_RESULT(vkEndCommandBuffer(drawBuffer));
+
+		frame.drawBuffers[begin / batchSize] = drawBuffer;
+	});
+}
+
+void VulkanManager::updateUniformBuffers(const Timer& timer, Camera& camera)
+{
+	Frame& frame = mFrames[mFrameIndex];
+	// GPU is done with this frame slot once its fence is signaled,
+	// the other slots may still be in flight
+	auto waitStart = std::chrono::high_resolution_clock::now();
+	VK_CHECK_RESULT(vkWaitForFences(mState.device, 1, &frame.fence, VK_TRUE, std::numeric_limits<uint64_t>::max()));
+	mLastFenceWaitTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - waitStart).count();
+	readTimestamps(frame);
+	// submits uploads of finished loads ahead of this frame
+	mAssetLoader.update();
+	mCommandPools.reset(mFrameIndex);
+	mUniformRing.beginFrame(mFrameIndex);
+	mPaletteRing.beginFrame(mFrameIndex);
+	mPoseCache.beginFrame();
+	mAnimLod.beginFrame();
+	recordSceneObjects(frame, timer, camera);
+}
+
+void VulkanManager::recordFrame(Frame& frame, uint32_t imageIndex)
+{
 	VkClearValue clearValues[] ={
 		{{0.4f, 0.1f, 0.1f, 1.0f}},	// VkClearColorValue color; 
 		{{1.0f, 0}} // VkClearDepthStencilValue depthStencil 
 	};
 
-
 	VkCommandBufferBeginInfo beginInfo = {};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
 	VkRenderPassBeginInfo renderPassBeginInfo = {};
 	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	renderPassBeginInfo.renderPass = mState.renderPass;
+	renderPassBeginInfo.framebuffer = mSwapChainManager.framebuffers[imageIndex];
 	renderPassBeginInfo.renderArea.offset = {0, 0};
 	renderPassBeginInfo.renderArea.extent = mState.swapChainExtent;
 	renderPassBeginInfo.clearValueCount = ARRAY_SIZE(clearValues);
 	renderPassBeginInfo.pClearValues = clearValues;
-	
-	for (size_t i = 0; i < mSwapChainManager.cmdBuffers.size(); ++i) {
-        VkCommandBuffer& cmdBuffer = mSwapChainManager.cmdBuffers[i];
-		VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &beginInfo));
-		renderPassBeginInfo.framebuffer = mSwapChainManager.framebuffers[i];
-		vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-		VkViewport viewport;
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = (float) mState.swapChainExtent.width;
-		viewport.height = (float) mState.swapChainExtent.height;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-		
-		VkRect2D scissor = {};
-		scissor.offset = {0, 0};
-		scissor.extent = mState.swapChainExtent;
-
-		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
-		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
-			
-		quad.draw(cmdBuffer);
-		suit.draw(cmdBuffer, mState.pipelines.model.pipeline, mState.pipelines.model.layout);
-		dwarf.draw(cmdBuffer, mState.pipelines.skinned.pipeline, mState.pipelines.skinned.layout);
-        guard.draw(cmdBuffer, mState.pipelines.skinned.pipeline, mState.pipelines.skinned.layout);
-
-		vkCmdEndRenderPass(cmdBuffer);
-		VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+
+	// uniforms of this frame were written to its own host coherent ring region,
+	// the submit makes them visible, no transfers or barriers needed
+	VkCommandBuffer& cmdBuffer = frame.cmdBuffer;
+	VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &beginInfo));
+
+	uint32_t firstQuery = 2 * mFrameIndex;
+	if (mQueryPool != VK_NULL_HANDLE) {
+		vkCmdResetQueryPool(cmdBuffer, mQueryPool, firstQuery, 2);
+		vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, mQueryPool, firstQuery);
+	}
+
+	vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+	vkCmdExecuteCommands(cmdBuffer, (uint32_t) frame.drawBuffers.size(), frame.drawBuffers.data());
+	vkCmdEndRenderPass(cmdBuffer);
+
+	if (mQueryPool != VK_NULL_HANDLE)
+		vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mQueryPool, firstQuery + 1);
+
+	VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+}
+
+void VulkanManager::readTimestamps(Frame& frame)
+{
+	if (!frame.timed)
+		return;
+	frame.timed = false;
+
+	// frame fence is signaled, results are available without waiting
+	uint64_t timestamps[2];
+	VkResult result = vkGetQueryPoolResults(
+			mState.device, 
+			mQueryPool, 
+			2 * mFrameIndex, 
+			2, 
+			sizeof(timestamps), 
+			timestamps, 
+			sizeof(uint64_t), 
+			VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS)
+		return;
+
+	uint32_t validBits = mState.deviceInfo.timestampValidBits;
+	uint64_t mask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+	uint64_t ticks = (timestamps[1] - timestamps[0]) & mask;
+	mLastGpuFrameTime = ticks * mState.deviceInfo.timestampPeriod / 1e6;
+}
+
+void VulkanManager::submitFrame(Frame& frame)
+{
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &frame.cmdBuffer;
+
+	VK_CHECK_RESULT(vkResetFences(mState.device, 1, &frame.fence));
+	{
+		std::lock_guard<std::mutex> queueLock(mState.queueMutex);
+		VK_CHECK_RESULT(vkQueueSubmit(mState.graphicsQueue, 1, &submitInfo, frame.fence));
 	}
+	frame.timed = mQueryPool != VK_NULL_HANDLE;
+	mFrameIndex = (mFrameIndex + 1) % mNumFramesInFlight;
 }
 
 void VulkanManager::draw() 
 {
+	Frame& frame = mFrames[mFrameIndex];
+	if (mState.headless) {
+		// offscreen image of the frame slot, nothing to acquire or present
+		imageIndex = mFrameIndex;
+		recordFrame(frame, imageIndex);
+		submitFrame(frame);
+		return;
+	}
+
 	VkResult result = vkAcquireNextImageKHR(mState.device,
                                             mState.swapChain,
 										  std::numeric_limits<uint64_t>::max(), 
-										  mSwapChainManager.mImageAvailableSemaphore, 
+										  frame.imageAvailableSemaphore, 
 										  VK_NULL_HANDLE, 
 										  &imageIndex);
 	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 		recreateSwapChain();
 	} else if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+		// image may still be rendered by an older frame slot when there are less images than frames
+		VkFence& imageFence = mImageFences[imageIndex];
+		if (imageFence != VK_NULL_HANDLE && imageFence != frame.fence)
+			VK_CHECK_RESULT(vkWaitForFences(mState.device, 1, &imageFence, VK_TRUE, std::numeric_limits<uint64_t>::max()));
+		imageFence = frame.fence;
+
+		recordFrame(frame, imageIndex);
+
 		VkSubmitInfo submitInfo = {};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 		
-		VkSemaphore waitSemaphores[] = { mSwapChainManager.mImageAvailableSemaphore };
-		VkSemaphore signalSemaphores[] = { mSwapChainManager.mRenderFinishedSemaphore };
+		VkSemaphore waitSemaphores[] = { frame.imageAvailableSemaphore };
+		VkSemaphore signalSemaphores[] = { frame.renderFinishedSemaphore };
 		VkSwapchainKHR swapChains[] = { mState.swapChain };
 		VkPipelineStageFlags stageFlags[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 		submitInfo.waitSemaphoreCount = 1;
 		submitInfo.pWaitSemaphores = waitSemaphores;
 		submitInfo.pWaitDstStageMask = stageFlags;
 		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &mSwapChainManager.cmdBuffers[imageIndex];
+		submitInfo.pCommandBuffers = &frame.cmdBuffer;
 		submitInfo.signalSemaphoreCount = 1;
 		submitInfo.pSignalSemaphores = signalSemaphores;
 
-		VK_CHECK_RESULT(vkQueueSubmit(mState.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE));
+		// reset right before the submit, an early return above must leave it signaled
+		VK_CHECK_RESULT(vkResetFences(mState.device, 1, &frame.fence));
+		// held through present, graphics and present queue may be the same
+		std::lock_guard<std::mutex> queueLock(mState.queueMutex);
+		VK_CHECK_RESULT(vkQueueSubmit(mState.graphicsQueue, 1, &submitInfo, frame.fence));
+		frame.timed = mQueryPool != VK_NULL_HANDLE;
 		
 		VkPresentInfoKHR presentInfo = {};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -171,6 +481,7 @@ void VulkanManager::draw()
 		presentInfo.pImageIndices = &imageIndex;
 
 		VK_CHECK_RESULT(vkQueuePresentKHR(mState.presentQueue, &presentInfo));
+		mFrameIndex = (mFrameIndex + 1) % mNumFramesInFlight;
 	} else {
 		VK_THROW_RESULT_ERROR("Failed vkAcquireNextImageKHR", result);
 	}
@@ -178,9 +489,55 @@ void VulkanManager::draw()
 
 void VulkanManager::waitIdle() 
 {
+	std::lock_guard<std::mutex> queueLock(mState.queueMutex);
 	vkDeviceWaitIdle(mState.device);
 }
 
+void VulkanManager::waitForAssets()
+{
+	mAssetLoader.waitAll();
+}
+
+void VulkanManager::setSkinnedModelFlags(Skinned::ModelFlags flags)
+{
+	mSkinnedModelFlags = flags;
+}
+
+void VulkanManager::setModelFlags(Model::ModelFlags flags)
+{
+	mModelFlags = flags;
+}
+
+void VulkanManager::setMeshLod(bool enabled)
+{
+	suit.setLodSelection(enabled);
+}
+
+uint32_t VulkanManager::modelTrianglesDrawn() const
+{
+	return suit.trianglesDrawn();
+}
+
+double VulkanManager::lastGpuFrameTime() const
+{
+	return mLastGpuFrameTime;
+}
+
+double VulkanManager::lastFenceWaitTime() const
+{
+	return mLastFenceWaitTime;
+}
+
+const VulkanState& VulkanManager::getState() const
+{
+	return mState;
+}
+
+AnimLod& VulkanManager::getAnimLod()
+{
+	return mAnimLod;
+}
+
 void VulkanManager::recreateSwapChain()
 {
 /*	vkQueueWaitIdle(mState.graphicsQueue);
@@ -0,0 +1,79 @@
+#include "worker_command_pools.h"
+
+WorkerCommandPools::WorkerCommandPools(VulkanState& vulkanState, TaskManager& taskManager):
+	mState(vulkanState),
+	mTaskManager(taskManager),
+	mNumSlots(0),
+	mNumWorkers(taskManager.numThreads() + 1)
+{
+
+}
+
+WorkerCommandPools::~WorkerCommandPools()
+{
+	destroy();
+}
+
+void WorkerCommandPools::init(uint32_t numSlots)
+{
+	destroy();
+	mNumSlots = numSlots;
+	mPools.resize(mNumSlots * mNumWorkers);
+
+	VkCommandPoolCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	createInfo.queueFamilyIndex = mState.graphicsQueueIndex;
+	// buffers are only ever reset together with their pool
+	createInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	for (auto& pool : mPools)
+		VK_CHECK_RESULT(vkCreateCommandPool(mState.device, &createInfo, nullptr, &pool.pool));
+	LOG("WORKER COMMAND POOLS CREATED: %zu workers, %u slots", mNumWorkers, mNumSlots);
+}
+
+void WorkerCommandPools::destroy()
+{
+	for (auto& pool : mPools)
+		if (pool.pool != VK_NULL_HANDLE)
+			vkDestroyCommandPool(mState.device, pool.pool, nullptr);
+	mPools.clear();
+	mNumSlots = 0;
+}
+
+void WorkerCommandPools::reset(uint32_t slot)
+{
+	for (size_t i = 0; i < mNumWorkers; ++i) {
+		Pool& p = pool(slot, i);
+		if (p.nextBuffer == 0)
+			continue;
+		VK_CHECK_RESULT(vkResetCommandPool(mState.device, p.pool, 0));
+		p.nextBuffer = 0;
+	}
+}
+
+VkCommandBuffer WorkerCommandPools::next(uint32_t slot)
+{
+	Pool& p = pool(slot, mTaskManager.workerIndex());
+	if (p.nextBuffer == p.buffers.size()) {
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = p.pool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer buffer;
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(mState.device, &allocInfo, &buffer));
+		p.buffers.push_back(buffer);
+	}
+	return p.buffers[p.nextBuffer++];
+}
+
+uint32_t WorkerCommandPools::numSlots() const
+{
+	return mNumSlots;
+}
+
+WorkerCommandPools::Pool& WorkerCommandPools::pool(uint32_t slot, size_t workerIndex)
+{
+	return mPools[slot * mNumWorkers + workerIndex];
+}